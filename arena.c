@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cedrus/cedrus.h>
+#include "vdpau_private.h"
+
+/*
+ * Device-wide arena for VE/display memory.
+ *
+ * Small buffers (up to ARENA_SMALL_MAX) are carved out of CMA chunks
+ * that are dedicated to one power-of-two size class. Larger buffers get
+ * their own CMA allocation, rounded to ARENA_LARGE_ALIGN, but are kept
+ * on a free list when released and handed out again for requests of
+ * about the same size. Classes stop at 256 KiB, above that rounding up
+ * to the next power of two would waste up to half of each frame buffer.
+ *
+ * Nothing is given back to the kernel until a CMA allocation fails, then
+ * all cached large buffers and empty chunks are released and the
+ * allocation is retried.
+ *
+ * Cache flushes work on the whole CMA allocation, so flushing a small
+ * buffer flushes its whole chunk of 256 KiB to 1 MiB. Small output and
+ * video surfaces pay for that on every rgba_flush() and put_bits.
+ *
+ * Imported dma-bufs are wrapped in an arena_mem_t too, but they belong
+ * to no arena, don't count in the stats and are unmapped on free.
+ */
+
+#define ARENA_MIN_SHIFT		12
+#define ARENA_CLASSES		7
+#define ARENA_SMALL_MAX		(1 << (ARENA_MIN_SHIFT + ARENA_CLASSES - 1))
+#define ARENA_CHUNK_MIN		(256 * 1024)
+#define ARENA_LARGE_ALIGN	(64 * 1024)
+
+struct arena_chunk;
+
+struct arena_mem
+{
+	struct arena *arena;
+	struct arena_chunk *chunk;
+	cedrus_mem_t *mem;
+	uint32_t offset;
+	size_t size;
+	size_t requested;
+	arena_mem_t *next;
+
+	// imported dma-buf
+	int fd;
+	void *map;
+	uint32_t phys;
+};
+
+struct arena_chunk
+{
+	struct arena_chunk *next;
+	cedrus_mem_t *mem;
+	size_t size;
+	unsigned int used;
+	arena_mem_t *free;
+	arena_mem_t slots[];
+};
+
+struct arena
+{
+	cedrus_t *cedrus;
+	pthread_mutex_t mutex;
+	struct arena_chunk *chunks[ARENA_CLASSES];
+	arena_mem_t *large_free;
+	arena_stats_t stats;
+};
+
+static size_t class_size(int class)
+{
+	return (size_t)1 << (ARENA_MIN_SHIFT + class);
+}
+
+static int size_to_class(size_t size)
+{
+	int class = 0;
+	while (class_size(class) < size)
+		class++;
+
+	return class;
+}
+
+static size_t chunk_size(int class)
+{
+	return max(ARENA_CHUNK_MIN, class_size(class) * 4);
+}
+
+static void arena_trim(struct arena *a)
+{
+	while (a->large_free)
+	{
+		arena_mem_t *m = a->large_free;
+		a->large_free = m->next;
+
+		a->stats.reserved -= m->size;
+		cedrus_mem_free(m->mem);
+		free(m);
+	}
+
+	int class;
+	for (class = 0; class < ARENA_CLASSES; class++)
+	{
+		struct arena_chunk **c = &a->chunks[class];
+		while (*c)
+		{
+			if ((*c)->used == 0)
+			{
+				struct arena_chunk *empty = *c;
+				*c = empty->next;
+
+				a->stats.reserved -= empty->size;
+				cedrus_mem_free(empty->mem);
+				free(empty);
+			}
+			else
+				c = &(*c)->next;
+		}
+	}
+
+	a->stats.trims++;
+}
+
+static cedrus_mem_t *cma_alloc(struct arena *a, size_t size)
+{
+	cedrus_mem_t *mem = cedrus_mem_alloc(a->cedrus, size);
+	if (!mem)
+	{
+		VDPAU_DBG("CMA allocation of %zu bytes failed, trimming arena", size);
+		arena_trim(a);
+		mem = cedrus_mem_alloc(a->cedrus, size);
+	}
+
+	if (mem)
+		a->stats.reserved += size;
+
+	return mem;
+}
+
+static arena_mem_t *alloc_small(struct arena *a, int class)
+{
+	struct arena_chunk *c;
+	for (c = a->chunks[class]; c; c = c->next)
+		if (c->free)
+			break;
+
+	if (!c)
+	{
+		size_t size = chunk_size(class);
+		unsigned int slots = size / class_size(class);
+
+		c = calloc(1, sizeof(*c) + slots * sizeof(arena_mem_t));
+		if (!c)
+			return NULL;
+
+		c->mem = cma_alloc(a, size);
+		if (!c->mem)
+		{
+			free(c);
+			return NULL;
+		}
+
+		c->size = size;
+
+		unsigned int i;
+		for (i = 0; i < slots; i++)
+		{
+			c->slots[i].arena = a;
+			c->slots[i].chunk = c;
+			c->slots[i].mem = c->mem;
+			c->slots[i].offset = i * class_size(class);
+			c->slots[i].size = class_size(class);
+			c->slots[i].next = c->free;
+			c->free = &c->slots[i];
+		}
+
+		c->next = a->chunks[class];
+		a->chunks[class] = c;
+		a->stats.misses++;
+	}
+	else
+		a->stats.hits++;
+
+	arena_mem_t *m = c->free;
+	c->free = m->next;
+	c->used++;
+
+	return m;
+}
+
+static arena_mem_t *alloc_large(struct arena *a, size_t size)
+{
+	arena_mem_t **best = NULL;
+	arena_mem_t **m;
+
+	// best fit, but don't waste more than an eighth
+	for (m = &a->large_free; *m; m = &(*m)->next)
+		if ((*m)->size >= size && (*m)->size <= size + size / 8 && (!best || (*m)->size < (*best)->size))
+			best = m;
+
+	if (best)
+	{
+		arena_mem_t *found = *best;
+		*best = found->next;
+		a->stats.hits++;
+		return found;
+	}
+
+	arena_mem_t *new = calloc(1, sizeof(*new));
+	if (!new)
+		return NULL;
+
+	new->mem = cma_alloc(a, size);
+	if (!new->mem)
+	{
+		free(new);
+		return NULL;
+	}
+
+	new->arena = a;
+	new->size = size;
+	a->stats.misses++;
+
+	return new;
+}
+
+VdpStatus arena_create(device_ctx_t *device)
+{
+	struct arena *a = calloc(1, sizeof(*a));
+	if (!a)
+		return VDP_STATUS_RESOURCES;
+
+	a->cedrus = device->cedrus;
+	pthread_mutex_init(&a->mutex, NULL);
+
+	device->arena = a;
+
+	return VDP_STATUS_OK;
+}
+
+void arena_destroy(device_ctx_t *device)
+{
+	struct arena *a = device->arena;
+	if (!a)
+		return;
+
+	VDPAU_DBG("Arena: %zu bytes high-water, %u hits, %u misses, %u trims",
+		a->stats.high_water, a->stats.hits, a->stats.misses, a->stats.trims);
+
+	arena_trim(a);
+
+	if (a->stats.in_use)
+		VDPAU_DBG("Arena: %zu bytes still in use", a->stats.in_use);
+
+	pthread_mutex_destroy(&a->mutex);
+	free(a);
+
+	device->arena = NULL;
+}
+
+arena_mem_t *arena_alloc(device_ctx_t *device, size_t size)
+{
+	struct arena *a = device->arena;
+	arena_mem_t *m;
+
+	pthread_mutex_lock(&a->mutex);
+
+	if (size <= ARENA_SMALL_MAX)
+		m = alloc_small(a, size_to_class(size));
+	else
+		m = alloc_large(a, ALIGN(size, ARENA_LARGE_ALIGN));
+
+	if (m)
+	{
+		m->requested = size;
+		a->stats.requested += size;
+		a->stats.in_use += m->size;
+		if (a->stats.in_use > a->stats.high_water)
+			a->stats.high_water = a->stats.in_use;
+	}
+
+	pthread_mutex_unlock(&a->mutex);
+
+	return m;
+}
+
+void arena_free(arena_mem_t *mem)
+{
+	if (!mem)
+		return;
+
+	if (mem->map)
+	{
+		munmap(mem->map, mem->size);
+		close(mem->fd);
+		free(mem);
+		return;
+	}
+
+	struct arena *a = mem->arena;
+
+	pthread_mutex_lock(&a->mutex);
+
+	a->stats.requested -= mem->requested;
+	a->stats.in_use -= mem->size;
+
+	if (mem->chunk)
+	{
+		mem->next = mem->chunk->free;
+		mem->chunk->free = mem;
+		mem->chunk->used--;
+	}
+	else
+	{
+		mem->next = a->large_free;
+		a->large_free = mem;
+	}
+
+	pthread_mutex_unlock(&a->mutex);
+}
+
+void arena_get_stats(device_ctx_t *device, arena_stats_t *stats)
+{
+	struct arena *a = device->arena;
+
+	pthread_mutex_lock(&a->mutex);
+	*stats = a->stats;
+	pthread_mutex_unlock(&a->mutex);
+}
+
+/*
+ * The display engine needs the physical address of imported buffers.
+ * It is looked up in the pagemap of the mapping, which only works for
+ * physically contiguous buffers and privileged processes (newer kernels
+ * hide page frame numbers otherwise). Returns 0 if unknown.
+ */
+static uint32_t pagemap_phys_addr(void *addr, size_t size)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	uint64_t first = 0;
+	size_t offset;
+
+	int fd = open("/proc/self/pagemap", O_RDONLY);
+	if (fd == -1)
+		return 0;
+
+	for (offset = 0; offset < size; offset += page_size)
+	{
+		uint64_t entry;
+		off_t pos = ((uintptr_t)addr + offset) / page_size * sizeof(entry);
+
+		if (pread(fd, &entry, sizeof(entry), pos) != sizeof(entry) || !(entry & (1ULL << 63)))
+			break;
+
+		uint64_t pfn = entry & ((1ULL << 55) - 1);
+		if (offset == 0)
+			first = pfn;
+		else if (pfn != first + offset / page_size)
+			break;
+	}
+
+	close(fd);
+
+	if (offset < size || first == 0 || (first + size / page_size) * page_size > UINT32_MAX)
+		return 0;
+
+	return first * page_size;
+}
+
+arena_mem_t *arena_import(int fd, size_t size)
+{
+	// mapping past the end would only fault on access
+	struct stat st;
+	if (fstat(fd, &st) == -1 || (st.st_size > 0 && (size_t)st.st_size < size))
+		return NULL;
+
+	arena_mem_t *m = calloc(1, sizeof(*m));
+	if (!m)
+		return NULL;
+
+	m->fd = dup(fd);
+	if (m->fd == -1)
+		goto err_free;
+
+	m->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m->fd, 0);
+	if (m->map == MAP_FAILED)
+		goto err_close;
+
+	m->size = size;
+	m->requested = size;
+	m->phys = pagemap_phys_addr(m->map, size);
+
+	return m;
+
+err_close:
+	close(m->fd);
+err_free:
+	free(m);
+	return NULL;
+}
+
+int arena_is_imported(const arena_mem_t *mem)
+{
+	return mem->map != NULL;
+}
+
+int arena_get_fd(const arena_mem_t *mem)
+{
+	return mem->map ? mem->fd : -1;
+}
+
+void *arena_get_pointer(const arena_mem_t *mem)
+{
+	if (mem->map)
+		return mem->map;
+
+	return cedrus_mem_get_pointer(mem->mem) + mem->offset;
+}
+
+uint32_t arena_get_bus_addr(const arena_mem_t *mem)
+{
+	// the VE is never pointed at imported buffers
+	if (mem->map)
+		return 0;
+
+	return cedrus_mem_get_bus_addr(mem->mem) + mem->offset;
+}
+
+uint32_t arena_get_phys_addr(const arena_mem_t *mem)
+{
+	if (mem->map)
+		return mem->phys;
+
+	return cedrus_mem_get_phys_addr(mem->mem) + mem->offset;
+}
+
+void arena_flush_cache(arena_mem_t *mem)
+{
+	// coherency of imported buffers is up to their exporter
+	if (mem->map)
+		return;
+
+	cedrus_mem_flush_cache(mem->mem);
+}
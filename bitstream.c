@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "bitstream.h"
+
+void bitstream_init(bitstream_t *bs, const uint8_t *data, unsigned int length, unsigned int pos)
+{
+	bs->data = data;
+	bs->length = length;
+	bs->pos = pos;
+	bs->bit = 0;
+	bs->zeros = 0;
+	bs->rbsp_bits = 0;
+}
+
+static void skip_emulation_prevention(bitstream_t *bs)
+{
+	if (bs->bit == 0 && bs->zeros >= 2 && bs->pos < bs->length && bs->data[bs->pos] == 0x03)
+	{
+		bs->pos++;
+		bs->zeros = 0;
+	}
+}
+
+static inline unsigned int get_bit(bitstream_t *bs)
+{
+	skip_emulation_prevention(bs);
+
+	if (bs->pos >= bs->length)
+		return 0;
+
+	unsigned int b = (bs->data[bs->pos] >> (7 - bs->bit)) & 0x1;
+
+	bs->rbsp_bits++;
+	if (++bs->bit == 8)
+	{
+		bs->zeros = bs->data[bs->pos] == 0x00 ? bs->zeros + 1 : 0;
+		bs->pos++;
+		bs->bit = 0;
+	}
+
+	return b;
+}
+
+uint32_t get_u(bitstream_t *bs, int num)
+{
+	uint32_t val = 0;
+
+	while (num--)
+		val = (val << 1) | get_bit(bs);
+
+	return val;
+}
+
+uint32_t get_ue(bitstream_t *bs)
+{
+	int leading_zeros = 0;
+
+	while (!get_bit(bs) && leading_zeros < 32)
+		leading_zeros++;
+
+	if (leading_zeros >= 32)
+		return 0;
+
+	return (1u << leading_zeros) - 1 + get_u(bs, leading_zeros);
+}
+
+int32_t get_se(bitstream_t *bs)
+{
+	uint32_t val = get_ue(bs);
+
+	if (val & 0x1)
+		return (val + 1) / 2;
+	else
+		return -(int32_t)(val / 2);
+}
+
+void bitstream_skip(bitstream_t *bs, unsigned int num)
+{
+	for (; num > 32; num -= 32)
+		get_u(bs, 32);
+	get_u(bs, num);
+}
+
+unsigned int bitstream_raw_offset(bitstream_t *bs)
+{
+	skip_emulation_prevention(bs);
+
+	/*
+	 * The VE counts zero bytes itself to detect emulation prevention
+	 * bytes, so it must not start right behind a zero byte.
+	 */
+	if (bs->pos > 0 && bs->data[bs->pos - 1] == 0x00)
+		return 0;
+
+	return bs->pos * 8 + bs->bit;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __BITSTREAM_H__
+#define __BITSTREAM_H__
+
+#include <stdint.h>
+
+/*
+ * Bit reader for H.264/HEVC NAL unit payloads, dropping emulation
+ * prevention bytes on the way like the VE does.
+ */
+typedef struct
+{
+	const uint8_t *data;
+	unsigned int length;
+	unsigned int pos;
+	unsigned int bit;
+	unsigned int zeros;
+	unsigned int rbsp_bits;
+} bitstream_t;
+
+void bitstream_init(bitstream_t *bs, const uint8_t *data, unsigned int length, unsigned int pos);
+uint32_t get_u(bitstream_t *bs, int num);
+uint32_t get_ue(bitstream_t *bs);
+int32_t get_se(bitstream_t *bs);
+void bitstream_skip(bitstream_t *bs, unsigned int num);
+
+/*
+ * Offset of the next bit in the raw (escaped) data, in bits.
+ * Returns 0 if the VE can't safely be started there, because it could
+ * miss an emulation prevention byte following zeros it hasn't seen.
+ */
+unsigned int bitstream_raw_offset(bitstream_t *bs);
+
+#endif
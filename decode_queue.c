@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include "vdpau_private.h"
+
+/*
+ * Asynchronous decoding: vdp_decoder_render() queues a job and returns,
+ * a per-device worker thread owns the VE and runs the codec back-ends.
+ *
+ * Every job gets a sequence number, which is stored as fence in the
+ * target surface and the VBV slot it uses, and as ref_fence in the
+ * surfaces it reads as reference. Jobs complete in order, so a fence
+ * has signalled once the completed counter has reached it.
+ */
+#define DECODE_QUEUE_SIZE 8
+
+typedef struct
+{
+	decoder_ctx_t *decoder;
+	video_surface_ctx_t *output;
+	vbv_t *vbv;
+	int len;
+	union
+	{
+		VdpPictureInfoMPEG1Or2 mpeg12;
+		VdpPictureInfoH264 h264;
+		VdpPictureInfoMPEG4Part2 mpeg4;
+		VdpPictureInfoHEVC h265;
+	} info;
+} decode_job_t;
+
+struct decode_queue
+{
+	decode_job_t jobs[DECODE_QUEUE_SIZE];
+	uint64_t submitted;
+	uint64_t completed;
+	int quit;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t job_cond;
+	pthread_cond_t done_cond;
+};
+
+static size_t picture_info_size(VdpDecoderProfile profile)
+{
+	switch (profile)
+	{
+	case VDP_DECODER_PROFILE_MPEG1:
+	case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
+	case VDP_DECODER_PROFILE_MPEG2_MAIN:
+		return sizeof(VdpPictureInfoMPEG1Or2);
+
+	case VDP_DECODER_PROFILE_H264_BASELINE:
+	case VDP_DECODER_PROFILE_H264_MAIN:
+	case VDP_DECODER_PROFILE_H264_HIGH:
+	case VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE:
+	case VDP_DECODER_PROFILE_H264_CONSTRAINED_HIGH:
+		return sizeof(VdpPictureInfoH264);
+
+	case VDP_DECODER_PROFILE_MPEG4_PART2_SP:
+	case VDP_DECODER_PROFILE_MPEG4_PART2_ASP:
+		return sizeof(VdpPictureInfoMPEG4Part2);
+
+	case VDP_DECODER_PROFILE_HEVC_MAIN:
+		return sizeof(VdpPictureInfoHEVC);
+
+	default:
+		return 0;
+	}
+}
+
+static void mark_reference(VdpVideoSurface surface, uint64_t fence)
+{
+	if (surface == VDP_INVALID_HANDLE)
+		return;
+
+	video_surface_ctx_t *ref = handle_get(surface);
+	if (ref)
+		ref->ref_fence = fence;
+}
+
+/*
+ * The VE reads the reference pictures until the job is done, so they
+ * must not be decoded to or written again before.
+ */
+static void mark_references(VdpDecoderProfile profile, const VdpPictureInfo *info, uint64_t fence)
+{
+	unsigned int i;
+
+	switch (profile)
+	{
+	case VDP_DECODER_PROFILE_MPEG1:
+	case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
+	case VDP_DECODER_PROFILE_MPEG2_MAIN:
+		mark_reference(((const VdpPictureInfoMPEG1Or2 *)info)->forward_reference, fence);
+		mark_reference(((const VdpPictureInfoMPEG1Or2 *)info)->backward_reference, fence);
+		break;
+
+	case VDP_DECODER_PROFILE_H264_BASELINE:
+	case VDP_DECODER_PROFILE_H264_MAIN:
+	case VDP_DECODER_PROFILE_H264_HIGH:
+	case VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE:
+	case VDP_DECODER_PROFILE_H264_CONSTRAINED_HIGH:
+		for (i = 0; i < 16; i++)
+			mark_reference(((const VdpPictureInfoH264 *)info)->referenceFrames[i].surface, fence);
+		break;
+
+	case VDP_DECODER_PROFILE_MPEG4_PART2_SP:
+	case VDP_DECODER_PROFILE_MPEG4_PART2_ASP:
+		mark_reference(((const VdpPictureInfoMPEG4Part2 *)info)->forward_reference, fence);
+		mark_reference(((const VdpPictureInfoMPEG4Part2 *)info)->backward_reference, fence);
+		break;
+
+	case VDP_DECODER_PROFILE_HEVC_MAIN:
+		for (i = 0; i < 16; i++)
+			mark_reference(((const VdpPictureInfoHEVC *)info)->RefPics[i], fence);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void *decode_queue_thread(void *arg)
+{
+	struct decode_queue *q = arg;
+
+	pthread_mutex_lock(&q->mutex);
+	while (1)
+	{
+		while (!q->quit && q->completed == q->submitted)
+			pthread_cond_wait(&q->job_cond, &q->mutex);
+
+		if (q->completed == q->submitted)
+			break;
+
+		decode_job_t *job = &q->jobs[q->completed % DECODE_QUEUE_SIZE];
+		pthread_mutex_unlock(&q->mutex);
+
+		job->decoder->vbv = job->vbv;
+		VdpStatus ret = job->decoder->decode(job->decoder, (VdpPictureInfo const *)&job->info, job->len, job->output);
+		if (ret != VDP_STATUS_OK)
+			VDPAU_DBG("Asynchronous decode failed (%d)", ret);
+
+		pthread_mutex_lock(&q->mutex);
+		q->completed++;
+		pthread_cond_broadcast(&q->done_cond);
+	}
+	pthread_mutex_unlock(&q->mutex);
+
+	return NULL;
+}
+
+VdpStatus decode_queue_create(device_ctx_t *device)
+{
+	struct decode_queue *q = calloc(1, sizeof(*q));
+	if (!q)
+		return VDP_STATUS_RESOURCES;
+
+	pthread_mutex_init(&q->mutex, NULL);
+	pthread_cond_init(&q->job_cond, NULL);
+	pthread_cond_init(&q->done_cond, NULL);
+
+	if (pthread_create(&q->thread, NULL, decode_queue_thread, q))
+	{
+		pthread_cond_destroy(&q->done_cond);
+		pthread_cond_destroy(&q->job_cond);
+		pthread_mutex_destroy(&q->mutex);
+		free(q);
+		return VDP_STATUS_RESOURCES;
+	}
+
+	device->decode_queue = q;
+
+	return VDP_STATUS_OK;
+}
+
+void decode_queue_destroy(device_ctx_t *device)
+{
+	struct decode_queue *q = device->decode_queue;
+	if (!q)
+		return;
+
+	pthread_mutex_lock(&q->mutex);
+	q->quit = 1;
+	pthread_cond_signal(&q->job_cond);
+	pthread_mutex_unlock(&q->mutex);
+
+	pthread_join(q->thread, NULL);
+
+	pthread_cond_destroy(&q->done_cond);
+	pthread_cond_destroy(&q->job_cond);
+	pthread_mutex_destroy(&q->mutex);
+	free(q);
+
+	device->decode_queue = NULL;
+}
+
+VdpStatus decode_queue_submit(decoder_ctx_t *decoder, vbv_t *vbv, VdpPictureInfo const *info, int len, video_surface_ctx_t *output)
+{
+	struct decode_queue *q = decoder->device->decode_queue;
+
+	size_t info_size = picture_info_size(decoder->profile);
+	if (!info_size)
+		return VDP_STATUS_INVALID_DECODER_PROFILE;
+
+	pthread_mutex_lock(&q->mutex);
+
+	while (q->submitted - q->completed >= DECODE_QUEUE_SIZE)
+		pthread_cond_wait(&q->done_cond, &q->mutex);
+
+	decode_job_t *job = &q->jobs[q->submitted % DECODE_QUEUE_SIZE];
+	job->decoder = decoder;
+	job->output = output;
+	job->vbv = vbv;
+	job->len = len;
+	memcpy(&job->info, info, info_size);
+
+	q->submitted++;
+	output->fence = vbv->fence = q->submitted;
+	mark_references(decoder->profile, info, q->submitted);
+
+	pthread_cond_signal(&q->job_cond);
+	pthread_mutex_unlock(&q->mutex);
+
+	return VDP_STATUS_OK;
+}
+
+void decode_queue_wait(device_ctx_t *device, uint64_t fence)
+{
+	struct decode_queue *q = device->decode_queue;
+	if (!q)
+		return;
+
+	pthread_mutex_lock(&q->mutex);
+	while (q->completed < fence)
+		pthread_cond_wait(&q->done_cond, &q->mutex);
+	pthread_mutex_unlock(&q->mutex);
+}
+
+void decode_queue_drain(device_ctx_t *device)
+{
+	struct decode_queue *q = device->decode_queue;
+	if (!q)
+		return;
+
+	pthread_mutex_lock(&q->mutex);
+	while (q->completed < q->submitted)
+		pthread_cond_wait(&q->done_cond, &q->mutex);
+	pthread_mutex_unlock(&q->mutex);
+}
@@ -19,8 +19,169 @@
 
 #include <string.h>
 #include <cedrus/cedrus.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
 #include "vdpau_private.h"
 
+/*
+ * Initial VBV slot size, estimated from the worst case compression ratio
+ * of a single picture. VDPAU doesn't tell us the level at create time,
+ * so frame size is all we have. Slots grow on demand if this is too small.
+ */
+static uint32_t vbv_initial_size(VdpDecoderProfile profile, uint32_t width, uint32_t height)
+{
+	uint32_t frame_size = ALIGN(width, 16) * ALIGN(height, 16) * 3 / 2;
+
+	switch (profile)
+	{
+	case VDP_DECODER_PROFILE_H264_BASELINE:
+	case VDP_DECODER_PROFILE_H264_MAIN:
+	case VDP_DECODER_PROFILE_H264_HIGH:
+	case VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE:
+	case VDP_DECODER_PROFILE_H264_CONSTRAINED_HIGH:
+	case VDP_DECODER_PROFILE_HEVC_MAIN:
+		frame_size /= 4;
+		break;
+
+	default:
+		frame_size /= 8;
+		break;
+	}
+
+	return ALIGN(max(frame_size, VBV_MIN_SIZE), VBV_ALIGN);
+}
+
+/*
+ * Grow a VBV slot to hold at least len bytes. The old buffer is freed
+ * first so the CMA area it occupied can be reused for the new one.
+ */
+static VdpStatus vbv_grow(decoder_ctx_t *dec, vbv_t *vbv, uint32_t len)
+{
+	uint32_t size = ALIGN(max(len, vbv->size * 2), VBV_ALIGN);
+
+	if (vbv->data)
+		cedrus_mem_free(vbv->data);
+
+	vbv->data = cedrus_mem_alloc(dec->device->cedrus, size);
+	if (vbv->data)
+	{
+		VDPAU_DBG("VBV grown from %u to %u bytes", vbv->size, size);
+		vbv->size = size;
+		return VDP_STATUS_OK;
+	}
+
+	if (vbv->size)
+		vbv->data = cedrus_mem_alloc(dec->device->cedrus, vbv->size);
+	if (!vbv->data)
+		vbv->size = 0;
+
+	return VDP_STATUS_RESOURCES;
+}
+
+static void free_vbv_ring(decoder_ctx_t *dec)
+{
+	int i;
+	for (i = 0; i < VBV_COUNT; i++)
+	{
+		if (dec->vbv_ring[i].data)
+			cedrus_mem_free(dec->vbv_ring[i].data);
+		free(dec->vbv_ring[i].startcodes);
+	}
+}
+
+static int vbv_add_startcode(vbv_t *vbv, uint32_t offset)
+{
+	if (vbv->num_startcodes >= vbv->max_startcodes)
+	{
+		unsigned int max = vbv->max_startcodes ? vbv->max_startcodes * 2 : 64;
+		uint32_t *startcodes = realloc(vbv->startcodes, max * sizeof(uint32_t));
+		if (!startcodes)
+			return 0;
+
+		vbv->startcodes = startcodes;
+		vbv->max_startcodes = max;
+	}
+
+	vbv->startcodes[vbv->num_startcodes++] = offset;
+	return 1;
+}
+
+/*
+ * Check bytes [from, to) of src for the 0x01 of a 00 00 01 start code,
+ * only looking back within src itself.
+ */
+static int check_startcodes(vbv_t *vbv, const uint8_t *src, uint32_t pos, uint32_t from, uint32_t to)
+{
+	uint32_t j;
+	for (j = max(from, 2); j < to; j++)
+		if (src[j] == 0x01 && src[j - 1] == 0x00 && src[j - 2] == 0x00)
+			if (!vbv_add_startcode(vbv, pos + j + 1))
+				return 0;
+
+	return 1;
+}
+
+#ifdef __ARM_NEON
+#define SCAN_STEP 16
+#else
+#define SCAN_STEP sizeof(unsigned long)
+#endif
+
+/*
+ * Copy len bytes from src to the VBV at pos and record the offset behind
+ * every start code on the way, so the codecs don't have to search the
+ * bitstream again.
+ *
+ * A start code can only end within two bytes after a zero byte, so blocks
+ * without any zero byte are copied without a closer look.
+ */
+static int vbv_copy_and_index(vbv_t *vbv, const uint8_t *src, uint32_t len, uint32_t pos)
+{
+	uint8_t *dst = cedrus_mem_get_pointer(vbv->data) + pos;
+	uint32_t i, next = 0;
+
+	// start codes spanning the end of the previous buffer
+	for (i = 0; i < min(len, 2); i++)
+		if (pos + i >= 2 && src[i] == 0x01 && (i ? src[0] : dst[-1]) == 0x00 && dst[(int)i - 2] == 0x00)
+			if (!vbv_add_startcode(vbv, pos + i + 1))
+				return 0;
+
+	for (i = 0; i + SCAN_STEP <= len; i += SCAN_STEP)
+	{
+#ifdef __ARM_NEON
+		uint8x16_t v = vld1q_u8(src + i);
+		vst1q_u8(dst + i, v);
+
+		uint8x8_t z = vshrn_n_u16(vreinterpretq_u16_u8(vceqq_u8(v, vdupq_n_u8(0))), 4);
+		int has_zero = vget_lane_u64(vreinterpret_u64_u8(z), 0) != 0;
+#else
+		unsigned long v;
+		memcpy(&v, src + i, sizeof(v));
+		memcpy(dst + i, &v, sizeof(v));
+
+		const unsigned long ones = ~0UL / 0xff;
+		int has_zero = ((v - ones) & ~v & (ones << 7)) != 0;
+#endif
+		if (has_zero)
+		{
+			if (!check_startcodes(vbv, src, pos, max(i + 1, next), min(i + SCAN_STEP + 2, len)))
+				return 0;
+
+			next = min(i + SCAN_STEP + 2, len);
+		}
+	}
+
+	if (i < len)
+	{
+		memcpy(dst + i, src + i, len - i);
+		if (!check_startcodes(vbv, src, pos, max(i, next), len))
+			return 0;
+	}
+
+	return 1;
+}
+
 VdpStatus vdp_decoder_create(VdpDevice device,
                              VdpDecoderProfile profile,
                              uint32_t width,
@@ -35,7 +196,7 @@ VdpStatus vdp_decoder_create(VdpDevice device,
 	if (max_references > 16)
 		return VDP_STATUS_ERROR;
 
-	decoder_ctx_t *dec = handle_create(sizeof(*dec), decoder);
+	decoder_ctx_t *dec = handle_create(HANDLE_TYPE_DECODER, sizeof(*dec), decoder);
 	if (!dec)
 		goto err_ctx;
 
@@ -44,9 +205,18 @@ VdpStatus vdp_decoder_create(VdpDevice device,
 	dec->width = width;
 	dec->height = height;
 
-	dec->data = cedrus_mem_alloc(dec->device->cedrus, VBV_SIZE);
-	if (!(dec->data))
-		goto err_data;
+	uint32_t vbv_size = vbv_initial_size(profile, width, height);
+
+	int i;
+	for (i = 0; i < VBV_COUNT; i++)
+	{
+		dec->vbv_ring[i].data = cedrus_mem_alloc(dec->device->cedrus, vbv_size);
+		if (!dec->vbv_ring[i].data)
+			goto err_data;
+
+		dec->vbv_ring[i].size = vbv_size;
+	}
+	dec->vbv = &dec->vbv_ring[0];
 
 	VdpStatus ret;
 	switch (profile)
@@ -63,11 +233,15 @@ VdpStatus vdp_decoder_create(VdpDevice device,
 	case VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE:
 	case VDP_DECODER_PROFILE_H264_CONSTRAINED_HIGH:
 		ret = new_decoder_h264(dec);
+		dec->scale_shift = dev->scale_shift;
+		dec->rotation = dev->rotation;
 		break;
 
 	case VDP_DECODER_PROFILE_MPEG4_PART2_SP:
 	case VDP_DECODER_PROFILE_MPEG4_PART2_ASP:
 		ret = new_decoder_mpeg4(dec);
+		dec->scale_shift = dev->scale_shift;
+		dec->rotation = dev->rotation;
 		break;
 
 	case VDP_DECODER_PROFILE_HEVC_MAIN:
@@ -83,28 +257,63 @@ VdpStatus vdp_decoder_create(VdpDevice device,
 	}
 
 	if (ret != VDP_STATUS_OK)
-		goto err_decoder;
+		goto err_data;
 
 	return VDP_STATUS_OK;
 
-err_decoder:
-	cedrus_mem_free(dec->data);
 err_data:
+	free_vbv_ring(dec);
 	handle_destroy(*decoder);
 err_ctx:
 	return VDP_STATUS_RESOURCES;
 }
 
+/*
+ * Bitstream sizes seen by a decoder, to tune the initial VBV size.
+ * Only valid while no other thread renders with the decoder.
+ */
+void decoder_get_vbv_stats(decoder_ctx_t *decoder, vbv_stats_t *stats)
+{
+	unsigned int i;
+
+	stats->high_water = decoder->vbv_high_water;
+	stats->largest_slot = 0;
+	stats->reserved = 0;
+
+	for (i = 0; i < VBV_COUNT; i++)
+	{
+		stats->largest_slot = max(stats->largest_slot, decoder->vbv_ring[i].size);
+		stats->reserved += decoder->vbv_ring[i].size;
+	}
+}
+
 VdpStatus vdp_decoder_destroy(VdpDecoder decoder)
 {
 	decoder_ctx_t *dec = handle_get(decoder);
 	if (!dec)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	decode_queue_drain(dec->device);
+
 	if (dec->private_free)
 		dec->private_free(dec);
 
-	cedrus_mem_free(dec->data);
+	vbv_stats_t stats;
+	decoder_get_vbv_stats(dec, &stats);
+	VDPAU_DBG("VBV high-water mark %u bytes (largest slot %u, %u in all slots)",
+		stats.high_water, stats.largest_slot, stats.reserved);
+
+	if (dec->scale_shift)
+	{
+		uint32_t width = dec->width >> dec->scale_shift, height = dec->height >> dec->scale_shift;
+		VDPAU_DBG("Scaled down by %u: display copy %u bytes per frame instead of %u",
+			1 << dec->scale_shift,
+			ALIGN(width, 32) * ALIGN(height, 32) + ALIGN(width, 32) * ALIGN(height / 2, 32),
+			ALIGN(dec->width, 32) * ALIGN(dec->height, 32) + ALIGN(dec->width, 32) * ALIGN(dec->height / 2, 32));
+	}
+
+	ve_shadow_free(&dec->shadow, dec->device);
+	free_vbv_ring(dec);
 
 	handle_destroy(decoder);
 
@@ -146,15 +355,80 @@ VdpStatus vdp_decoder_render(VdpDecoder decoder,
 	if (!vid)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	vid->source_format = INTERNAL_YCBCR_FORMAT;
+	// the VE can't write to imported buffers
+	if (arena_is_imported(vid->yuv->data))
+		return VDP_STATUS_ERROR;
+
 	unsigned int i, pos = 0;
 
+	/*
+	 * Fill the next slot of the ring, so the previous picture's bitstream
+	 * stays untouched while the VE may still be reading it.
+	 */
+	vbv_t *vbv = &dec->vbv_ring[dec->vbv_next];
+	dec->vbv_next = (dec->vbv_next + 1) % VBV_COUNT;
+
+	decode_queue_wait(dec->device, vbv->fence);
+
+	uint32_t len = 0;
+	for (i = 0; i < bitstream_buffer_count; i++)
+		len += bitstream_buffers[i].bitstream_bytes;
+
+	if (len > dec->vbv_high_water)
+		dec->vbv_high_water = len;
+
+	if (len > vbv->size || !vbv->data)
+	{
+		VdpStatus ret = vbv_grow(dec, vbv, len);
+		if (ret != VDP_STATUS_OK)
+			return ret;
+	}
+
+	vbv->num_startcodes = 0;
 	for (i = 0; i < bitstream_buffer_count; i++)
 	{
-		memcpy(cedrus_mem_get_pointer(dec->data) + pos, bitstream_buffers[i].bitstream, bitstream_buffers[i].bitstream_bytes);
+		if (!vbv_copy_and_index(vbv, bitstream_buffers[i].bitstream, bitstream_buffers[i].bitstream_bytes, pos))
+			return VDP_STATUS_RESOURCES;
+
 		pos += bitstream_buffers[i].bitstream_bytes;
 	}
-	cedrus_mem_flush_cache(dec->data);
+	vbv->len = pos;
+
+	// a start code at the very end is of no use to anyone
+	if (vbv->num_startcodes && vbv->startcodes[vbv->num_startcodes - 1] >= pos)
+		vbv->num_startcodes--;
+
+	cedrus_mem_flush_cache(vbv->data);
+
+	/*
+	 * The target's buffers have to be settled here, before the
+	 * application can hand the surface to the mixer. Queued jobs may
+	 * also still read it as reference, and on VEs before 0x1680 the
+	 * reference is the very buffer yuv_prepare() may swap.
+	 */
+	decode_queue_wait(dec->device, max(vid->fence, vid->ref_fence));
+
+	VdpStatus ret = yuv_prepare(vid, dec->scale_shift, dec->rotation);
+	if (ret != VDP_STATUS_OK)
+		return ret;
+
+	if (dec->profile != VDP_DECODER_PROFILE_HEVC_MAIN)
+	{
+		ret = rec_prepare(vid);
+		if (ret != VDP_STATUS_OK)
+			return ret;
+	}
+
+	// only now the surface is switched over to the decoded picture
+	vid->source_format = INTERNAL_YCBCR_FORMAT;
+	vid->scale_shift = dec->scale_shift;
+	vid->rotation = dec->rotation;
+	video_surface_set_decoded_layout(vid);
+
+	if (dec->device->decode_queue)
+		return decode_queue_submit(dec, vbv, picture_info, pos, vid);
+
+	dec->vbv = vbv;
 
 	return dec->decode(dec, picture_info, pos, vid);
 }
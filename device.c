@@ -31,7 +31,7 @@ VdpStatus vdp_imp_device_create_x11(Display *display,
 	if (!display || !device || !get_proc_address)
 		return VDP_STATUS_INVALID_POINTER;
 
-	device_ctx_t *dev = handle_create(sizeof(*dev), device);
+	device_ctx_t *dev = handle_create(HANDLE_TYPE_DEVICE, sizeof(*dev), device);
 	if (!dev)
 		return VDP_STATUS_RESOURCES;
 
@@ -46,9 +46,68 @@ VdpStatus vdp_imp_device_create_x11(Display *display,
 		return VDP_STATUS_ERROR;
 	}
 
+	if (arena_create(dev) != VDP_STATUS_OK)
+	{
+		cedrus_close(dev->cedrus);
+		XCloseDisplay(dev->display);
+		handle_destroy(*device);
+		return VDP_STATUS_RESOURCES;
+	}
+
+	if (surface_pool_create(dev) != VDP_STATUS_OK)
+		VDPAU_DBG("Failed to create surface pool");
+
+	if (yuv_pool_create(dev) != VDP_STATUS_OK)
+		VDPAU_DBG("Failed to create yuv pool");
+
 	VDPAU_DBG("VE version 0x%04x opened", cedrus_get_ve_version(dev->cedrus));
 	*get_proc_address = vdp_get_proc_address;
 
+	char *env_vdpau_async = getenv("VDPAU_ASYNC_DECODE");
+	if (env_vdpau_async && strncmp(env_vdpau_async, "1", 1) == 0)
+	{
+		if (decode_queue_create(dev) == VDP_STATUS_OK)
+			VDPAU_DBG("Asynchronous decoding enabled");
+		else
+			VDPAU_DBG("Failed to start decode thread, decoding synchronously");
+	}
+
+	char *env_vdpau_readback = getenv("VDPAU_READBACK_THREADS");
+	if (env_vdpau_readback)
+	{
+		int threads = atoi(env_vdpau_readback);
+		if (readback_pool_create(dev, threads) != VDP_STATUS_OK)
+			VDPAU_DBG("Failed to start readback threads, reading back in one thread");
+		else if (dev->readback_pool)
+			VDPAU_DBG("Reading back surfaces with %d threads", threads);
+	}
+
+	char *env_vdpau_scale = getenv("VDPAU_SCALE_DOWN");
+	if (env_vdpau_scale)
+	{
+		int factor = atoi(env_vdpau_scale);
+		if (cedrus_get_ve_version(dev->cedrus) < 0x1680)
+			VDPAU_DBG("Scale-down needs VE version 0x1680 or newer");
+		else if (factor == 2 || factor == 4)
+		{
+			dev->scale_shift = factor == 2 ? 1 : 2;
+			VDPAU_DBG("Scaling decoded video down by %d for display", factor);
+		}
+	}
+
+	char *env_vdpau_rotate = getenv("VDPAU_ROTATE");
+	if (env_vdpau_rotate)
+	{
+		int degrees = atoi(env_vdpau_rotate);
+		if (cedrus_get_ve_version(dev->cedrus) < 0x1680)
+			VDPAU_DBG("Rotation needs VE version 0x1680 or newer");
+		else if (degrees == 90 || degrees == 180 || degrees == 270)
+		{
+			dev->rotation = degrees / 90;
+			VDPAU_DBG("Rotating decoded video by %d degrees for display", degrees);
+		}
+	}
+
 	char *env_vdpau_osd = getenv("VDPAU_OSD");
 	char *env_vdpau_g2d = getenv("VDPAU_DISABLE_G2D");
 	if (env_vdpau_osd && strncmp(env_vdpau_osd, "1", 1) == 0)
@@ -81,8 +140,14 @@ VdpStatus vdp_device_destroy(VdpDevice device)
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	decode_queue_destroy(dev);
+	readback_pool_destroy(dev);
+
 	if (dev->g2d_enabled)
 		close(dev->g2d_fd);
+	surface_pool_destroy(dev);
+	yuv_pool_destroy(dev);
+	arena_destroy(dev);
 	cedrus_close(dev->cedrus);
 	XCloseDisplay(dev->display);
 
@@ -173,6 +238,13 @@ static void *const functions[] =
 	[VDP_FUNC_ID_PREEMPTION_CALLBACK_REGISTER]                          = vdp_preemption_callback_register,
 };
 
+static void *const driver_functions[] =
+{
+	[VDP_FUNC_ID_VIDEO_SURFACE_IMPORT_DMA_BUF_SUNXI - VDP_FUNC_ID_BASE_DRIVER] = vdp_video_surface_import_dma_buf_sunxi,
+	[VDP_FUNC_ID_VIDEO_SURFACE_EXPORT_SUNXI - VDP_FUNC_ID_BASE_DRIVER]         = vdp_video_surface_export_sunxi,
+	[VDP_FUNC_ID_VIDEO_SURFACE_EXPORT_RELEASE_SUNXI - VDP_FUNC_ID_BASE_DRIVER] = vdp_video_surface_export_release_sunxi,
+};
+
 VdpStatus vdp_get_proc_address(VdpDevice device_handle,
                                VdpFuncId function_id,
                                void **function_pointer)
@@ -198,6 +270,12 @@ VdpStatus vdp_get_proc_address(VdpDevice device_handle,
 
 		return VDP_STATUS_OK;
 	}
+	else if (function_id >= VDP_FUNC_ID_BASE_DRIVER && function_id - VDP_FUNC_ID_BASE_DRIVER < ARRAY_SIZE(driver_functions))
+	{
+		*function_pointer = driver_functions[function_id - VDP_FUNC_ID_BASE_DRIVER];
+
+		return VDP_STATUS_OK;
+	}
 
 	return VDP_STATUS_INVALID_FUNC_ID;
 }
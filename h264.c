@@ -23,48 +23,17 @@
 #include <cedrus/cedrus.h>
 #include <cedrus/cedrus_regs.h>
 #include "vdpau_private.h"
+#include "bitstream.h"
 
-static int find_startcode(const uint8_t *data, int len, int start)
+static void skip_bits(void *regs, int num)
 {
-	int pos, zeros = 0;
-	for (pos = start; pos < len; pos++)
+	for (; num > 32; num -= 32)
 	{
-		if (data[pos] == 0x00)
-			zeros++;
-		else if (data[pos] == 0x01 && zeros >= 2)
-			return pos - 2;
-		else
-			zeros = 0;
+		writel(0x3 | (32 << 8), regs + VE_H264_TRIGGER);
+		while (readl(regs + VE_H264_STATUS) & (1 << 8));
 	}
-
-	return -1;
-}
-
-static uint32_t get_u(void *regs, int num)
-{
-	writel(0x00000002 | (num << 8), regs + VE_H264_TRIGGER);
-
+	writel(0x3 | (num << 8), regs + VE_H264_TRIGGER);
 	while (readl(regs + VE_H264_STATUS) & (1 << 8));
-
-	return readl(regs + VE_H264_BASIC_BITS);
-}
-
-static uint32_t get_ue(void *regs)
-{
-	writel(0x00000005, regs + VE_H264_TRIGGER);
-
-	while (readl(regs + VE_H264_STATUS) & (1 << 8));
-
-	return readl(regs + VE_H264_BASIC_BITS);
-}
-
-static int32_t get_se(void *regs)
-{
-	writel(0x00000004, regs + VE_H264_TRIGGER);
-
-	while (readl(regs + VE_H264_STATUS) & (1 << 8));
-
-	return readl(regs + VE_H264_BASIC_BITS);
 }
 
 #define PIC_TOP_FIELD		0x1
@@ -131,6 +100,7 @@ typedef struct
 typedef struct
 {
 	void *regs;
+	bitstream_t bs;
 	h264_header_t header;
 	VdpPictureInfoH264 const *info;
 	video_surface_ctx_t *output;
@@ -140,18 +110,27 @@ typedef struct
 	int video_extra_data_len;
 
 	int ref_count;
-	h264_picture_t ref_pic[16];
+	h264_picture_t *ref_pic;
+	h264_picture_t *ref_pic_by_poc[16];
 } h264_context_t;
 
 typedef struct
 {
-	cedrus_mem_t *extra_data;
+	arena_mem_t *extra_data;
+
+	// reference frames of the last picture; ref_handle is in the order
+	// they were added, ref_pic gets sorted by frame_idx
+	int ref_count;
+	h264_picture_t ref_pic[16];
+	VdpVideoSurface ref_handle[16];
+
+	h264_context_t context;
 } h264_private_t;
 
 static void h264_private_free(decoder_ctx_t *decoder)
 {
 	h264_private_t *decoder_p = (h264_private_t *)decoder->private;
-	cedrus_mem_free(decoder_p->extra_data);
+	arena_free(decoder_p->extra_data);
 	free(decoder_p);
 }
 
@@ -161,7 +140,8 @@ static void h264_private_free(decoder_ctx_t *decoder)
 
 typedef struct
 {
-	cedrus_mem_t *extra_data;
+	arena_mem_t *extra_data;
+	int extra_data_len;
 	uint8_t pos;
 	uint8_t pic_type;
 } h264_video_private_t;
@@ -169,7 +149,7 @@ typedef struct
 static void h264_video_private_free(video_surface_ctx_t *surface)
 {
 	h264_video_private_t *surface_p = (h264_video_private_t *)surface->decoder_private;
-	cedrus_mem_free(surface_p->extra_data);
+	arena_free(surface_p->extra_data);
 	free(surface_p);
 }
 
@@ -177,19 +157,29 @@ static h264_video_private_t *get_surface_priv(h264_context_t *c, video_surface_c
 {
 	h264_video_private_t *surface_p = surface->decoder_private;
 
+	// surfaces can come from another decoder or the surface pool
+	if (surface_p && (surface->decoder_private_free != h264_video_private_free ||
+	                  surface_p->extra_data_len < c->video_extra_data_len))
+	{
+		surface->decoder_private_free(surface);
+		surface->decoder_private = surface_p = NULL;
+		surface->decoder_private_free = NULL;
+	}
+
 	if (!surface_p)
 	{
 		surface_p = calloc(1, sizeof(h264_video_private_t));
 		if (!surface_p)
 			return NULL;
 
-		surface_p->extra_data = cedrus_mem_alloc(surface->device->cedrus, c->video_extra_data_len * 2);
+		surface_p->extra_data = arena_alloc(surface->device, c->video_extra_data_len * 2);
 		if (!surface_p->extra_data)
 		{
 			free(surface_p);
 			return NULL;
 		}
 
+		surface_p->extra_data_len = c->video_extra_data_len;
 		surface->decoder_private = surface_p;
 		surface->decoder_private_free = h264_video_private_free;
 	}
@@ -206,7 +196,7 @@ static void ref_pic_list_modification(h264_context_t *c)
 
 	if (h->slice_type != SLICE_TYPE_I && h->slice_type != SLICE_TYPE_SI)
 	{
-		int ref_pic_list_modification_flag_l0 = get_u(c->regs, 1);
+		int ref_pic_list_modification_flag_l0 = get_u(&c->bs, 1);
 		if (ref_pic_list_modification_flag_l0)
 		{
 			unsigned int modification_of_pic_nums_idc;
@@ -217,10 +207,10 @@ static void ref_pic_list_modification(h264_context_t *c)
 
 			do
 			{
-				modification_of_pic_nums_idc = get_ue(c->regs);
+				modification_of_pic_nums_idc = get_ue(&c->bs);
 				if (modification_of_pic_nums_idc == 0 || modification_of_pic_nums_idc == 1)
 				{
-					unsigned int abs_diff_pic_num_minus1 = get_ue(c->regs);
+					unsigned int abs_diff_pic_num_minus1 = get_ue(&c->bs);
 
 					if (modification_of_pic_nums_idc == 0)
 						picNumL0 -= (abs_diff_pic_num_minus1 + 1);
@@ -261,7 +251,7 @@ static void ref_pic_list_modification(h264_context_t *c)
 				else if (modification_of_pic_nums_idc == 2)
 				{
 					VDPAU_DBG("NOT IMPLEMENTED: modification_of_pic_nums_idc == 2");
-					unsigned int long_term_pic_num = get_ue(c->regs);
+					unsigned int long_term_pic_num = get_ue(&c->bs);
 				}
 			} while (modification_of_pic_nums_idc != 3);
 		}
@@ -269,35 +259,43 @@ static void ref_pic_list_modification(h264_context_t *c)
 
 	if (h->slice_type == SLICE_TYPE_B)
 	{
-		int ref_pic_list_modification_flag_l1 = get_u(c->regs, 1);
+		int ref_pic_list_modification_flag_l1 = get_u(&c->bs, 1);
 		if (ref_pic_list_modification_flag_l1)
 		{
 			VDPAU_DBG("NOT IMPLEMENTED: ref_pic_list_modification_flag_l1 == 1");
 			unsigned int modification_of_pic_nums_idc;
 			do
 			{
-				modification_of_pic_nums_idc = get_ue(c->regs);
+				modification_of_pic_nums_idc = get_ue(&c->bs);
 				if (modification_of_pic_nums_idc == 0 || modification_of_pic_nums_idc == 1)
 				{
-					unsigned int abs_diff_pic_num_minus1 = get_ue(c->regs);
+					unsigned int abs_diff_pic_num_minus1 = get_ue(&c->bs);
 				}
 				else if (modification_of_pic_nums_idc == 2)
 				{
-					unsigned int long_term_pic_num = get_ue(c->regs);
+					unsigned int long_term_pic_num = get_ue(&c->bs);
 				}
 			} while (modification_of_pic_nums_idc != 3);
 		}
 	}
 }
 
+static int has_pred_weight_table(h264_context_t *c)
+{
+	h264_header_t *h = &c->header;
+	VdpPictureInfoH264 const *info = c->info;
+
+	return (info->weighted_pred_flag && (h->slice_type == SLICE_TYPE_P || h->slice_type == SLICE_TYPE_SP)) || (info->weighted_bipred_idc == 1 && h->slice_type == SLICE_TYPE_B);
+}
+
 static void pred_weight_table(h264_context_t *c)
 {
 	h264_header_t *h = &c->header;
 	int i, j, ChromaArrayType = 1;
 
-	h->luma_log2_weight_denom = get_ue(c->regs);
+	h->luma_log2_weight_denom = get_ue(&c->bs);
 	if (ChromaArrayType != 0)
-		h->chroma_log2_weight_denom = get_ue(c->regs);
+		h->chroma_log2_weight_denom = get_ue(&c->bs);
 
 	for (i = 0; i < 32; i++)
 	{
@@ -311,20 +309,20 @@ static void pred_weight_table(h264_context_t *c)
 
 	for (i = 0; i <= h->num_ref_idx_l0_active_minus1; i++)
 	{
-		int luma_weight_l0_flag = get_u(c->regs, 1);
+		int luma_weight_l0_flag = get_u(&c->bs, 1);
 		if (luma_weight_l0_flag)
 		{
-			h->luma_weight_l0[i] = get_se(c->regs);
-			h->luma_offset_l0[i] = get_se(c->regs);
+			h->luma_weight_l0[i] = get_se(&c->bs);
+			h->luma_offset_l0[i] = get_se(&c->bs);
 		}
 		if (ChromaArrayType != 0)
 		{
-			int chroma_weight_l0_flag = get_u(c->regs, 1);
+			int chroma_weight_l0_flag = get_u(&c->bs, 1);
 			if (chroma_weight_l0_flag)
 				for (j = 0; j < 2; j++)
 				{
-					h->chroma_weight_l0[i][j] = get_se(c->regs);
-					h->chroma_offset_l0[i][j] = get_se(c->regs);
+					h->chroma_weight_l0[i][j] = get_se(&c->bs);
+					h->chroma_offset_l0[i][j] = get_se(&c->bs);
 				}
 		}
 	}
@@ -332,23 +330,29 @@ static void pred_weight_table(h264_context_t *c)
 	if (h->slice_type == SLICE_TYPE_B)
 		for (i = 0; i <= h->num_ref_idx_l1_active_minus1; i++)
 		{
-			int luma_weight_l1_flag = get_u(c->regs, 1);
+			int luma_weight_l1_flag = get_u(&c->bs, 1);
 			if (luma_weight_l1_flag)
 			{
-				h->luma_weight_l1[i] = get_se(c->regs);
-				h->luma_offset_l1[i] = get_se(c->regs);
+				h->luma_weight_l1[i] = get_se(&c->bs);
+				h->luma_offset_l1[i] = get_se(&c->bs);
 			}
 			if (ChromaArrayType != 0)
 			{
-				int chroma_weight_l1_flag = get_u(c->regs, 1);
+				int chroma_weight_l1_flag = get_u(&c->bs, 1);
 				if (chroma_weight_l1_flag)
 					for (j = 0; j < 2; j++)
 					{
-						h->chroma_weight_l1[i][j] = get_se(c->regs);
-						h->chroma_offset_l1[i][j] = get_se(c->regs);
+						h->chroma_weight_l1[i][j] = get_se(&c->bs);
+						h->chroma_offset_l1[i][j] = get_se(&c->bs);
 					}
 			}
 		}
+}
+
+static void write_pred_weight_table(h264_context_t *c)
+{
+	h264_header_t *h = &c->header;
+	int i, j;
 
 	writel(((h->chroma_log2_weight_denom & 0xf) << 4)
 		| ((h->luma_log2_weight_denom & 0xf) << 0)
@@ -377,33 +381,33 @@ static void dec_ref_pic_marking(h264_context_t *c)
 	// only reads bits to allow decoding, doesn't mark anything
 	if (h->nal_unit_type == 5)
 	{
-		get_u(c->regs, 1);
-		get_u(c->regs, 1);
+		get_u(&c->bs, 1);
+		get_u(&c->bs, 1);
 	}
 	else
 	{
-		int adaptive_ref_pic_marking_mode_flag = get_u(c->regs, 1);
+		int adaptive_ref_pic_marking_mode_flag = get_u(&c->bs, 1);
 		if (adaptive_ref_pic_marking_mode_flag)
 		{
 			unsigned int memory_management_control_operation;
 			do
 			{
-				memory_management_control_operation = get_ue(c->regs);
+				memory_management_control_operation = get_ue(&c->bs);
 				if (memory_management_control_operation == 1 || memory_management_control_operation == 3)
 				{
-					get_ue(c->regs);
+					get_ue(&c->bs);
 				}
 				if (memory_management_control_operation == 2)
 				{
-					get_ue(c->regs);
+					get_ue(&c->bs);
 				}
 				if (memory_management_control_operation == 3 || memory_management_control_operation == 6)
 				{
-					get_ue(c->regs);
+					get_ue(&c->bs);
 				}
 				if (memory_management_control_operation == 4)
 				{
-					get_ue(c->regs);
+					get_ue(&c->bs);
 				}
 			} while (memory_management_control_operation != 0);
 		}
@@ -420,20 +424,26 @@ static int pic_order_cnt(const h264_picture_t *pic)
 		return pic->bottom_pic_order_cnt;
 }
 
-static int sort_ref_pics_by_poc(const void *p1, const void *p2)
+// the reference set changes by about one frame per picture, so both orders are nearly sorted already
+static void sort_ref_pics(h264_context_t *c)
 {
-	const h264_picture_t *r1 = p1;
-	const h264_picture_t *r2 = p2;
+	int i, j;
 
-	return pic_order_cnt(r1) - pic_order_cnt(r2);
-}
-
-static int sort_ref_pics_by_frame_num(const void *p1, const void *p2)
-{
-	const h264_picture_t *r1 = p1;
-	const h264_picture_t *r2 = p2;
+	for (i = 1; i < c->ref_count; i++)
+	{
+		h264_picture_t tmp = c->ref_pic[i];
+		for (j = i; j > 0 && c->ref_pic[j - 1].frame_idx > tmp.frame_idx; j--)
+			c->ref_pic[j] = c->ref_pic[j - 1];
+		c->ref_pic[j] = tmp;
+	}
 
-	return r1->frame_idx - r2->frame_idx;
+	for (i = 0; i < c->ref_count; i++)
+	{
+		h264_picture_t *tmp = &c->ref_pic[i];
+		for (j = i; j > 0 && pic_order_cnt(c->ref_pic_by_poc[j - 1]) > pic_order_cnt(tmp); j--)
+			c->ref_pic_by_poc[j] = c->ref_pic_by_poc[j - 1];
+		c->ref_pic_by_poc[j] = tmp;
+	}
 }
 
 static void split_ref_fields(h264_picture_t *out, h264_picture_t **in, int len, int cur_field)
@@ -471,8 +481,6 @@ static void fill_default_ref_pic_list(h264_context_t *c)
 
 	if (h->slice_type == SLICE_TYPE_P)
 	{
-		qsort(c->ref_pic, c->ref_count, sizeof(c->ref_pic[0]), &sort_ref_pics_by_frame_num);
-
 		int i;
 		int ptr0 = 0;
 		h264_picture_t *sorted[16];
@@ -491,8 +499,6 @@ static void fill_default_ref_pic_list(h264_context_t *c)
 	}
 	else if (h->slice_type == SLICE_TYPE_B)
 	{
-		qsort(c->ref_pic, c->ref_count, sizeof(c->ref_pic[0]), &sort_ref_pics_by_poc);
-
 		int cur_poc;
 		if (h->field_pic_flag)
 			cur_poc = (uint16_t)info->field_order_cnt[cur_field == PIC_BOTTOM_FIELD];
@@ -501,22 +507,23 @@ static void fill_default_ref_pic_list(h264_context_t *c)
 
 		int i;
 		int ptr0 = 0, ptr1 = 0;
+		h264_picture_t **by_poc = c->ref_pic_by_poc;
 		h264_picture_t *sorted[2][16];
 		for (i = 0; i < c->ref_count; i++)
 		{
-			if (pic_order_cnt(&c->ref_pic[c->ref_count - 1 - i]) <= cur_poc)
-				sorted[0][ptr0++] = &c->ref_pic[c->ref_count - 1  - i];
+			if (pic_order_cnt(by_poc[c->ref_count - 1 - i]) <= cur_poc)
+				sorted[0][ptr0++] = by_poc[c->ref_count - 1  - i];
 
-			if (pic_order_cnt(&c->ref_pic[i]) > cur_poc)
-				sorted[1][ptr1++] = &c->ref_pic[i];
+			if (pic_order_cnt(by_poc[i]) > cur_poc)
+				sorted[1][ptr1++] = by_poc[i];
 		}
 		for (i = 0; i < c->ref_count; i++)
 		{
-			if (pic_order_cnt(&c->ref_pic[i]) > cur_poc)
-				sorted[0][ptr0++] = &c->ref_pic[i];
+			if (pic_order_cnt(by_poc[i]) > cur_poc)
+				sorted[0][ptr0++] = by_poc[i];
 
-			if (pic_order_cnt(&c->ref_pic[c->ref_count - 1 - i]) <= cur_poc)
-				sorted[1][ptr1++] = &c->ref_pic[c->ref_count - 1 - i];
+			if (pic_order_cnt(by_poc[c->ref_count - 1 - i]) <= cur_poc)
+				sorted[1][ptr1++] = by_poc[c->ref_count - 1 - i];
 		}
 
 		split_ref_fields(h->RefPicList0, sorted[0], c->ref_count, cur_field);
@@ -531,56 +538,56 @@ static void decode_slice_header(h264_context_t *c)
 	h->num_ref_idx_l0_active_minus1 = info->num_ref_idx_l0_active_minus1;
 	h->num_ref_idx_l1_active_minus1 = info->num_ref_idx_l1_active_minus1;
 
-	h->first_mb_in_slice = get_ue(c->regs);
-	h->slice_type = get_ue(c->regs);
+	h->first_mb_in_slice = get_ue(&c->bs);
+	h->slice_type = get_ue(&c->bs);
 	if (h->slice_type >= 5)
 		h->slice_type -= 5;
-	h->pic_parameter_set_id = get_ue(c->regs);
+	h->pic_parameter_set_id = get_ue(&c->bs);
 
 	// separate_colour_plane_flag isn't available in VDPAU
 	/*if (separate_colour_plane_flag == 1)
 		colour_plane_id u(2)*/
 
-	h->frame_num = get_u(c->regs, info->log2_max_frame_num_minus4 + 4);
+	h->frame_num = get_u(&c->bs, info->log2_max_frame_num_minus4 + 4);
 
 	if (!info->frame_mbs_only_flag)
 	{
-		h->field_pic_flag = get_u(c->regs, 1);
+		h->field_pic_flag = get_u(&c->bs, 1);
 		if (h->field_pic_flag)
-			h->bottom_field_flag = get_u(c->regs, 1);
+			h->bottom_field_flag = get_u(&c->bs, 1);
 	}
 
 	if (h->nal_unit_type == 5)
-		h->idr_pic_id = get_ue(c->regs);
+		h->idr_pic_id = get_ue(&c->bs);
 
 	if (info->pic_order_cnt_type == 0)
 	{
-		h->pic_order_cnt_lsb = get_u(c->regs, info->log2_max_pic_order_cnt_lsb_minus4 + 4);
+		h->pic_order_cnt_lsb = get_u(&c->bs, info->log2_max_pic_order_cnt_lsb_minus4 + 4);
 		if (info->pic_order_present_flag && !info->field_pic_flag)
-			h->delta_pic_order_cnt_bottom = get_se(c->regs);
+			h->delta_pic_order_cnt_bottom = get_se(&c->bs);
 	}
 
 	if (info->pic_order_cnt_type == 1 && !info->delta_pic_order_always_zero_flag)
 	{
-		h->delta_pic_order_cnt[0] = get_se(c->regs);
+		h->delta_pic_order_cnt[0] = get_se(&c->bs);
 		if (info->pic_order_present_flag && !info->field_pic_flag)
-			h->delta_pic_order_cnt[1] = get_se(c->regs);
+			h->delta_pic_order_cnt[1] = get_se(&c->bs);
 	}
 
 	if (info->redundant_pic_cnt_present_flag)
-		h->redundant_pic_cnt = get_ue(c->regs);
+		h->redundant_pic_cnt = get_ue(&c->bs);
 
 	if (h->slice_type == SLICE_TYPE_B)
-		h->direct_spatial_mv_pred_flag = get_u(c->regs, 1);
+		h->direct_spatial_mv_pred_flag = get_u(&c->bs, 1);
 
 	if (h->slice_type == SLICE_TYPE_P || h->slice_type == SLICE_TYPE_SP || h->slice_type == SLICE_TYPE_B)
 	{
-		h->num_ref_idx_active_override_flag = get_u(c->regs, 1);
+		h->num_ref_idx_active_override_flag = get_u(&c->bs, 1);
 		if (h->num_ref_idx_active_override_flag)
 		{
-			h->num_ref_idx_l0_active_minus1 = get_ue(c->regs);
+			h->num_ref_idx_l0_active_minus1 = get_ue(&c->bs);
 			if (h->slice_type == SLICE_TYPE_B)
-				h->num_ref_idx_l1_active_minus1 = get_ue(c->regs);
+				h->num_ref_idx_l1_active_minus1 = get_ue(&c->bs);
 		}
 	}
 
@@ -591,31 +598,31 @@ static void decode_slice_header(h264_context_t *c)
 	else
 		ref_pic_list_modification(c);
 
-	if ((info->weighted_pred_flag && (h->slice_type == SLICE_TYPE_P || h->slice_type == SLICE_TYPE_SP)) || (info->weighted_bipred_idc == 1 && h->slice_type == SLICE_TYPE_B))
+	if (has_pred_weight_table(c))
 		pred_weight_table(c);
 
 	if (info->is_reference)
 		dec_ref_pic_marking(c);
 
 	if (info->entropy_coding_mode_flag && h->slice_type != SLICE_TYPE_I && h->slice_type != SLICE_TYPE_SI)
-		h->cabac_init_idc = get_ue(c->regs);
+		h->cabac_init_idc = get_ue(&c->bs);
 
-	h->slice_qp_delta = get_se(c->regs);
+	h->slice_qp_delta = get_se(&c->bs);
 
 	if (h->slice_type == SLICE_TYPE_SP || h->slice_type == SLICE_TYPE_SI)
 	{
 		if (h->slice_type == SLICE_TYPE_SP)
-			h->sp_for_switch_flag = get_u(c->regs, 1);
-		h->slice_qs_delta = get_se(c->regs);
+			h->sp_for_switch_flag = get_u(&c->bs, 1);
+		h->slice_qs_delta = get_se(&c->bs);
 	}
 
 	if (info->deblocking_filter_control_present_flag)
 	{
-		h->disable_deblocking_filter_idc = get_ue(c->regs);
+		h->disable_deblocking_filter_idc = get_ue(&c->bs);
 		if (h->disable_deblocking_filter_idc != 1)
 		{
-			h->slice_alpha_c0_offset_div2 = get_se(c->regs);
-			h->slice_beta_offset_div2 = get_se(c->regs);
+			h->slice_alpha_c0_offset_div2 = get_se(&c->bs);
+			h->slice_beta_offset_div2 = get_se(&c->bs);
 		}
 	}
 
@@ -625,87 +632,133 @@ static void decode_slice_header(h264_context_t *c)
 }
 
 
-static int fill_frame_lists(h264_context_t *c)
+static void update_ref_pic(h264_picture_t *pic, const VdpReferenceFrameH264 *rf)
 {
-	int i;
+	if (rf->is_long_term)
+		VDPAU_DBG("NOT IMPLEMENTED: We got a longterm reference!");
+
+	pic->top_pic_order_cnt = rf->field_order_cnt[0];
+	pic->bottom_pic_order_cnt = rf->field_order_cnt[1];
+	pic->frame_idx = rf->frame_idx;
+	pic->field =
+		(rf->top_is_reference ? PIC_TOP_FIELD : 0) |
+		(rf->bottom_is_reference ? PIC_BOTTOM_FIELD : 0);
+}
+
+static int fill_frame_lists(h264_context_t *c, decoder_ctx_t *decoder)
+{
+	int i, j;
+	h264_private_t *decoder_p = (h264_private_t *)decoder->private;
 	h264_video_private_t *output_p = (h264_video_private_t *)c->output->decoder_private;
 
+	// keep the references that are still in use, in their old order
+	int matched[16] = { 0 };
+	int count = 0;
+
+	for (i = 0; i < decoder_p->ref_count; i++)
+	{
+		for (j = 0; j < 16; j++)
+			if (!matched[j] && c->info->referenceFrames[j].surface == decoder_p->ref_handle[i])
+				break;
+
+		if (j == 16)
+			continue;
+
+		// the surface may have been destroyed or decoded by another
+		// decoder since the last picture, so look it up again
+		video_surface_ctx_t *surface = handle_get(decoder_p->ref_handle[i]);
+		if (!surface || !get_surface_priv(c, surface))
+		{
+			decoder_p->ref_count = count;
+			return 0;
+		}
+
+		matched[j] = 1;
+		decoder_p->ref_pic[count].surface = surface;
+		decoder_p->ref_handle[count] = decoder_p->ref_handle[i];
+		update_ref_pic(&decoder_p->ref_pic[count], &c->info->referenceFrames[j]);
+		count++;
+	}
+
+	// and add the new ones
+	for (j = 0; j < 16; j++)
+	{
+		const VdpReferenceFrameH264 *rf = &(c->info->referenceFrames[j]);
+		if (rf->surface == VDP_INVALID_HANDLE || matched[j])
+			continue;
+
+		video_surface_ctx_t *surface = handle_get(rf->surface);
+		if (!surface || !get_surface_priv(c, surface))
+		{
+			decoder_p->ref_count = count;
+			return 0;
+		}
+
+		decoder_p->ref_pic[count].surface = surface;
+		decoder_p->ref_handle[count] = rf->surface;
+		update_ref_pic(&decoder_p->ref_pic[count], rf);
+		count++;
+	}
+
+	decoder_p->ref_count = count;
+	c->ref_count = count;
+	c->ref_pic = decoder_p->ref_pic;
+	sort_ref_pics(c);
+
 	// collect reference frames
 	h264_picture_t *frame_list[18];
 	memset(frame_list, 0, sizeof(frame_list));
 
 	int output_placed = 0;
 
-	for (i = 0; i < 16; i++)
+	for (i = 0; i < c->ref_count; i++)
 	{
-		const VdpReferenceFrameH264 *rf = &(c->info->referenceFrames[i]);
-		if (rf->surface != VDP_INVALID_HANDLE)
-		{
-			if (rf->is_long_term)
-				VDPAU_DBG("NOT IMPLEMENTED: We got a longterm reference!");
-
-			video_surface_ctx_t *surface = handle_get(rf->surface);
-			h264_video_private_t *surface_p = get_surface_priv(c, surface);
-			if (!surface_p)
-				return 0;
-
-			if (surface == c->output)
-				output_placed = 1;
-
-			c->ref_pic[c->ref_count].surface = surface;
-			c->ref_pic[c->ref_count].top_pic_order_cnt = rf->field_order_cnt[0];
-			c->ref_pic[c->ref_count].bottom_pic_order_cnt = rf->field_order_cnt[1];
-			c->ref_pic[c->ref_count].frame_idx = rf->frame_idx;
-			c->ref_pic[c->ref_count].field =
-				(rf->top_is_reference ? PIC_TOP_FIELD : 0) |
-				(rf->bottom_is_reference ? PIC_BOTTOM_FIELD : 0);
-
-			frame_list[surface_p->pos] = &c->ref_pic[c->ref_count];
-			c->ref_count++;
-		}
+		h264_video_private_t *surface_p = (h264_video_private_t *)c->ref_pic[i].surface->decoder_private;
+
+		if (c->ref_pic[i].surface == c->output)
+			output_placed = 1;
+
+		frame_list[surface_p->pos] = &c->ref_pic[i];
 	}
 
-	// write picture buffer list
-	writel(VE_SRAM_H264_FRAMEBUFFER_LIST, c->regs + VE_H264_RAM_WRITE_PTR);
+	// build picture buffer list, only changed entries get written to SRAM
+	uint32_t list[18][8];
+	memset(list, 0, sizeof(list));
 
 	for (i = 0; i < 18; i++)
 	{
 		if (!output_placed && !frame_list[i])
 		{
-			writel((uint16_t)c->info->field_order_cnt[0], c->regs + VE_H264_RAM_WRITE_DATA);
-			writel((uint16_t)c->info->field_order_cnt[1], c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(output_p->pic_type << 8, c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(cedrus_mem_get_bus_addr(c->output->rec), c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(cedrus_mem_get_bus_addr(c->output->rec) + c->output->luma_size, c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(cedrus_mem_get_bus_addr(output_p->extra_data), c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(cedrus_mem_get_bus_addr(output_p->extra_data) + c->video_extra_data_len, c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(0, c->regs + VE_H264_RAM_WRITE_DATA);
+			list[i][0] = (uint16_t)c->info->field_order_cnt[0];
+			list[i][1] = (uint16_t)c->info->field_order_cnt[1];
+			list[i][2] = output_p->pic_type << 8;
+			list[i][3] = arena_get_bus_addr(c->output->rec);
+			list[i][4] = arena_get_bus_addr(c->output->rec) + c->output->luma_size;
+			list[i][5] = arena_get_bus_addr(output_p->extra_data);
+			list[i][6] = arena_get_bus_addr(output_p->extra_data) + c->video_extra_data_len;
 
 			output_p->pos = i;
 			output_placed = 1;
 		}
-		else if (!frame_list[i])
-		{
-			int j;
-			for (j = 0; j < 8; j++)
-				writel(0x0, c->regs + VE_H264_RAM_WRITE_DATA);
-		}
-		else
+		else if (frame_list[i])
 		{
 			video_surface_ctx_t *surface = frame_list[i]->surface;
 			h264_video_private_t *surface_p = (h264_video_private_t *)surface->decoder_private;
 
-			writel(frame_list[i]->top_pic_order_cnt, c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(frame_list[i]->bottom_pic_order_cnt, c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(surface_p->pic_type << 8, c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(cedrus_mem_get_bus_addr(surface->rec), c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(cedrus_mem_get_bus_addr(surface->rec) + surface->luma_size, c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(cedrus_mem_get_bus_addr(surface_p->extra_data), c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(cedrus_mem_get_bus_addr(surface_p->extra_data) + c->video_extra_data_len, c->regs + VE_H264_RAM_WRITE_DATA);
-			writel(0, c->regs + VE_H264_RAM_WRITE_DATA);
+			list[i][0] = frame_list[i]->top_pic_order_cnt;
+			list[i][1] = frame_list[i]->bottom_pic_order_cnt;
+			list[i][2] = surface_p->pic_type << 8;
+			list[i][3] = arena_get_bus_addr(surface->rec);
+			list[i][4] = arena_get_bus_addr(surface->rec) + surface->luma_size;
+			list[i][5] = arena_get_bus_addr(surface_p->extra_data);
+			list[i][6] = arena_get_bus_addr(surface_p->extra_data) + c->video_extra_data_len;
 		}
 	}
 
+	ve_shadow_upload(&decoder->shadow, VE_SHADOW_TABLE_H264_FRAMEBUFFER_LIST, c->regs,
+	                 VE_H264_RAM_WRITE_PTR, VE_H264_RAM_WRITE_DATA, VE_SRAM_H264_FRAMEBUFFER_LIST,
+	                 &list[0][0], 18 * 8, 8);
+
 	// output index
 	writel(output_p->pos, c->regs + VE_H264_OUTPUT_FRAME_IDX);
 
@@ -738,15 +791,10 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder,
 	h264_private_t *decoder_p = (h264_private_t *)decoder->private;
 	VdpPictureInfoH264 const *info = (VdpPictureInfoH264 const *)_info;
 
-	VdpStatus ret = yuv_prepare(output);
-	if (ret != VDP_STATUS_OK)
-		return ret;
-
-	ret = rec_prepare(output);
-	if (ret != VDP_STATUS_OK)
-		return ret;
+	VdpStatus ret;
 
-	h264_context_t *c = calloc(1, sizeof(h264_context_t));
+	h264_context_t *c = &decoder_p->context;
+	memset(c, 0, sizeof(*c));
 	c->picture_width_in_mbs_minus1 = (decoder->width - 1) / 16;
 	if (!info->frame_mbs_only_flag)
 		c->picture_height_in_mbs_minus1 = ((decoder->height / 2) - 1) / 16;
@@ -760,7 +808,7 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder,
 	if (!output_p)
 	{
 		ret = VDP_STATUS_RESOURCES;
-		goto err_free;
+		goto err_out;
 	}
 
 	if (info->field_pic_flag)
@@ -772,9 +820,10 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder,
 
 	// activate H264 engine
 	c->regs = cedrus_ve_get(decoder->device->cedrus, CEDRUS_ENGINE_H264, (decoder->width >= 2048 ? 0x1 : 0x0) << 21);
+	ve_shadow_begin(&decoder->shadow, decoder->device);
 
 	// some buffers
-	uint32_t extra_buffers = cedrus_mem_get_bus_addr(decoder_p->extra_data);
+	uint32_t extra_buffers = arena_get_bus_addr(decoder_p->extra_data);
 	writel(extra_buffers, c->regs + VE_H264_EXTRA_BUFFER1);
 	writel(extra_buffers + 0x48000, c->regs + VE_H264_EXTRA_BUFFER2);
 	if (cedrus_get_ve_version(decoder->device->cedrus) == 0x1625 || decoder->width >= 2048)
@@ -792,40 +841,54 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder,
 		const uint32_t *sl4 = (uint32_t *)&c->info->scaling_lists_4x4[0][0];
 		const uint32_t *sl8 = (uint32_t *)&c->info->scaling_lists_8x8[0][0];
 
-		writel(VE_SRAM_H264_SCALING_LISTS, c->regs + VE_H264_RAM_WRITE_PTR);
+		uint8_t sl[2 * 64 + 6 * 16];
+		memcpy(sl, sl8, 2 * 64);
+		memcpy(sl + 2 * 64, sl4, 6 * 16);
 
-		int i;
-		for (i = 0; i < 2 * 64 / 4; i++)
-			writel(sl8[i], c->regs + VE_H264_RAM_WRITE_DATA);
+		if (ve_shadow_table_changed(&decoder->shadow, VE_SHADOW_TABLE_H264_SCALING_LISTS, sl, sizeof(sl), 1 + sizeof(sl) / 4))
+		{
+			writel(VE_SRAM_H264_SCALING_LISTS, c->regs + VE_H264_RAM_WRITE_PTR);
+
+			int i;
+			for (i = 0; i < 2 * 64 / 4; i++)
+				writel(sl8[i], c->regs + VE_H264_RAM_WRITE_DATA);
 
-		for (i = 0; i < 6 * 16 / 4; i++)
-			writel(sl4[i], c->regs + VE_H264_RAM_WRITE_DATA);
+			for (i = 0; i < 6 * 16 / 4; i++)
+				writel(sl4[i], c->regs + VE_H264_RAM_WRITE_DATA);
+		}
 	}
 
 	// sdctrl
-	writel(0x00000000, c->regs + VE_H264_SDROT_CTRL);
+	writel(video_surface_sdrot_ctrl(c->output), c->regs + VE_H264_SDROT_CTRL);
 	if (cedrus_get_ve_version(decoder->device->cedrus) >= 0x1680)
 	{
-		writel(cedrus_mem_get_bus_addr(c->output->yuv->data), c->regs + VE_H264_SDROT_LUMA);
-		writel(cedrus_mem_get_bus_addr(c->output->yuv->data) + c->output->luma_size, c->regs + VE_H264_SDROT_CHROMA);
-		writel((0x2 << 30) | (0x1 << 28) | (c->output->chroma_size / 2), c->regs + VE_EXTRA_OUT_FMT_OFFSET);
+		writel(arena_get_bus_addr(c->output->yuv->data), c->regs + VE_H264_SDROT_LUMA);
+		writel(arena_get_bus_addr(c->output->yuv->data) + c->output->offsets[1], c->regs + VE_H264_SDROT_CHROMA);
+		writel((0x2 << 30) | (0x1 << 28) | (c->output->offsets[2] - c->output->offsets[1]), c->regs + VE_EXTRA_OUT_FMT_OFFSET);
 	}
 
-	if (!fill_frame_lists(c))
+	if (!fill_frame_lists(c, decoder))
 	{
 		ret = VDP_STATUS_ERROR;
 		goto err_ve_put;
 	}
 
-	unsigned int slice, pos = 0;
+	unsigned int slice, pos;
 	for (slice = 0; slice < info->slice_count; slice++)
 	{
 		h264_header_t *h = &c->header;
 		memset(h, 0, sizeof(h264_header_t));
 
-		pos = find_startcode(cedrus_mem_get_pointer(decoder->data), len, pos) + 3;
+		if (slice >= decoder->vbv->num_startcodes)
+		{
+			ret = VDP_STATUS_ERROR;
+			goto err_ve_put;
+		}
+
+		pos = decoder->vbv->startcodes[slice];
 
-		h->nal_unit_type = ((uint8_t *)cedrus_mem_get_pointer(decoder->data))[pos++] & 0x1f;
+		const uint8_t *data = cedrus_mem_get_pointer(decoder->vbv->data);
+		h->nal_unit_type = data[pos++] & 0x1f;
 
 		if (h->nal_unit_type != 5 && h->nal_unit_type != 1)
 		{
@@ -833,22 +896,41 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder,
 			goto err_ve_put;
 		}
 
+		bitstream_init(&c->bs, data, len, pos);
+		decode_slice_header(c);
+
 		// Enable startcode detect and ??
 		writel((0x1 << 25) | (0x1 << 10) | ((cedrus_get_ve_version(decoder->device->cedrus) >= 0x1680) << 9), c->regs + VE_H264_CTRL);
 
+		/*
+		 * Start the VLD right at the first macroblock, unless the VE
+		 * could miss an emulation prevention byte there. In that case
+		 * start at the slice header and let the VE skip over it.
+		 */
+		unsigned int offset = bitstream_raw_offset(&c->bs), skip = 0;
+		if (!offset)
+		{
+			offset = pos * 8;
+			skip = c->bs.rbsp_bits;
+		}
+
 		// input buffer
-		writel((len - pos) * 8, c->regs + VE_H264_VLD_LEN);
-		writel(pos * 8, c->regs + VE_H264_VLD_OFFSET);
-		uint32_t input_addr = cedrus_mem_get_bus_addr(decoder->data);
-		writel(input_addr + VBV_SIZE - 1, c->regs + VE_H264_VLD_END);
+		writel(len * 8 - offset, c->regs + VE_H264_VLD_LEN);
+		writel(offset, c->regs + VE_H264_VLD_OFFSET);
+		uint32_t input_addr = cedrus_mem_get_bus_addr(decoder->vbv->data);
+		writel(input_addr + decoder->vbv->size - 1, c->regs + VE_H264_VLD_END);
 		writel((input_addr & 0x0ffffff0) | (input_addr >> 28) | (0x7 << 28), c->regs + VE_H264_VLD_ADDR);
 
 		// ?? some sort of reset maybe
 		writel(0x7, c->regs + VE_H264_TRIGGER);
 
-		int i;
+		if (skip)
+			skip_bits(c->regs, skip);
 
-		decode_slice_header(c);
+		if (has_pred_weight_table(c))
+			write_pred_weight_table(c);
+
+		int i;
 
 		// write RefPicLists
 		if (h->slice_type != SLICE_TYPE_I && h->slice_type != SLICE_TYPE_SI)
@@ -885,23 +967,23 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder,
 		}
 
 		// picture parameters
-		writel(((info->entropy_coding_mode_flag & 0x1) << 15)
+		ve_shadow_writel(&decoder->shadow, ((info->entropy_coding_mode_flag & 0x1) << 15)
 			| ((info->num_ref_idx_l0_active_minus1 & 0x1f) << 10)
 			| ((info->num_ref_idx_l1_active_minus1 & 0x1f) << 5)
 			| ((info->weighted_pred_flag & 0x1) << 4)
 			| ((info->weighted_bipred_idc & 0x3) << 2)
 			| ((info->constrained_intra_pred_flag & 0x1) << 1)
 			| ((info->transform_8x8_mode_flag & 0x1) << 0)
-			, c->regs + VE_H264_PIC_HDR);
+			, c->regs, VE_H264_PIC_HDR);
 
 		// sequence parameters
-		writel((0x1 << 19)
+		ve_shadow_writel(&decoder->shadow, (0x1 << 19)
 			| ((c->info->frame_mbs_only_flag & 0x1) << 18)
 			| ((c->info->mb_adaptive_frame_field_flag & 0x1) << 17)
 			| ((c->info->direct_8x8_inference_flag & 0x1) << 16)
 			| ((c->picture_width_in_mbs_minus1 & 0xff) << 8)
 			| ((c->picture_height_in_mbs_minus1 & 0xff) << 0)
-			, c->regs + VE_H264_FRAME_SIZE);
+			, c->regs, VE_H264_FRAME_SIZE);
 
 		// slice parameters
 		writel((((h->first_mb_in_slice % (c->picture_width_in_mbs_minus1 + 1)) & 0xff) << 24)
@@ -943,17 +1025,15 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder,
 
 		// clear status flags
 		writel(readl(c->regs + VE_H264_STATUS), c->regs + VE_H264_STATUS);
-
-		pos = (readl(c->regs + VE_H264_VLD_OFFSET) / 8) - 3;
 	}
 
 	ret = VDP_STATUS_OK;
 
 err_ve_put:
 	// stop H264 engine
+	ve_shadow_end(&decoder->shadow);
 	cedrus_ve_put(decoder->device->cedrus);
-err_free:
-	free(c);
+err_out:
 	return ret;
 }
 
@@ -972,7 +1052,7 @@ VdpStatus new_decoder_h264(decoder_ctx_t *decoder)
 		extra_data_size += ((decoder->width - 1) / 16 + 64) * 80;
 	}
 
-	decoder_p->extra_data = cedrus_mem_alloc(decoder->device->cedrus, extra_data_size);
+	decoder_p->extra_data = arena_alloc(decoder->device, extra_data_size);
 	if (!decoder_p->extra_data)
 	{
 		free(decoder_p);
@@ -23,22 +23,7 @@
 #include <cedrus/cedrus.h>
 #include <cedrus/cedrus_regs.h>
 #include "vdpau_private.h"
-
-static int find_startcode(const uint8_t *data, int len, int start)
-{
-	int pos, zeros = 0;
-	for (pos = start; pos < len; pos++)
-	{
-		if (data[pos] == 0x00)
-			zeros++;
-		else if (data[pos] == 0x01 && zeros >= 2)
-			return pos + 1;
-		else
-			zeros = 0;
-	}
-
-	return -1;
-}
+#include "bitstream.h"
 
 static void skip_bits(void *regs, int num)
 {
@@ -51,33 +36,6 @@ static void skip_bits(void *regs, int num)
 	while (readl(regs + VE_HEVC_STATUS) & (1 << 8));
 }
 
-static uint32_t get_u(void *regs, int num)
-{
-	writel(0x2 | (num << 8), regs + VE_HEVC_TRIG);
-
-	while (readl(regs + VE_HEVC_STATUS) & (1 << 8));
-
-	return readl(regs + VE_HEVC_BITS_DATA);
-}
-
-static uint32_t get_ue(void *regs)
-{
-	writel(0x5, regs + VE_HEVC_TRIG);
-
-	while (readl(regs + VE_HEVC_STATUS) & (1 << 8));
-
-	return readl(regs + VE_HEVC_BITS_DATA);
-}
-
-static int32_t get_se(void *regs)
-{
-	writel(0x4, regs + VE_HEVC_TRIG);
-
-	while (readl(regs + VE_HEVC_STATUS) & (1 << 8));
-
-	return readl(regs + VE_HEVC_BITS_DATA);
-}
-
 #define SLICE_B	0
 #define SLICE_P	1
 #define SLICE_I	2
@@ -154,26 +112,28 @@ struct h265_slice_header {
 struct h265_private
 {
 	void *regs;
+	bitstream_t bs;
 	VdpPictureInfoHEVC const *info;
 	decoder_ctx_t *decoder;
 	video_surface_ctx_t *output;
 	uint8_t nal_unit_type;
 
-	cedrus_mem_t *neighbor_info;
-	cedrus_mem_t *entry_points;
+	arena_mem_t *neighbor_info;
+	arena_mem_t *entry_points;
 
 	struct h265_slice_header slice;
 };
 
 struct h265_video_private
 {
-	cedrus_mem_t *extra_data;
+	arena_mem_t *extra_data;
+	int extra_data_size;
 };
 
 static void h265_video_private_free(video_surface_ctx_t *surface)
 {
 	struct h265_video_private *vp = surface->decoder_private;
-	cedrus_mem_free(vp->extra_data);
+	arena_free(vp->extra_data);
 	free(vp);
 }
 
@@ -181,19 +141,29 @@ static struct h265_video_private *get_surface_priv(struct h265_private *p, video
 {
 	struct h265_video_private *vp = surface->decoder_private;
 
+	// surfaces can come from another decoder or the surface pool
+	if (vp && (surface->decoder_private_free != h265_video_private_free ||
+	           vp->extra_data_size < PicSizeInCtbsY * 160))
+	{
+		surface->decoder_private_free(surface);
+		surface->decoder_private = vp = NULL;
+		surface->decoder_private_free = NULL;
+	}
+
 	if (!vp)
 	{
 		vp = calloc(1, sizeof(*vp));
 		if (!vp)
 			return NULL;
 
-		vp->extra_data = cedrus_mem_alloc(surface->device->cedrus, PicSizeInCtbsY * 160);
+		vp->extra_data = arena_alloc(surface->device, PicSizeInCtbsY * 160);
 		if (!vp->extra_data)
 		{
 			free(vp);
 			return NULL;
 		}
 
+		vp->extra_data_size = PicSizeInCtbsY * 160;
 		surface->decoder_private = vp;
 		surface->decoder_private_free = h265_video_private_free;
 	}
@@ -205,31 +175,31 @@ static void pred_weight_table(struct h265_private *p)
 {
 	int i, j;
 
-	p->slice.luma_log2_weight_denom = get_ue(p->regs);
+	p->slice.luma_log2_weight_denom = get_ue(&p->bs);
 	if (p->info->chroma_format_idc != 0)
-		p->slice.delta_chroma_log2_weight_denom = get_se(p->regs);
+		p->slice.delta_chroma_log2_weight_denom = get_se(&p->bs);
 
 	for (i = 0; i <= p->slice.num_ref_idx_l0_active_minus1; i++)
-		p->slice.luma_weight_l0_flag[i] = get_u(p->regs, 1);
+		p->slice.luma_weight_l0_flag[i] = get_u(&p->bs, 1);
 
 	if (p->info->chroma_format_idc != 0)
 		for (i = 0; i <= p->slice.num_ref_idx_l0_active_minus1; i++)
-			p->slice.chroma_weight_l0_flag[i] = get_u(p->regs, 1);
+			p->slice.chroma_weight_l0_flag[i] = get_u(&p->bs, 1);
 
 	for (i = 0; i <= p->slice.num_ref_idx_l0_active_minus1; i++)
 	{
 		if (p->slice.luma_weight_l0_flag[i])
 		{
-			p->slice.delta_luma_weight_l0[i] = get_se(p->regs);
-			p->slice.luma_offset_l0[i] = get_se(p->regs);
+			p->slice.delta_luma_weight_l0[i] = get_se(&p->bs);
+			p->slice.luma_offset_l0[i] = get_se(&p->bs);
 		}
 
 		if (p->slice.chroma_weight_l0_flag[i])
 		{
 			for (j = 0; j < 2; j++)
 			{
-				p->slice.delta_chroma_weight_l0[i][j] = get_se(p->regs);
-				p->slice.delta_chroma_offset_l0[i][j] = get_se(p->regs);
+				p->slice.delta_chroma_weight_l0[i][j] = get_se(&p->bs);
+				p->slice.delta_chroma_offset_l0[i][j] = get_se(&p->bs);
 			}
 		}
 	}
@@ -237,26 +207,26 @@ static void pred_weight_table(struct h265_private *p)
 	if (p->slice.slice_type == SLICE_B)
 	{
 		for (i = 0; i <= p->slice.num_ref_idx_l1_active_minus1; i++)
-			p->slice.luma_weight_l1_flag[i] = get_u(p->regs, 1);
+			p->slice.luma_weight_l1_flag[i] = get_u(&p->bs, 1);
 
 		if (p->info->chroma_format_idc != 0)
 			for (i = 0; i <= p->slice.num_ref_idx_l1_active_minus1; i++)
-				p->slice.chroma_weight_l1_flag[i] = get_u(p->regs, 1);
+				p->slice.chroma_weight_l1_flag[i] = get_u(&p->bs, 1);
 
 		for (i = 0; i <= p->slice.num_ref_idx_l1_active_minus1; i++)
 		{
 			if (p->slice.luma_weight_l1_flag[i])
 			{
-				p->slice.delta_luma_weight_l1[i] = get_se(p->regs);
-				p->slice.luma_offset_l1[i] = get_se(p->regs);
+				p->slice.delta_luma_weight_l1[i] = get_se(&p->bs);
+				p->slice.luma_offset_l1[i] = get_se(&p->bs);
 			}
 
 			if (p->slice.chroma_weight_l1_flag[i])
 			{
 				for (j = 0; j < 2; j++)
 				{
-					p->slice.delta_chroma_weight_l1[i][j] = get_se(p->regs);
-					p->slice.delta_chroma_offset_l1[i][j] = get_se(p->regs);
+					p->slice.delta_chroma_weight_l1[i][j] = get_se(&p->bs);
+					p->slice.delta_chroma_offset_l1[i][j] = get_se(&p->bs);
 				}
 			}
 		}
@@ -267,39 +237,39 @@ static void ref_pic_lists_modification(struct h265_private *p)
 {
 	int i;
 
-	p->slice.ref_pic_list_modification_flag_l0 = get_u(p->regs, 1);
+	p->slice.ref_pic_list_modification_flag_l0 = get_u(&p->bs, 1);
 
 	if (p->slice.ref_pic_list_modification_flag_l0)
 		for (i = 0; i <= p->slice.num_ref_idx_l0_active_minus1; i++)
-			p->slice.list_entry_l0[i] = get_u(p->regs, ceil_log2(p->info->NumPocTotalCurr));
+			p->slice.list_entry_l0[i] = get_u(&p->bs, ceil_log2(p->info->NumPocTotalCurr));
 
 	if (p->slice.slice_type == SLICE_B)
 	{
-		p->slice.ref_pic_list_modification_flag_l1 = get_u(p->regs, 1);
+		p->slice.ref_pic_list_modification_flag_l1 = get_u(&p->bs, 1);
 
 		if (p->slice.ref_pic_list_modification_flag_l1)
 			for (i = 0; i <= p->slice.num_ref_idx_l1_active_minus1; i++)
-				p->slice.list_entry_l1[i] = get_u(p->regs, ceil_log2(p->info->NumPocTotalCurr));
+				p->slice.list_entry_l1[i] = get_u(&p->bs, ceil_log2(p->info->NumPocTotalCurr));
 	}
 }
 
-static void slice_header(struct h265_private *p)
+static int slice_header(struct h265_private *p)
 {
 	int i;
 
-	p->slice.first_slice_segment_in_pic_flag = get_u(p->regs, 1);
+	p->slice.first_slice_segment_in_pic_flag = get_u(&p->bs, 1);
 
 	if (p->nal_unit_type >= 16 && p->nal_unit_type <= 23)
-		p->slice.no_output_of_prior_pics_flag = get_u(p->regs, 1);
+		p->slice.no_output_of_prior_pics_flag = get_u(&p->bs, 1);
 
-	p->slice.slice_pic_parameter_set_id = get_ue(p->regs);
+	p->slice.slice_pic_parameter_set_id = get_ue(&p->bs);
 
 	if (!p->slice.first_slice_segment_in_pic_flag)
 	{
 		if (p->info->dependent_slice_segments_enabled_flag)
-			p->slice.dependent_slice_segment_flag = get_u(p->regs, 1);
+			p->slice.dependent_slice_segment_flag = get_u(&p->bs, 1);
 
-		p->slice.slice_segment_address = get_u(p->regs, ceil_log2(PicSizeInCtbsY));
+		p->slice.slice_segment_address = get_u(&p->bs, ceil_log2(PicSizeInCtbsY));
 	}
 
 	if (!p->slice.dependent_slice_segment_flag)
@@ -314,113 +284,130 @@ static void slice_header(struct h265_private *p)
 		p->slice.slice_tc_offset_div2 = p->info->pps_tc_offset_div2;
 		p->slice.slice_loop_filter_across_slices_enabled_flag = p->info->pps_loop_filter_across_slices_enabled_flag;
 
-		skip_bits(p->regs, p->info->num_extra_slice_header_bits);
+		bitstream_skip(&p->bs, p->info->num_extra_slice_header_bits);
 
-		p->slice.slice_type = get_ue(p->regs);
+		p->slice.slice_type = get_ue(&p->bs);
 
 		if (p->info->output_flag_present_flag)
-			p->slice.pic_output_flag = get_u(p->regs, 1);
+			p->slice.pic_output_flag = get_u(&p->bs, 1);
 
 		if (p->info->separate_colour_plane_flag == 1)
-			p->slice.colour_plane_id = get_u(p->regs, 2);
+			p->slice.colour_plane_id = get_u(&p->bs, 2);
 
 		if (p->nal_unit_type != 19 && p->nal_unit_type != 20)
 		{
-			p->slice.slice_pic_order_cnt_lsb = get_u(p->regs, p->info->log2_max_pic_order_cnt_lsb_minus4 + 4);
+			p->slice.slice_pic_order_cnt_lsb = get_u(&p->bs, p->info->log2_max_pic_order_cnt_lsb_minus4 + 4);
 
-			p->slice.short_term_ref_pic_set_sps_flag = get_u(p->regs, 1);
+			p->slice.short_term_ref_pic_set_sps_flag = get_u(&p->bs, 1);
 
-			skip_bits(p->regs, p->info->NumShortTermPictureSliceHeaderBits);
+			bitstream_skip(&p->bs, p->info->NumShortTermPictureSliceHeaderBits);
 
 			if (p->info->long_term_ref_pics_present_flag)
-				skip_bits(p->regs, p->info->NumLongTermPictureSliceHeaderBits);
+				bitstream_skip(&p->bs, p->info->NumLongTermPictureSliceHeaderBits);
 
 			if (p->info->sps_temporal_mvp_enabled_flag)
-				p->slice.slice_temporal_mvp_enabled_flag = get_u(p->regs, 1);
+				p->slice.slice_temporal_mvp_enabled_flag = get_u(&p->bs, 1);
 		}
 
 		if (p->info->sample_adaptive_offset_enabled_flag)
 		{
-			p->slice.slice_sao_luma_flag = get_u(p->regs, 1);
-			p->slice.slice_sao_chroma_flag = get_u(p->regs, 1);
+			p->slice.slice_sao_luma_flag = get_u(&p->bs, 1);
+			p->slice.slice_sao_chroma_flag = get_u(&p->bs, 1);
 		}
 
 		if (p->slice.slice_type == SLICE_P || p->slice.slice_type == SLICE_B)
 		{
-			p->slice.num_ref_idx_active_override_flag = get_u(p->regs, 1);
+			p->slice.num_ref_idx_active_override_flag = get_u(&p->bs, 1);
 
 			if (p->slice.num_ref_idx_active_override_flag)
 			{
-				p->slice.num_ref_idx_l0_active_minus1 = get_ue(p->regs);
+				p->slice.num_ref_idx_l0_active_minus1 = get_ue(&p->bs);
 				if (p->slice.slice_type == SLICE_B)
-					p->slice.num_ref_idx_l1_active_minus1 = get_ue(p->regs);
+					p->slice.num_ref_idx_l1_active_minus1 = get_ue(&p->bs);
 			}
 
 			if (p->info->lists_modification_present_flag && p->info->NumPocTotalCurr > 1)
 				ref_pic_lists_modification(p);
 
 			if (p->slice.slice_type == SLICE_B)
-				p->slice.mvd_l1_zero_flag = get_u(p->regs, 1);
+				p->slice.mvd_l1_zero_flag = get_u(&p->bs, 1);
 
 			if (p->info->cabac_init_present_flag)
-				p->slice.cabac_init_flag = get_u(p->regs, 1);
+				p->slice.cabac_init_flag = get_u(&p->bs, 1);
 
 			if (p->slice.slice_temporal_mvp_enabled_flag)
 			{
 				if (p->slice.slice_type == SLICE_B)
-					p->slice.collocated_from_l0_flag = get_u(p->regs, 1);
+					p->slice.collocated_from_l0_flag = get_u(&p->bs, 1);
 
 				if ((p->slice.collocated_from_l0_flag && p->slice.num_ref_idx_l0_active_minus1 > 0) || (!p->slice.collocated_from_l0_flag && p->slice.num_ref_idx_l1_active_minus1 > 0))
-					p->slice.collocated_ref_idx = get_ue(p->regs);
+					p->slice.collocated_ref_idx = get_ue(&p->bs);
 			}
 
 			if ((p->info->weighted_pred_flag && p->slice.slice_type == SLICE_P) || (p->info->weighted_bipred_flag && p->slice.slice_type == SLICE_B))
 				pred_weight_table(p);
 
-			p->slice.five_minus_max_num_merge_cand = get_ue(p->regs);
+			p->slice.five_minus_max_num_merge_cand = get_ue(&p->bs);
 		}
 
-		p->slice.slice_qp_delta = get_se(p->regs);
+		p->slice.slice_qp_delta = get_se(&p->bs);
 
 		if (p->info->pps_slice_chroma_qp_offsets_present_flag)
 		{
-			p->slice.slice_cb_qp_offset = get_se(p->regs);
-			p->slice.slice_cr_qp_offset = get_se(p->regs);
+			p->slice.slice_cb_qp_offset = get_se(&p->bs);
+			p->slice.slice_cr_qp_offset = get_se(&p->bs);
 		}
 
 		if (p->info->deblocking_filter_override_enabled_flag)
-			p->slice.deblocking_filter_override_flag = get_u(p->regs, 1);
+			p->slice.deblocking_filter_override_flag = get_u(&p->bs, 1);
 
 		if (p->slice.deblocking_filter_override_flag)
 		{
-			p->slice.slice_deblocking_filter_disabled_flag = get_u(p->regs, 1);
+			p->slice.slice_deblocking_filter_disabled_flag = get_u(&p->bs, 1);
 
 			if (!p->slice.slice_deblocking_filter_disabled_flag)
 			{
-				p->slice.slice_beta_offset_div2 = get_se(p->regs);
-				p->slice.slice_tc_offset_div2 = get_se(p->regs);
+				p->slice.slice_beta_offset_div2 = get_se(&p->bs);
+				p->slice.slice_tc_offset_div2 = get_se(&p->bs);
 			}
 		}
 
 		if (p->info->pps_loop_filter_across_slices_enabled_flag && (p->slice.slice_sao_luma_flag || p->slice.slice_sao_chroma_flag || !p->slice.slice_deblocking_filter_disabled_flag))
-			p->slice.slice_loop_filter_across_slices_enabled_flag = get_u(p->regs, 1);
+			p->slice.slice_loop_filter_across_slices_enabled_flag = get_u(&p->bs, 1);
 	}
 
 	if (p->info->tiles_enabled_flag || p->info->entropy_coding_sync_enabled_flag)
 	{
-		p->slice.num_entry_point_offsets = get_ue(p->regs);
+		uint32_t num_entry_point_offsets = get_ue(&p->bs);
+
+		// more wouldn't fit the VE's entry point list, and the rest of the header couldn't be found
+		if (num_entry_point_offsets > ARRAY_SIZE(p->slice.entry_point_offset_minus1))
+			return 0;
+
+		p->slice.num_entry_point_offsets = num_entry_point_offsets;
 
 		if (p->slice.num_entry_point_offsets > 0)
 		{
-			p->slice.offset_len_minus1 = get_ue(p->regs);
+			uint32_t offset_len_minus1 = get_ue(&p->bs);
+			if (offset_len_minus1 > 31)
+				return 0;
+
+			p->slice.offset_len_minus1 = offset_len_minus1;
 
 			for (i = 0; i < p->slice.num_entry_point_offsets; i++)
-				p->slice.entry_point_offset_minus1[i] = get_u(p->regs, p->slice.offset_len_minus1 + 1);
+				p->slice.entry_point_offset_minus1[i] = get_u(&p->bs, p->slice.offset_len_minus1 + 1);
 		}
 	}
 
 	if (p->info->slice_segment_header_extension_present_flag)
-		skip_bits(p->regs, get_ue(p->regs) * 8);
+		bitstream_skip(&p->bs, get_ue(&p->bs) * 8);
+
+	// byte_alignment()
+	get_u(&p->bs, 1);
+	while (p->bs.bit)
+		get_u(&p->bs, 1);
+
+	return 1;
 }
 
 static void write_pic_list(struct h265_private *p)
@@ -437,10 +424,10 @@ static void write_pic_list(struct h265_private *p)
 			writel(VE_SRAM_HEVC_PIC_LIST + i * 0x20, p->regs + VE_HEVC_SRAM_ADDR);
 			writel(p->info->PicOrderCntVal[i], p->regs + VE_HEVC_SRAM_DATA);
 			writel(p->info->PicOrderCntVal[i], p->regs + VE_HEVC_SRAM_DATA);
-			writel(cedrus_mem_get_bus_addr(vp->extra_data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
-			writel(cedrus_mem_get_bus_addr(vp->extra_data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
-			writel(cedrus_mem_get_bus_addr(v->yuv->data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
-			writel((cedrus_mem_get_bus_addr(v->yuv->data) + v->luma_size) >> 8, p->regs + VE_HEVC_SRAM_DATA);
+			writel(arena_get_bus_addr(vp->extra_data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
+			writel(arena_get_bus_addr(vp->extra_data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
+			writel(arena_get_bus_addr(v->yuv->data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
+			writel((arena_get_bus_addr(v->yuv->data) + v->luma_size) >> 8, p->regs + VE_HEVC_SRAM_DATA);
 		}
 	}
 
@@ -449,10 +436,10 @@ static void write_pic_list(struct h265_private *p)
 	writel(VE_SRAM_HEVC_PIC_LIST + i * 0x20, p->regs + VE_HEVC_SRAM_ADDR);
 	writel(p->info->CurrPicOrderCntVal, p->regs + VE_HEVC_SRAM_DATA);
 	writel(p->info->CurrPicOrderCntVal, p->regs + VE_HEVC_SRAM_DATA);
-	writel(cedrus_mem_get_bus_addr(vp->extra_data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
-	writel(cedrus_mem_get_bus_addr(vp->extra_data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
-	writel(cedrus_mem_get_bus_addr(p->output->yuv->data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
-	writel((cedrus_mem_get_bus_addr(p->output->yuv->data) + p->output->luma_size) >> 8, p->regs + VE_HEVC_SRAM_DATA);
+	writel(arena_get_bus_addr(vp->extra_data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
+	writel(arena_get_bus_addr(vp->extra_data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
+	writel(arena_get_bus_addr(p->output->yuv->data) >> 8, p->regs + VE_HEVC_SRAM_DATA);
+	writel((arena_get_bus_addr(p->output->yuv->data) + p->output->luma_size) >> 8, p->regs + VE_HEVC_SRAM_DATA);
 
 	writel(i, p->regs + VE_HEVC_REC_BUF_IDX);
 }
@@ -551,7 +538,7 @@ static void write_entry_point_list(struct h265_private *p)
 	writel((y << 16) | (x << 0), p->regs + VE_HEVC_TILE_START_CTB);
 	writel(((y + p->info->row_height_minus1[ty]) << 16) | ((x + p->info->column_width_minus1[tx]) << 0), p->regs + VE_HEVC_TILE_END_CTB);
 
-	uint32_t *entry_points = cedrus_mem_get_pointer(p->entry_points);
+	uint32_t *entry_points = arena_get_pointer(p->entry_points);
 	for (i = 0; i < p->slice.num_entry_point_offsets; i++)
 	{
 		if (tx + 1 >= p->info->num_tile_columns_minus1 + 1)
@@ -570,8 +557,8 @@ static void write_entry_point_list(struct h265_private *p)
 		entry_points[i * 4 + 3] = ((y + p->info->row_height_minus1[ty]) << 16) | ((x + p->info->column_width_minus1[tx]) << 0);
 	}
 
-	cedrus_mem_flush_cache(p->entry_points);
-	writel(cedrus_mem_get_bus_addr(p->entry_points) >> 8, p->regs + VE_HEVC_TILE_LIST_ADDR);
+	arena_flush_cache(p->entry_points);
+	writel(arena_get_bus_addr(p->entry_points) >> 8, p->regs + VE_HEVC_TILE_LIST_ADDR);
 }
 
 static void write_weighted_pred(struct h265_private *p)
@@ -640,75 +627,84 @@ static void write_scaling_lists(struct h265_private *p)
 
 	uint32_t i, j, word = 0x0;
 
-	writel((p->info->ScalingListDCCoeff32x32[1] << 24) |
+	ve_shadow_writel(&p->decoder->shadow, (p->info->ScalingListDCCoeff32x32[1] << 24) |
 		(p->info->ScalingListDCCoeff32x32[0] << 16) |
 		(p->info->ScalingListDCCoeff16x16[1] << 8) |
-		(p->info->ScalingListDCCoeff16x16[0] << 0), p->regs + VE_HEVC_SCALING_LIST_DC_COEF0);
+		(p->info->ScalingListDCCoeff16x16[0] << 0), p->regs, VE_HEVC_SCALING_LIST_DC_COEF0);
 
-	writel((p->info->ScalingListDCCoeff16x16[5] << 24) |
+	ve_shadow_writel(&p->decoder->shadow, (p->info->ScalingListDCCoeff16x16[5] << 24) |
 		(p->info->ScalingListDCCoeff16x16[4] << 16) |
 		(p->info->ScalingListDCCoeff16x16[3] << 8) |
-		(p->info->ScalingListDCCoeff16x16[2] << 0), p->regs + VE_HEVC_SCALING_LIST_DC_COEF1);
+		(p->info->ScalingListDCCoeff16x16[2] << 0), p->regs, VE_HEVC_SCALING_LIST_DC_COEF1);
 
-	writel(VE_SRAM_HEVC_SCALING_LISTS, p->regs + VE_HEVC_SRAM_ADDR);
+	uint8_t sl[sizeof(p->info->ScalingList4x4) + sizeof(p->info->ScalingList8x8) + sizeof(p->info->ScalingList16x16) + sizeof(p->info->ScalingList32x32)];
+	memcpy(sl, p->info->ScalingList4x4, sizeof(p->info->ScalingList4x4));
+	memcpy(sl + sizeof(p->info->ScalingList4x4), p->info->ScalingList8x8, sizeof(p->info->ScalingList8x8));
+	memcpy(sl + sizeof(p->info->ScalingList4x4) + sizeof(p->info->ScalingList8x8), p->info->ScalingList16x16, sizeof(p->info->ScalingList16x16));
+	memcpy(sl + sizeof(sl) - sizeof(p->info->ScalingList32x32), p->info->ScalingList32x32, sizeof(p->info->ScalingList32x32));
 
-	for (i = 0; i < 6; i++)
+	if (ve_shadow_table_changed(&p->decoder->shadow, VE_SHADOW_TABLE_HEVC_SCALING_LISTS, sl, sizeof(sl), 1 + sizeof(sl) / 4))
 	{
-		for (j = 0; j < 64; j++)
-		{
-			word |= p->info->ScalingList8x8[i][diag8x8[j]] << ((j % 4) * 8);
+		writel(VE_SRAM_HEVC_SCALING_LISTS, p->regs + VE_HEVC_SRAM_ADDR);
 
-			if (j % 4 == 3)
+		for (i = 0; i < 6; i++)
+		{
+			for (j = 0; j < 64; j++)
 			{
-				writel(word, p->regs + VE_HEVC_SRAM_DATA);
-				word = 0x0;
+				word |= p->info->ScalingList8x8[i][diag8x8[j]] << ((j % 4) * 8);
+
+				if (j % 4 == 3)
+				{
+					writel(word, p->regs + VE_HEVC_SRAM_DATA);
+					word = 0x0;
+				}
 			}
 		}
-	}
 
-	for (i = 0; i < 2; i++)
-	{
-		for (j = 0; j < 64; j++)
+		for (i = 0; i < 2; i++)
 		{
-			word |= p->info->ScalingList32x32[i][diag8x8[j]] << ((j % 4) * 8);
-
-			if (j % 4 == 3)
+			for (j = 0; j < 64; j++)
 			{
-				writel(word, p->regs + VE_HEVC_SRAM_DATA);
-				word = 0x0;
+				word |= p->info->ScalingList32x32[i][diag8x8[j]] << ((j % 4) * 8);
+
+				if (j % 4 == 3)
+				{
+					writel(word, p->regs + VE_HEVC_SRAM_DATA);
+					word = 0x0;
+				}
 			}
 		}
-	}
 
-	for (i = 0; i < 6; i++)
-	{
-		for (j = 0; j < 64; j++)
+		for (i = 0; i < 6; i++)
 		{
-			word |= p->info->ScalingList16x16[i][diag8x8[j]] << ((j % 4) * 8);
-
-			if (j % 4 == 3)
+			for (j = 0; j < 64; j++)
 			{
-				writel(word, p->regs + VE_HEVC_SRAM_DATA);
-				word = 0x0;
+				word |= p->info->ScalingList16x16[i][diag8x8[j]] << ((j % 4) * 8);
+
+				if (j % 4 == 3)
+				{
+					writel(word, p->regs + VE_HEVC_SRAM_DATA);
+					word = 0x0;
+				}
 			}
 		}
-	}
 
-	for (i = 0; i < 6; i++)
-	{
-		for (j = 0; j < 16; j++)
+		for (i = 0; i < 6; i++)
 		{
-			word |= p->info->ScalingList4x4[i][diag4x4[j]] << ((j % 4) * 8);
-
-			if (j % 4 == 3)
+			for (j = 0; j < 16; j++)
 			{
-				writel(word, p->regs + VE_HEVC_SRAM_DATA);
-				word = 0x0;
+				word |= p->info->ScalingList4x4[i][diag4x4[j]] << ((j % 4) * 8);
+
+				if (j % 4 == 3)
+				{
+					writel(word, p->regs + VE_HEVC_SRAM_DATA);
+					word = 0x0;
+				}
 			}
 		}
 	}
 
-	writel((0x1 << 31), p->regs + VE_HEVC_SCALING_LIST_CTRL);
+	ve_shadow_writel(&p->decoder->shadow, (0x1 << 31), p->regs, VE_HEVC_SCALING_LIST_CTRL);
 }
 
 static VdpStatus h265_decode(decoder_ctx_t *decoder,
@@ -722,32 +718,54 @@ static VdpStatus h265_decode(decoder_ctx_t *decoder,
 	p->output = output;
 	memset(&p->slice, 0, sizeof(p->slice));
 
-	VdpStatus ret = yuv_prepare(output);
-	if (ret != VDP_STATUS_OK)
-		return ret;
-
 	p->regs = cedrus_ve_get(decoder->device->cedrus, CEDRUS_ENGINE_HEVC, 0x0);
+	ve_shadow_begin(&decoder->shadow, decoder->device);
 
-	int pos = 0;
-	while ((pos = find_startcode(cedrus_mem_get_pointer(decoder->data), len, pos)) != -1)
+	VdpStatus ret = VDP_STATUS_OK;
+	unsigned int i;
+	for (i = 0; i < decoder->vbv->num_startcodes; i++)
 	{
-		writel((cedrus_mem_get_bus_addr(decoder->data) + VBV_SIZE - 1) >> 8, p->regs + VE_HEVC_BITS_END_ADDR);
-		writel((len - pos) * 8, p->regs + VE_HEVC_BITS_LEN);
-		writel(pos * 8, p->regs + VE_HEVC_BITS_OFFSET);
-		writel((cedrus_mem_get_bus_addr(decoder->data) >> 8) | (0x7 << 28), p->regs + VE_HEVC_BITS_ADDR);
+		int pos = decoder->vbv->startcodes[i];
 
-		writel(0x7, p->regs + VE_HEVC_TRIG);
+		bitstream_init(&p->bs, cedrus_mem_get_pointer(decoder->vbv->data), len, pos);
 
-		get_u(p->regs, 1);
-		p->nal_unit_type = get_u(p->regs, 6);
-		get_u(p->regs, 6);
-		get_u(p->regs, 3);
+		get_u(&p->bs, 1);
+		p->nal_unit_type = get_u(&p->bs, 6);
+		get_u(&p->bs, 6);
+		get_u(&p->bs, 3);
 
-		slice_header(p);
+		if (!slice_header(p))
+		{
+			VDPAU_DBG("Invalid HEVC slice header");
+			ret = VDP_STATUS_ERROR;
+			break;
+		}
+
+		/*
+		 * Point the VE right at the slice data, unless it could miss an
+		 * emulation prevention byte there. In that case start at the
+		 * NAL unit and let the VE skip the header.
+		 */
+		unsigned int offset = bitstream_raw_offset(&p->bs), skip = 0;
+		if (!offset)
+		{
+			offset = pos * 8;
+			skip = p->bs.rbsp_bits;
+		}
+
+		writel((cedrus_mem_get_bus_addr(decoder->vbv->data) + decoder->vbv->size - 1) >> 8, p->regs + VE_HEVC_BITS_END_ADDR);
+		writel(len * 8 - offset, p->regs + VE_HEVC_BITS_LEN);
+		writel(offset, p->regs + VE_HEVC_BITS_OFFSET);
+		writel((cedrus_mem_get_bus_addr(decoder->vbv->data) >> 8) | (0x7 << 28), p->regs + VE_HEVC_BITS_ADDR);
+
+		writel(0x7, p->regs + VE_HEVC_TRIG);
+
+		if (skip)
+			skip_bits(p->regs, skip);
 
 		writel(0x40 | p->nal_unit_type, p->regs + VE_HEVC_NAL_HDR);
 
-		writel(((p->info->strong_intra_smoothing_enabled_flag & 0x1) << 26) |
+		ve_shadow_writel(&p->decoder->shadow, ((p->info->strong_intra_smoothing_enabled_flag & 0x1) << 26) |
 			((p->info->sps_temporal_mvp_enabled_flag & 0x1) << 25) |
 			((p->info->sample_adaptive_offset_enabled_flag & 0x1) << 24) |
 			((p->info->amp_enabled_flag & 0x1) << 23) |
@@ -757,37 +775,37 @@ static VdpStatus h265_decode(decoder_ctx_t *decoder,
 			((p->info->log2_min_transform_block_size_minus2 & 0x3) << 13) |
 			((p->info->log2_diff_max_min_luma_coding_block_size & 0x3) << 11) |
 			((p->info->log2_min_luma_coding_block_size_minus3 & 0x3) << 9) |
-			((p->info->chroma_format_idc & 0x3) << 0), p->regs + VE_HEVC_SPS);
+			((p->info->chroma_format_idc & 0x3) << 0), p->regs, VE_HEVC_SPS);
 
-		writel((decoder->height << 16) | decoder->width, p->regs + VE_HEVC_PIC_SIZE);
+		ve_shadow_writel(&p->decoder->shadow, (decoder->height << 16) | decoder->width, p->regs, VE_HEVC_PIC_SIZE);
 
-		writel(((p->info->pcm_enabled_flag & 0x1) << 15) |
+		ve_shadow_writel(&p->decoder->shadow, ((p->info->pcm_enabled_flag & 0x1) << 15) |
 			((p->info->log2_diff_max_min_pcm_luma_coding_block_size & 0x3) << 10) |
 			((p->info->log2_min_pcm_luma_coding_block_size_minus3 & 0x3) << 8) |
 			((p->info->pcm_sample_bit_depth_chroma_minus1 & 0xf) << 4) |
-			((p->info->pcm_sample_bit_depth_luma_minus1 & 0xf) << 0), p->regs + VE_HEVC_PCM_HDR);
+			((p->info->pcm_sample_bit_depth_luma_minus1 & 0xf) << 0), p->regs, VE_HEVC_PCM_HDR);
 
-		writel(((p->info->pps_cr_qp_offset & 0x1f) << 24) |
+		ve_shadow_writel(&p->decoder->shadow, ((p->info->pps_cr_qp_offset & 0x1f) << 24) |
 			((p->info->pps_cb_qp_offset & 0x1f) << 16) |
 			((p->info->init_qp_minus26 & 0xff) << 8) |
 			((p->info->diff_cu_qp_delta_depth & 0xf) << 4) |
 			((p->info->cu_qp_delta_enabled_flag & 0x1) << 3) |
 			((p->info->transform_skip_enabled_flag & 0x1) << 2) |
 			((p->info->constrained_intra_pred_flag & 0x1) << 1) |
-			((p->info->sign_data_hiding_enabled_flag & 0x1) << 0), p->regs + VE_HEVC_PPS0);
-		writel(((p->info->log2_parallel_merge_level_minus2 & 0x7) << 8) |
+			((p->info->sign_data_hiding_enabled_flag & 0x1) << 0), p->regs, VE_HEVC_PPS0);
+		ve_shadow_writel(&p->decoder->shadow, ((p->info->log2_parallel_merge_level_minus2 & 0x7) << 8) |
 			((p->info->pps_loop_filter_across_slices_enabled_flag & 0x1) << 6) |
 			((p->info->loop_filter_across_tiles_enabled_flag & 0x1) << 5) |
 			((p->info->entropy_coding_sync_enabled_flag & 0x1) << 4) |
 			((p->info->tiles_enabled_flag & 0x1) << 3) |
 			((p->info->transquant_bypass_enabled_flag & 0x1) << 2) |
 			((p->info->weighted_bipred_flag & 0x1) << 1) |
-			((p->info->weighted_pred_flag & 0x1) << 0), p->regs + VE_HEVC_PPS1);
+			((p->info->weighted_pred_flag & 0x1) << 0), p->regs, VE_HEVC_PPS1);
 
 		if (p->info->scaling_list_enabled_flag)
 			write_scaling_lists(p);
 		else
-			writel((0x1 << 30), p->regs + VE_HEVC_SCALING_LIST_CTRL);
+			ve_shadow_writel(&p->decoder->shadow, (0x1 << 30), p->regs, VE_HEVC_SCALING_LIST_CTRL);
 
 		writel(((p->slice.five_minus_max_num_merge_cand & 0x7) << 24) |
 			((p->slice.num_ref_idx_l1_active_minus1 & 0xf) << 20) |
@@ -820,19 +838,19 @@ static VdpStatus h265_decode(decoder_ctx_t *decoder,
 		writel(((p->slice.slice_segment_address / PicWidthInCtbsY) << 16) | ((p->slice.slice_segment_address % PicWidthInCtbsY) << 0), p->regs + VE_HEVC_CTB_ADDR);
 		writel(0x00000007, p->regs + VE_HEVC_CTRL);
 
-		writel(0xc0000000, p->regs + VE_EXTRA_OUT_FMT_OFFSET);
-		writel((0x2 << 4), p->regs + 0x0ec);
-		writel(output->chroma_size / 2, p->regs + 0x0c4);
-		writel((ALIGN(decoder->width / 2, 16) << 16) | ALIGN(decoder->width, 32), p->regs + 0x0c8);
-		writel(0x00000000, p->regs + 0x0cc);
-		writel(0x00000000, p->regs + 0x550);
-		writel(0x00000000, p->regs + 0x554);
-		writel(0x00000000, p->regs + 0x558);
+		ve_shadow_writel(&p->decoder->shadow, 0xc0000000, p->regs, VE_EXTRA_OUT_FMT_OFFSET);
+		ve_shadow_writel(&p->decoder->shadow, (0x2 << 4), p->regs, 0x0ec);
+		ve_shadow_writel(&p->decoder->shadow, output->chroma_size / 2, p->regs, 0x0c4);
+		ve_shadow_writel(&p->decoder->shadow, (ALIGN(decoder->width / 2, 16) << 16) | ALIGN(decoder->width, 32), p->regs, 0x0c8);
+		ve_shadow_writel(&p->decoder->shadow, 0x00000000, p->regs, 0x0cc);
+		ve_shadow_writel(&p->decoder->shadow, 0x00000000, p->regs, 0x550);
+		ve_shadow_writel(&p->decoder->shadow, 0x00000000, p->regs, 0x554);
+		ve_shadow_writel(&p->decoder->shadow, 0x00000000, p->regs, 0x558);
 
 		write_entry_point_list(p);
 
-		writel(0x0, p->regs + 0x580);
-		writel(cedrus_mem_get_bus_addr(p->neighbor_info) >> 8, p->regs + VE_HEVC_NEIGHBOR_INFO_ADDR);
+		ve_shadow_writel(&p->decoder->shadow, 0x0, p->regs, 0x580);
+		ve_shadow_writel(&p->decoder->shadow, arena_get_bus_addr(p->neighbor_info) >> 8, p->regs, VE_HEVC_NEIGHBOR_INFO_ADDR);
 
 		write_pic_list(p);
 
@@ -845,17 +863,18 @@ static VdpStatus h265_decode(decoder_ctx_t *decoder,
 		writel(readl(p->regs + VE_HEVC_STATUS) & 0x7, p->regs + VE_HEVC_STATUS);
 	}
 
+	ve_shadow_end(&decoder->shadow);
 	cedrus_ve_put(decoder->device->cedrus);
 
-	return VDP_STATUS_OK;
+	return ret;
 }
 
 static void h265_private_free(decoder_ctx_t *decoder)
 {
 	struct h265_private *p = decoder->private;
 
-	cedrus_mem_free(p->neighbor_info);
-	cedrus_mem_free(p->entry_points);
+	arena_free(p->neighbor_info);
+	arena_free(p->entry_points);
 
 	free(p);
 }
@@ -866,8 +885,8 @@ VdpStatus new_decoder_h265(decoder_ctx_t *decoder)
 	if (!p)
 		return VDP_STATUS_RESOURCES;
 
-	p->neighbor_info = cedrus_mem_alloc(decoder->device->cedrus, 397 * 1024);
-	p->entry_points = cedrus_mem_alloc(decoder->device->cedrus, 4 * 1024);
+	p->neighbor_info = arena_alloc(decoder->device, 397 * 1024);
+	p->entry_points = arena_alloc(decoder->device, 4 * 1024);
 
 	decoder->decode = h265_decode;
 	decoder->private = p;
@@ -22,83 +22,198 @@
 #include <string.h>
 #include "vdpau_private.h"
 
-#define INITIAL_SIZE 16
+/*
+ * The slot table is split into fixed-size chunks that are never moved or
+ * freed once published. Growing the table only adds a chunk, so
+ * handle_get() can walk it with plain atomic loads and never has to
+ * synchronize with handle_create()/handle_destroy(), which are serialized
+ * by a mutex.
+ *
+ * A handle is (generation << 16) | index. The generation of a slot is
+ * bumped every time it is freed, so a stale handle fails a cheap compare
+ * instead of resolving to whatever object reused the slot. Generations
+ * never become 0, which keeps 0 and VDP_INVALID_HANDLE unused.
+ *
+ * Objects come from per-type slab pools and go back onto a per-type free
+ * list when destroyed, so create/destroy don't touch malloc once the
+ * pools are warm.
+ */
+#define CHUNK_BITS 8
+#define CHUNK_SIZE (1 << CHUNK_BITS)
+#define MAX_CHUNKS 256
+#define MAX_SLOTS (MAX_CHUNKS * CHUNK_SIZE - 1)
 
-static struct
+#define INDEX_BITS 16
+#define INDEX_MASK ((1 << INDEX_BITS) - 1)
+#define GEN_MASK 0xffff
+
+#define SLAB_OBJECTS 8
+#define NO_SLOT UINT32_MAX
+
+typedef struct
+{
+	void *data;
+	uint32_t gen;
+	uint32_t next_free;
+	handle_type_t type;
+} slot_t;
+
+typedef struct
 {
-	void **data;
 	size_t size;
-	pthread_rwlock_t lock;
-} ht = { .lock = PTHREAD_RWLOCK_INITIALIZER };
+	void *free;
+} pool_t;
+
+static struct
+{
+	slot_t *chunks[MAX_CHUNKS];
+	uint32_t size;
+	uint32_t free;
+	pool_t pools[HANDLE_TYPE_COUNT];
+	pthread_mutex_t lock;
+} ht = { .free = NO_SLOT, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static inline slot_t *get_slot(uint32_t index)
+{
+	return &ht.chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)];
+}
+
+static void *pool_alloc(pool_t *pool, size_t size)
+{
+	if (pool->size == 0)
+		pool->size = ALIGN(max(size, sizeof(void *)), sizeof(void *) * 2);
+	else if (size > pool->size)
+		return NULL;
+
+	if (!pool->free)
+	{
+		char *slab = malloc(pool->size * SLAB_OBJECTS);
+		if (!slab)
+			return NULL;
+
+		int i;
+		for (i = SLAB_OBJECTS - 1; i >= 0; i--)
+		{
+			*(void **)(slab + i * pool->size) = pool->free;
+			pool->free = slab + i * pool->size;
+		}
+	}
+
+	void *data = pool->free;
+	pool->free = *(void **)data;
+	memset(data, 0, pool->size);
+
+	return data;
+}
+
+static void pool_free(pool_t *pool, void *data)
+{
+	*(void **)data = pool->free;
+	pool->free = data;
+}
 
-void *handle_create(size_t size, VdpHandle *handle)
+void *handle_create(handle_type_t type, size_t size, VdpHandle *handle)
 {
 	*handle = VDP_INVALID_HANDLE;
 
-	if (pthread_rwlock_wrlock(&ht.lock))
+	if (type >= HANDLE_TYPE_COUNT)
 		return NULL;
 
-	unsigned int index;
-	void *data = NULL;
+	if (pthread_mutex_lock(&ht.lock))
+		return NULL;
 
-	for (index = 0; index < ht.size; index++)
-		if (ht.data[index] == NULL)
-			break;
+	void *data = NULL;
+	uint32_t index = ht.free;
 
-	if (index >= ht.size)
+	if (index == NO_SLOT)
 	{
-		int new_size = ht.size ? ht.size * 2 : INITIAL_SIZE;
-		void **new_data = realloc(ht.data, new_size * sizeof(void *));
-		if (!new_data)
+		if (ht.size >= MAX_SLOTS)
 			goto out;
 
-		memset(new_data + ht.size, 0, (new_size - ht.size) * sizeof(void *));
-		ht.data = new_data;
-		ht.size = new_size;
+		if ((ht.size & (CHUNK_SIZE - 1)) == 0)
+		{
+			slot_t *chunk = calloc(CHUNK_SIZE, sizeof(slot_t));
+			if (!chunk)
+				goto out;
+
+			__atomic_store_n(&ht.chunks[ht.size >> CHUNK_BITS], chunk, __ATOMIC_RELEASE);
+		}
+
+		index = ht.size++;
+		get_slot(index)->gen = 1;
+		get_slot(index)->next_free = NO_SLOT;
+		ht.free = index;
 	}
 
-	data = calloc(1, size);
+	data = pool_alloc(&ht.pools[type], size);
 	if (!data)
 		goto out;
 
-	ht.data[index] = data;
-	*handle = index + 1;
+	slot_t *slot = get_slot(index);
+	ht.free = slot->next_free;
+	slot->type = type;
+	__atomic_store_n(&slot->data, data, __ATOMIC_RELEASE);
+
+	*handle = (slot->gen << INDEX_BITS) | index;
 
 out:
-	pthread_rwlock_unlock(&ht.lock);
+	pthread_mutex_unlock(&ht.lock);
 	return data;
 }
 
 void *handle_get(VdpHandle handle)
 {
-	if (handle == VDP_INVALID_HANDLE)
+	uint32_t index = handle & INDEX_MASK;
+
+	if (index >= MAX_SLOTS)
 		return NULL;
 
-	if (pthread_rwlock_rdlock(&ht.lock))
+	slot_t *chunk = __atomic_load_n(&ht.chunks[index >> CHUNK_BITS], __ATOMIC_ACQUIRE);
+	if (!chunk)
 		return NULL;
 
-	unsigned int index = handle - 1;
-	void *data = NULL;
+	slot_t *slot = &chunk[index & (CHUNK_SIZE - 1)];
 
-	if (index < ht.size)
-		data = ht.data[index];
+	/*
+	 * Load data before gen: handle_destroy() bumps gen before clearing
+	 * data, so if we see a reused slot's new object, we also see its new
+	 * generation and reject the stale handle.
+	 */
+	void *data = __atomic_load_n(&slot->data, __ATOMIC_ACQUIRE);
+	if (!data)
+		return NULL;
+
+	if (__atomic_load_n(&slot->gen, __ATOMIC_ACQUIRE) != (handle >> INDEX_BITS))
+		return NULL;
 
-	pthread_rwlock_unlock(&ht.lock);
 	return data;
 }
 
 void handle_destroy(VdpHandle handle)
 {
-	if (pthread_rwlock_wrlock(&ht.lock))
+	if (pthread_mutex_lock(&ht.lock))
 		return;
 
-	unsigned int index = handle - 1;
+	uint32_t index = handle & INDEX_MASK;
 
 	if (index < ht.size)
 	{
-		free(ht.data[index]);
-		ht.data[index] = NULL;
+		slot_t *slot = get_slot(index);
+
+		if (slot->data && slot->gen == (handle >> INDEX_BITS))
+		{
+			void *data = slot->data;
+
+			uint32_t gen = (slot->gen + 1) & GEN_MASK;
+			__atomic_store_n(&slot->gen, gen ? gen : 1, __ATOMIC_RELEASE);
+			__atomic_store_n(&slot->data, NULL, __ATOMIC_RELEASE);
+
+			pool_free(&ht.pools[slot->type], data);
+
+			slot->next_free = ht.free;
+			ht.free = index;
+		}
 	}
 
-	pthread_rwlock_unlock(&ht.lock);
+	pthread_mutex_unlock(&ht.lock);
 }
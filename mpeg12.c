@@ -34,29 +34,21 @@ static const uint8_t zigzag_scan[64] =
 	35, 36, 48, 49, 57, 58, 62, 63
 };
 
-static int mpeg_find_startcode(const uint8_t *data, int len)
+static int mpeg_find_startcode(const vbv_t *vbv, const int len)
 {
-	int pos = 0;
-	while (pos < len)
+	const uint8_t *data = cedrus_mem_get_pointer(vbv->data);
+
+	unsigned int i;
+	for (i = 0; i < vbv->num_startcodes; i++)
 	{
-		int zeros = 0;
-		for ( ; pos < len; pos++)
-		{
-			if (data[pos] == 0x00)
-				zeros++;
-			else if (data[pos] == 0x01 && zeros >= 2)
-			{
-				pos++;
-				break;
-			}
-			else
-				zeros = 0;
-		}
-
-		uint8_t marker = data[pos++];
+		uint32_t pos = vbv->startcodes[i];
+		if (pos >= len)
+			break;
+
+		uint8_t marker = data[pos];
 
 		if (marker >= 0x01 && marker <= 0xaf)
-			return pos - 4;
+			return pos - 3;
 	}
 	return 0;
 }
@@ -67,26 +59,25 @@ static VdpStatus mpeg12_decode(decoder_ctx_t *decoder,
                                video_surface_ctx_t *output)
 {
 	VdpPictureInfoMPEG1Or2 const *info = (VdpPictureInfoMPEG1Or2 const *)_info;
-	int start_offset = mpeg_find_startcode(cedrus_mem_get_pointer(decoder->data), len);
-
-	VdpStatus ret = yuv_prepare(output);
-	if (ret != VDP_STATUS_OK)
-		return ret;
-
-	ret = rec_prepare(output);
-	if (ret != VDP_STATUS_OK)
-		return ret;
+	int start_offset = mpeg_find_startcode(decoder->vbv, len);
 
 	int i;
 
 	// activate MPEG engine
 	void *ve_regs = cedrus_ve_get(decoder->device->cedrus, CEDRUS_ENGINE_MPEG, 0);
+	ve_shadow_begin(&decoder->shadow, decoder->device);
 
 	// set quantisation tables
-	for (i = 0; i < 64; i++)
-		writel((uint32_t)(64 + zigzag_scan[i]) << 8 | info->intra_quantizer_matrix[i], ve_regs + VE_MPEG_IQ_MIN_INPUT);
-	for (i = 0; i < 64; i++)
-		writel((uint32_t)(zigzag_scan[i]) << 8 | info->non_intra_quantizer_matrix[i], ve_regs + VE_MPEG_IQ_MIN_INPUT);
+	uint8_t iq[128];
+	memcpy(iq, info->intra_quantizer_matrix, 64);
+	memcpy(iq + 64, info->non_intra_quantizer_matrix, 64);
+	if (ve_shadow_table_changed(&decoder->shadow, VE_SHADOW_TABLE_MPEG_IQ, iq, sizeof(iq), 128))
+	{
+		for (i = 0; i < 64; i++)
+			writel((uint32_t)(64 + zigzag_scan[i]) << 8 | info->intra_quantizer_matrix[i], ve_regs + VE_MPEG_IQ_MIN_INPUT);
+		for (i = 0; i < 64; i++)
+			writel((uint32_t)(zigzag_scan[i]) << 8 | info->non_intra_quantizer_matrix[i], ve_regs + VE_MPEG_IQ_MIN_INPUT);
+	}
 
 	// set size
 	uint16_t width = (decoder->width + 15) / 16;
@@ -124,21 +115,21 @@ static VdpStatus mpeg12_decode(decoder_ctx_t *decoder,
 	if (info->forward_reference != VDP_INVALID_HANDLE)
 	{
 		video_surface_ctx_t *forward = handle_get(info->forward_reference);
-		writel(cedrus_mem_get_bus_addr(forward->rec), ve_regs + VE_MPEG_FWD_LUMA);
-		writel(cedrus_mem_get_bus_addr(forward->rec) + forward->luma_size, ve_regs + VE_MPEG_FWD_CHROMA);
+		writel(arena_get_bus_addr(forward->rec), ve_regs + VE_MPEG_FWD_LUMA);
+		writel(arena_get_bus_addr(forward->rec) + forward->luma_size, ve_regs + VE_MPEG_FWD_CHROMA);
 	}
 	if (info->backward_reference != VDP_INVALID_HANDLE)
 	{
 		video_surface_ctx_t *backward = handle_get(info->backward_reference);
-		writel(cedrus_mem_get_bus_addr(backward->rec), ve_regs + VE_MPEG_BACK_LUMA);
-		writel(cedrus_mem_get_bus_addr(backward->rec) + backward->luma_size, ve_regs + VE_MPEG_BACK_CHROMA);
+		writel(arena_get_bus_addr(backward->rec), ve_regs + VE_MPEG_BACK_LUMA);
+		writel(arena_get_bus_addr(backward->rec) + backward->luma_size, ve_regs + VE_MPEG_BACK_CHROMA);
 	}
 
 	// set output buffers (Luma / Croma)
-	writel(cedrus_mem_get_bus_addr(output->rec), ve_regs + VE_MPEG_REC_LUMA);
-	writel(cedrus_mem_get_bus_addr(output->rec) + output->luma_size, ve_regs + VE_MPEG_REC_CHROMA);
-	writel(cedrus_mem_get_bus_addr(output->yuv->data), ve_regs + VE_MPEG_ROT_LUMA);
-	writel(cedrus_mem_get_bus_addr(output->yuv->data) + output->luma_size, ve_regs + VE_MPEG_ROT_CHROMA);
+	writel(arena_get_bus_addr(output->rec), ve_regs + VE_MPEG_REC_LUMA);
+	writel(arena_get_bus_addr(output->rec) + output->luma_size, ve_regs + VE_MPEG_REC_CHROMA);
+	writel(arena_get_bus_addr(output->yuv->data), ve_regs + VE_MPEG_ROT_LUMA);
+	writel(arena_get_bus_addr(output->yuv->data) + output->luma_size, ve_regs + VE_MPEG_ROT_CHROMA);
 
 	// set input offset in bits
 	writel(start_offset * 8, ve_regs + VE_MPEG_VLD_OFFSET);
@@ -147,8 +138,8 @@ static VdpStatus mpeg12_decode(decoder_ctx_t *decoder,
 	writel((len - start_offset) * 8, ve_regs + VE_MPEG_VLD_LEN);
 
 	// input end
-	uint32_t input_addr = cedrus_mem_get_bus_addr(decoder->data);
-	writel(input_addr + VBV_SIZE - 1, ve_regs + VE_MPEG_VLD_END);
+	uint32_t input_addr = cedrus_mem_get_bus_addr(decoder->vbv->data);
+	writel(input_addr + decoder->vbv->size - 1, ve_regs + VE_MPEG_VLD_END);
 
 	// set input buffer
 	writel((input_addr & 0x0ffffff0) | (input_addr >> 28) | (0x7 << 28), ve_regs + VE_MPEG_VLD_ADDR);
@@ -163,6 +154,7 @@ static VdpStatus mpeg12_decode(decoder_ctx_t *decoder,
 	writel(0x0000c00f, ve_regs + VE_MPEG_STATUS);
 
 	// stop MPEG engine
+	ve_shadow_end(&decoder->shadow);
 	cedrus_ve_put(decoder->device->cedrus);
 
 	return VDP_STATUS_OK;
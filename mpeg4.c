@@ -29,22 +29,24 @@ typedef struct
 	const uint8_t *data;
 	unsigned int length;
 	unsigned int bitpos;
+	const uint32_t *startcodes;
+	unsigned int num_startcodes;
 } bitstream;
 
 static int find_startcode(bitstream *bs)
 {
-	unsigned int pos, zeros = 0;
-	for (pos = bs->bitpos / 8; pos < bs->length; pos++)
+	unsigned int pos = bs->bitpos / 8 + 3;
+
+	while (bs->num_startcodes > 0)
 	{
-		if (bs->data[pos] == 0x00)
-			zeros++;
-		else if (bs->data[pos] == 0x01 && zeros >= 2)
+		unsigned int startcode = *bs->startcodes++;
+		bs->num_startcodes--;
+
+		if (startcode >= pos)
 		{
-			bs->bitpos = (pos + 1) * 8;
+			bs->bitpos = startcode * 8;
 			return 1;
 		}
-		else
-			zeros = 0;
 	}
 
 	return 0;
@@ -76,17 +78,17 @@ static uint32_t get_bits(bitstream *bs, int n)
 
 typedef struct
 {
-	cedrus_mem_t *mbh_buffer;
-	cedrus_mem_t *dcac_buffer;
-	cedrus_mem_t *ncf_buffer;
+	arena_mem_t *mbh_buffer;
+	arena_mem_t *dcac_buffer;
+	arena_mem_t *ncf_buffer;
 } mpeg4_private_t;
 
 static void mpeg4_private_free(decoder_ctx_t *decoder)
 {
 	mpeg4_private_t *decoder_p = (mpeg4_private_t *)decoder->private;
-	cedrus_mem_free(decoder_p->mbh_buffer);
-	cedrus_mem_free(decoder_p->dcac_buffer);
-	cedrus_mem_free(decoder_p->ncf_buffer);
+	arena_free(decoder_p->mbh_buffer);
+	arena_free(decoder_p->dcac_buffer);
+	arena_free(decoder_p->ncf_buffer);
 	free(decoder_p);
 }
 
@@ -156,15 +158,8 @@ static VdpStatus mpeg4_decode(decoder_ctx_t *decoder,
 		return VDP_STATUS_ERROR;
 	}
 
-	VdpStatus ret = yuv_prepare(output);
-	if (ret != VDP_STATUS_OK)
-		return ret;
-
-	ret = rec_prepare(output);
-	if (ret != VDP_STATUS_OK)
-		return ret;
-
-	bitstream bs = { .data = cedrus_mem_get_pointer(decoder->data), .length = len, .bitpos = 0 };
+	bitstream bs = { .data = cedrus_mem_get_pointer(decoder->vbv->data), .length = len, .bitpos = 0,
+	                 .startcodes = decoder->vbv->startcodes, .num_startcodes = decoder->vbv->num_startcodes };
 
 	while (find_startcode(&bs))
 	{
@@ -177,22 +172,23 @@ static VdpStatus mpeg4_decode(decoder_ctx_t *decoder,
 
 		// activate MPEG engine
 		void *ve_regs = cedrus_ve_get(decoder->device->cedrus, CEDRUS_ENGINE_MPEG, 0);
+		ve_shadow_begin(&decoder->shadow, decoder->device);
 
 		// set buffers
-		writel(cedrus_mem_get_bus_addr(decoder_p->mbh_buffer), ve_regs + VE_MPEG_MBH_ADDR);
-		writel(cedrus_mem_get_bus_addr(decoder_p->dcac_buffer), ve_regs + VE_MPEG_DCAC_ADDR);
-		writel(cedrus_mem_get_bus_addr(decoder_p->ncf_buffer), ve_regs + VE_MPEG_NCF_ADDR);
+		writel(arena_get_bus_addr(decoder_p->mbh_buffer), ve_regs + VE_MPEG_MBH_ADDR);
+		writel(arena_get_bus_addr(decoder_p->dcac_buffer), ve_regs + VE_MPEG_DCAC_ADDR);
+		writel(arena_get_bus_addr(decoder_p->ncf_buffer), ve_regs + VE_MPEG_NCF_ADDR);
 
 		// set output buffers
-		writel(cedrus_mem_get_bus_addr(output->rec), ve_regs + VE_MPEG_REC_LUMA);
-		writel(cedrus_mem_get_bus_addr(output->rec) + output->luma_size, ve_regs + VE_MPEG_REC_CHROMA);
-		writel(cedrus_mem_get_bus_addr(output->yuv->data), ve_regs + VE_MPEG_ROT_LUMA);
-		writel(cedrus_mem_get_bus_addr(output->yuv->data) + output->luma_size, ve_regs + VE_MPEG_ROT_CHROMA);
+		writel(arena_get_bus_addr(output->rec), ve_regs + VE_MPEG_REC_LUMA);
+		writel(arena_get_bus_addr(output->rec) + output->luma_size, ve_regs + VE_MPEG_REC_CHROMA);
+		writel(arena_get_bus_addr(output->yuv->data), ve_regs + VE_MPEG_ROT_LUMA);
+		writel(arena_get_bus_addr(output->yuv->data) + output->offsets[1], ve_regs + VE_MPEG_ROT_CHROMA);
 
 		// ??
-		writel(0x40620000, ve_regs + VE_MPEG_SDROT_CTRL);
+		writel(0x40620000 | video_surface_sdrot_ctrl(output), ve_regs + VE_MPEG_SDROT_CTRL);
 		if (cedrus_get_ve_version(decoder->device->cedrus) >= 0x1680)
-			writel((0x2 << 30) | (0x1 << 28) | (output->chroma_size / 2), ve_regs + VE_EXTRA_OUT_FMT_OFFSET);
+			writel((0x2 << 30) | (0x1 << 28) | (output->offsets[2] - output->offsets[1]), ve_regs + VE_EXTRA_OUT_FMT_OFFSET);
 
 		// set vop header
 		writel(((hdr.vop_coding_type == VOP_B ? 0x1 : 0x0) << 28)
@@ -227,14 +223,14 @@ static VdpStatus mpeg4_decode(decoder_ctx_t *decoder,
 		if (info->forward_reference != VDP_INVALID_HANDLE)
 		{
 			video_surface_ctx_t *forward = handle_get(info->forward_reference);
-			writel(cedrus_mem_get_bus_addr(forward->rec), ve_regs + VE_MPEG_FWD_LUMA);
-			writel(cedrus_mem_get_bus_addr(forward->rec) + forward->luma_size, ve_regs + VE_MPEG_FWD_CHROMA);
+			writel(arena_get_bus_addr(forward->rec), ve_regs + VE_MPEG_FWD_LUMA);
+			writel(arena_get_bus_addr(forward->rec) + forward->luma_size, ve_regs + VE_MPEG_FWD_CHROMA);
 		}
 		if (info->backward_reference != VDP_INVALID_HANDLE)
 		{
 			video_surface_ctx_t *backward = handle_get(info->backward_reference);
-			writel(cedrus_mem_get_bus_addr(backward->rec), ve_regs + VE_MPEG_BACK_LUMA);
-			writel(cedrus_mem_get_bus_addr(backward->rec) + backward->luma_size, ve_regs + VE_MPEG_BACK_CHROMA);
+			writel(arena_get_bus_addr(backward->rec), ve_regs + VE_MPEG_BACK_LUMA);
+			writel(arena_get_bus_addr(backward->rec) + backward->luma_size, ve_regs + VE_MPEG_BACK_CHROMA);
 		}
 
 		// set trb/trd
@@ -255,8 +251,8 @@ static VdpStatus mpeg4_decode(decoder_ctx_t *decoder,
 		writel(len * 8 - bs.bitpos, ve_regs + VE_MPEG_VLD_LEN);
 
 		// input end
-		uint32_t input_addr = cedrus_mem_get_bus_addr(decoder->data);
-		writel(input_addr + VBV_SIZE - 1, ve_regs + VE_MPEG_VLD_END);
+		uint32_t input_addr = cedrus_mem_get_bus_addr(decoder->vbv->data);
+		writel(input_addr + decoder->vbv->size - 1, ve_regs + VE_MPEG_VLD_END);
 
 		// set input buffer
 		writel((input_addr & 0x0ffffff0) | (input_addr >> 28) | (0x7 << 28), ve_regs + VE_MPEG_VLD_ADDR);
@@ -270,6 +266,7 @@ static VdpStatus mpeg4_decode(decoder_ctx_t *decoder,
 		writel(readl(ve_regs + VE_MPEG_STATUS) | 0xf, ve_regs + VE_MPEG_STATUS);
 
 		// stop MPEG engine
+		ve_shadow_end(&decoder->shadow);
 		cedrus_ve_put(decoder->device->cedrus);
 	}
 
@@ -285,15 +282,15 @@ VdpStatus new_decoder_mpeg4(decoder_ctx_t *decoder)
 	int width = ((decoder->width + 15) / 16);
 	int height = ((decoder->height + 15) / 16);
 
-	decoder_p->mbh_buffer = cedrus_mem_alloc(decoder->device->cedrus, height * 2048);
+	decoder_p->mbh_buffer = arena_alloc(decoder->device, height * 2048);
 	if (!decoder_p->mbh_buffer)
 		goto err_mbh;
 
-	decoder_p->dcac_buffer = cedrus_mem_alloc(decoder->device->cedrus, width * height * 2);
+	decoder_p->dcac_buffer = arena_alloc(decoder->device, width * height * 2);
 	if (!decoder_p->dcac_buffer)
 		goto err_dcac;
 
-	decoder_p->ncf_buffer = cedrus_mem_alloc(decoder->device->cedrus, 4 * 1024);
+	decoder_p->ncf_buffer = arena_alloc(decoder->device, 4 * 1024);
 	if (!decoder_p->ncf_buffer)
 		goto err_ncf;
 
@@ -304,9 +301,9 @@ VdpStatus new_decoder_mpeg4(decoder_ctx_t *decoder)
 	return VDP_STATUS_OK;
 
 err_ncf:
-	cedrus_mem_free(decoder_p->dcac_buffer);
+	arena_free(decoder_p->dcac_buffer);
 err_dcac:
-	cedrus_mem_free(decoder_p->mbh_buffer);
+	arena_free(decoder_p->mbh_buffer);
 err_mbh:
 	free(decoder_p);
 err_priv:
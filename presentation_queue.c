@@ -48,7 +48,7 @@ VdpStatus vdp_presentation_queue_target_create_x11(VdpDevice device,
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	queue_target_ctx_t *qt = handle_create(sizeof(*qt), target);
+	queue_target_ctx_t *qt = handle_create(HANDLE_TYPE_PRESENTATION_QUEUE_TARGET, sizeof(*qt), target);
 	if (!qt)
 		return VDP_STATUS_RESOURCES;
 
@@ -97,7 +97,7 @@ VdpStatus vdp_presentation_queue_create(VdpDevice device,
 	if (!qt)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	queue_ctx_t *q = handle_create(sizeof(*q), presentation_queue);
+	queue_ctx_t *q = handle_create(HANDLE_TYPE_PRESENTATION_QUEUE, sizeof(*q), presentation_queue);
 	if (!q)
 		return VDP_STATUS_RESOURCES;
 
@@ -188,7 +188,10 @@ VdpStatus vdp_presentation_queue_display(VdpPresentationQueue presentation_queue
 	XClearWindow(q->device->display, q->target->drawable);
 
 	if (os->vs)
+	{
+		decode_queue_wait(q->device, os->video_fence);
 		q->target->disp->set_video_layer(q->target->disp, x, y, clip_width, clip_height, os);
+	}
 	else
 		q->target->disp->close_video_layer(q->target->disp);
 
@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "vdpau_private.h"
+#include "tiled_yuv.h"
+
+/*
+ * Optional worker pool for readback. Every 32 line row of tiles can be
+ * converted on its own, and so can every line of a linear plane, so a
+ * plane is cut into bands of a few tile rows, which the workers and the
+ * calling thread take in turn.
+ */
+
+#define READBACK_MAX_THREADS	8
+#define READBACK_BAND_ROWS	4
+
+enum readback_mode
+{
+	READBACK_PLANAR,
+	READBACK_DEINTERLEAVE,
+	READBACK_SWAP,
+	READBACK_LINEAR_INTERLEAVE,
+	READBACK_LINEAR_DEINTERLEAVE,
+	READBACK_LINEAR_SWAP,
+};
+
+struct readback_job
+{
+	uint32_t generation;
+	enum readback_mode mode;
+	uint8_t *src;
+	uint8_t *src2;
+	unsigned int src_pitch;
+	uint8_t *dst1;
+	uint8_t *dst2;
+	unsigned int dst_pitch;
+	unsigned int width;
+	unsigned int height;
+	unsigned int bands;
+};
+
+/*
+ * Workers copy the job under the mutex. Bands are claimed through one
+ * 64 bit word holding the generation and the next band index, so a claim
+ * left over from a finished job can never take a band of the next one.
+ * A job only ends after all its claimed bands are done, the next one is
+ * published after that.
+ */
+struct readback_pool
+{
+	pthread_t threads[READBACK_MAX_THREADS];
+	int num_threads;
+	int quit;
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+
+	struct readback_job job;
+	uint32_t completed;
+	uint64_t claim;
+	unsigned int done_bands;
+};
+
+static void convert_band(const struct readback_job *job, unsigned int band)
+{
+	unsigned int tiles_per_row = (job->width + 31) / 32;
+	unsigned int y = band * READBACK_BAND_ROWS * 32;
+	unsigned int height = min(job->height - y, READBACK_BAND_ROWS * 32);
+	uint8_t *src = job->src + y * tiles_per_row * 32;
+	uint8_t *linear = job->src + y * job->src_pitch;
+
+	switch (job->mode)
+	{
+	case READBACK_PLANAR:
+		tiled_to_planar(src, job->dst1 + y * job->dst_pitch, job->dst_pitch, job->width, height);
+		break;
+	case READBACK_DEINTERLEAVE:
+		tiled_deinterleave_to_planar(src, job->dst1 + y * job->dst_pitch, job->dst2 + y * job->dst_pitch,
+		                             job->dst_pitch, job->width, height);
+		break;
+	case READBACK_SWAP:
+		tiled_swap_to_planar(src, job->dst1 + y * job->dst_pitch, job->dst_pitch, job->width, height);
+		break;
+	case READBACK_LINEAR_INTERLEAVE:
+		planar_interleave(linear, job->src2 + y * job->src_pitch, job->dst1 + y * job->dst_pitch,
+		                  job->src_pitch, job->dst_pitch, job->width, height);
+		break;
+	case READBACK_LINEAR_DEINTERLEAVE:
+		planar_deinterleave(linear, job->dst1 + y * job->dst_pitch, job->dst2 + y * job->dst_pitch,
+		                    job->src_pitch, job->dst_pitch, job->width, height);
+		break;
+	case READBACK_LINEAR_SWAP:
+		planar_swap(linear, job->dst1 + y * job->dst_pitch, job->src_pitch, job->dst_pitch, job->width, height);
+		break;
+	}
+}
+
+static void run_bands(struct readback_pool *pool, const struct readback_job *job)
+{
+	uint64_t claim = __atomic_load_n(&pool->claim, __ATOMIC_ACQUIRE);
+
+	while ((uint32_t)(claim >> 32) == job->generation && (uint32_t)claim < job->bands)
+	{
+		if (!__atomic_compare_exchange_n(&pool->claim, &claim, claim + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			continue;
+
+		convert_band(job, (uint32_t)claim);
+
+		if (__atomic_add_fetch(&pool->done_bands, 1, __ATOMIC_ACQ_REL) == job->bands)
+		{
+			pthread_mutex_lock(&pool->mutex);
+			pool->completed = job->generation;
+			pthread_cond_broadcast(&pool->done_cond);
+			pthread_mutex_unlock(&pool->mutex);
+		}
+
+		claim = __atomic_load_n(&pool->claim, __ATOMIC_ACQUIRE);
+	}
+}
+
+static void *readback_thread(void *arg)
+{
+	struct readback_pool *pool = arg;
+	struct readback_job job = { .generation = 0 };
+
+	pthread_mutex_lock(&pool->mutex);
+	while (1)
+	{
+		while (!pool->quit && pool->job.generation == job.generation)
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+
+		if (pool->quit)
+			break;
+
+		job = pool->job;
+		pthread_mutex_unlock(&pool->mutex);
+
+		run_bands(pool, &job);
+
+		pthread_mutex_lock(&pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+VdpStatus readback_pool_create(device_ctx_t *device, int threads)
+{
+	if (threads < 2)
+		return VDP_STATUS_OK;
+
+	struct readback_pool *pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return VDP_STATUS_RESOURCES;
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	// the calling thread does its share too
+	threads = min(threads - 1, READBACK_MAX_THREADS);
+	for (pool->num_threads = 0; pool->num_threads < threads; pool->num_threads++)
+		if (pthread_create(&pool->threads[pool->num_threads], NULL, readback_thread, pool))
+			break;
+
+	device->readback_pool = pool;
+
+	if (pool->num_threads == 0)
+	{
+		readback_pool_destroy(device);
+		return VDP_STATUS_RESOURCES;
+	}
+
+	return VDP_STATUS_OK;
+}
+
+void readback_pool_destroy(device_ctx_t *device)
+{
+	struct readback_pool *pool = device->readback_pool;
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	int i;
+	for (i = 0; i < pool->num_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+
+	device->readback_pool = NULL;
+}
+
+static void readback(device_ctx_t *device, enum readback_mode mode, void *src, void *src2, unsigned int src_pitch,
+                     void *dst1, void *dst2, unsigned int dst_pitch, unsigned int width, unsigned int height)
+{
+	struct readback_pool *pool = device->readback_pool;
+
+	// one job at a time, get_bits may be called from several threads
+	pthread_mutex_lock(&pool->mutex);
+
+	while (pool->completed != pool->job.generation)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+
+	struct readback_job job =
+	{
+		.generation = pool->job.generation + 1,
+		.mode = mode,
+		.src = src,
+		.src2 = src2,
+		.src_pitch = src_pitch,
+		.dst1 = dst1,
+		.dst2 = dst2,
+		.dst_pitch = dst_pitch,
+		.width = width,
+		.height = height,
+		.bands = DIV_ROUND_UP(height, READBACK_BAND_ROWS * 32),
+	};
+
+	pool->job = job;
+	pool->done_bands = 0;
+	__atomic_store_n(&pool->claim, (uint64_t)job.generation << 32, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&pool->work_cond);
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	run_bands(pool, &job);
+
+	pthread_mutex_lock(&pool->mutex);
+	while ((int32_t)(pool->completed - job.generation) < 0)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void readback_tiled_to_planar(device_ctx_t *device, void *src, void *dst, unsigned int dst_pitch,
+                              unsigned int width, unsigned int height)
+{
+	if (device->readback_pool && height > READBACK_BAND_ROWS * 32)
+		readback(device, READBACK_PLANAR, src, NULL, 0, dst, NULL, dst_pitch, width, height);
+	else
+		tiled_to_planar(src, dst, dst_pitch, width, height);
+}
+
+void readback_tiled_deinterleave_to_planar(device_ctx_t *device, void *src, void *dst1, void *dst2,
+                                           unsigned int dst_pitch, unsigned int width, unsigned int height)
+{
+	if (device->readback_pool && height > READBACK_BAND_ROWS * 32)
+		readback(device, READBACK_DEINTERLEAVE, src, NULL, 0, dst1, dst2, dst_pitch, width, height);
+	else
+		tiled_deinterleave_to_planar(src, dst1, dst2, dst_pitch, width, height);
+}
+
+void readback_tiled_swap_to_planar(device_ctx_t *device, void *src, void *dst, unsigned int dst_pitch,
+                                   unsigned int width, unsigned int height)
+{
+	if (device->readback_pool && height > READBACK_BAND_ROWS * 32)
+		readback(device, READBACK_SWAP, src, NULL, 0, dst, NULL, dst_pitch, width, height);
+	else
+		tiled_swap_to_planar(src, dst, dst_pitch, width, height);
+}
+
+void readback_planar_interleave(device_ctx_t *device, void *src1, void *src2, void *dst, unsigned int src_pitch,
+                                unsigned int dst_pitch, unsigned int width, unsigned int height)
+{
+	if (device->readback_pool && height > READBACK_BAND_ROWS * 32)
+		readback(device, READBACK_LINEAR_INTERLEAVE, src1, src2, src_pitch, dst, NULL, dst_pitch, width, height);
+	else
+		planar_interleave(src1, src2, dst, src_pitch, dst_pitch, width, height);
+}
+
+void readback_planar_deinterleave(device_ctx_t *device, void *src, void *dst1, void *dst2, unsigned int src_pitch,
+                                  unsigned int dst_pitch, unsigned int width, unsigned int height)
+{
+	if (device->readback_pool && height > READBACK_BAND_ROWS * 32)
+		readback(device, READBACK_LINEAR_DEINTERLEAVE, src, NULL, src_pitch, dst1, dst2, dst_pitch, width, height);
+	else
+		planar_deinterleave(src, dst1, dst2, src_pitch, dst_pitch, width, height);
+}
+
+void readback_planar_swap(device_ctx_t *device, void *src, void *dst, unsigned int src_pitch,
+                          unsigned int dst_pitch, unsigned int width, unsigned int height)
+{
+	if (device->readback_pool && height > READBACK_BAND_ROWS * 32)
+		readback(device, READBACK_LINEAR_SWAP, src, NULL, src_pitch, dst, NULL, dst_pitch, width, height);
+	else
+		planar_swap(src, dst, src_pitch, dst_pitch, width, height);
+}
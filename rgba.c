@@ -58,7 +58,7 @@ VdpStatus rgba_create(rgba_surface_t *rgba,
 
 	if (device->osd_enabled)
 	{
-		rgba->data = cedrus_mem_alloc(device->cedrus, width * height * 4);
+		rgba->data = arena_alloc(device, width * height * 4);
 		if (!rgba->data)
 			return VDP_STATUS_RESOURCES;
 
@@ -82,7 +82,7 @@ void rgba_destroy(rgba_surface_t *rgba)
 		if(!rgba->device->g2d_enabled)
 			vdp_pixman_unref(rgba);
 
-		cedrus_mem_free(rgba->data);
+		arena_free(rgba->data);
 	}
 }
 
@@ -105,13 +105,13 @@ VdpStatus rgba_put_bits_native(rgba_surface_t *rgba,
 		// full width
 		const int bytes_to_copy =
 			(d_rect.x1 - d_rect.x0) * (d_rect.y1 - d_rect.y0) * 4;
-		memcpy(cedrus_mem_get_pointer(rgba->data) + d_rect.y0 * rgba->width * 4,
+		memcpy(arena_get_pointer(rgba->data) + d_rect.y0 * rgba->width * 4,
 			   source_data[0], bytes_to_copy);
 	} else {
 		const unsigned int bytes_in_line = (d_rect.x1-d_rect.x0) * 4;
 		unsigned int y;
 		for (y = d_rect.y0; y < d_rect.y1; y ++) {
-			memcpy(cedrus_mem_get_pointer(rgba->data) + (y * rgba->width + d_rect.x0) * 4,
+			memcpy(arena_get_pointer(rgba->data) + (y * rgba->width + d_rect.x0) * 4,
 				   source_data[0] + (y - d_rect.y0) * source_pitches[0],
 				   bytes_in_line);
 		}
@@ -141,7 +141,7 @@ VdpStatus rgba_put_bits_indexed(rgba_surface_t *rgba,
 	int x, y;
 	const uint32_t *colormap = color_table;
 	const uint8_t *src_ptr = source_data[0];
-	uint32_t *dst_ptr = cedrus_mem_get_pointer(rgba->data);
+	uint32_t *dst_ptr = arena_get_pointer(rgba->data);
 
 	VdpRect d_rect = {0, 0, rgba->width, rgba->height};
 	if (destination_rect)
@@ -281,7 +281,7 @@ void rgba_flush(rgba_surface_t *rgba)
 {
 	if (rgba->flags & RGBA_FLAG_NEEDS_FLUSH)
 	{
-		cedrus_mem_flush_cache(rgba->data);
+		arena_flush_cache(rgba->data);
 		rgba->flags &= ~RGBA_FLAG_NEEDS_FLUSH;
 	}
 }
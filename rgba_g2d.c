@@ -29,7 +29,7 @@ void g2d_fill(rgba_surface_t *dest, const VdpRect *dest_rect, uint32_t color)
 	g2d_fillrect args;
 
 	args.flag = G2D_FIL_PIXEL_ALPHA;
-	args.dst_image.addr[0] = cedrus_mem_get_phys_addr(dest->data);
+	args.dst_image.addr[0] = arena_get_phys_addr(dest->data);
 	args.dst_image.w = dest->width;
 	args.dst_image.h = dest->height;
 	args.dst_image.format = G2D_FMT_ARGB_AYUV8888;
@@ -59,7 +59,7 @@ void g2d_blit(rgba_surface_t *dest, const VdpRect *dest_rect, rgba_surface_t *sr
 	g2d_blt args;
 
 	args.flag = (dest->flags & RGBA_FLAG_NEEDS_CLEAR) ? G2D_BLT_NONE : G2D_BLT_PIXEL_ALPHA;
-	args.src_image.addr[0] = cedrus_mem_get_phys_addr(src->data);
+	args.src_image.addr[0] = arena_get_phys_addr(src->data);
 	args.src_image.w = src->width;
 	args.src_image.h = src->height;
 	args.src_image.format = G2D_FMT_ARGB_AYUV8888;
@@ -68,7 +68,7 @@ void g2d_blit(rgba_surface_t *dest, const VdpRect *dest_rect, rgba_surface_t *sr
 	args.src_rect.y = src_rect->y0;
 	args.src_rect.w = src_rect->x1 - src_rect->x0;
 	args.src_rect.h = src_rect->y1 - src_rect->y0;
-	args.dst_image.addr[0] = cedrus_mem_get_phys_addr(dest->data);
+	args.dst_image.addr[0] = arena_get_phys_addr(dest->data);
 	args.dst_image.w = dest->width;
 	args.dst_image.h = dest->height;
 	args.dst_image.format = G2D_FMT_ARGB_AYUV8888;
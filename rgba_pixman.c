@@ -52,7 +52,7 @@ VdpStatus vdp_pixman_ref(rgba_surface_t *rgba)
 {
 	rgba->pimage = pixman_image_create_bits(PIXMAN_a8r8g8b8,
 						rgba->width, rgba->height,
-						cedrus_mem_get_pointer(rgba->data),
+						arena_get_pointer(rgba->data),
 						(rgba->width * 4));
 
 	return VDP_STATUS_OK;
@@ -132,10 +132,19 @@ VdpStatus vdp_pixman_fill(rgba_surface_t *rgba_dst, const VdpRect *dst_rect,
 		goto zero_size_fill;
 
 	pixman_color_t pcolor = uint32_to_pcolor(color);
-	pixman_image_t *src = pixman_image_create_solid_fill(&pcolor);
-
 	pixman_image_t *dst = rgba_dst->pimage;
 
+	/* Plain fill of the a8r8g8b8 bits, saves creating a solid-fill image.
+	 * pixman_fill() doesn't clip, so only use it for rects inside the surface */
+	uint32_t pixel = (pcolor.alpha >> 8) << 24 | (pcolor.red >> 8) << 16 | (pcolor.green >> 8) << 8 | (pcolor.blue >> 8);
+	if (rect.x0 < rect.x1 && rect.x1 <= rgba_dst->width &&
+	    rect.y0 < rect.y1 && rect.y1 <= rgba_dst->height &&
+	    pixman_fill(pixman_image_get_data(dst), pixman_image_get_stride(dst) / 4, 32,
+			rect.x0, rect.y0, (rect.x1 - rect.x0), (rect.y1 - rect.y0), pixel))
+		return VDP_STATUS_OK;
+
+	pixman_image_t *src = pixman_image_create_solid_fill(&pcolor);
+
 	/* Composite to the dest_img */
 	pixman_image_composite32(
 		PIXMAN_OP_SRC, src, NULL, dst,
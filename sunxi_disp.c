@@ -143,6 +143,9 @@ static int sunxi_disp_set_video_layer(struct sunxi_disp *sunxi_disp, int x, int
 {
 	struct sunxi_disp_private *disp = (struct sunxi_disp_private *)sunxi_disp;
 
+	VdpRect src_rect;
+	video_surface_get_display_rect(surface->vs, &surface->video_src_rect, &src_rect);
+
 	switch (surface->vs->source_format) {
 	case VDP_YCBCR_FORMAT_YUYV:
 		disp->video_info.fb.mode = DISP_MOD_INTERLEAVED;
@@ -172,16 +175,23 @@ static int sunxi_disp_set_video_layer(struct sunxi_disp *sunxi_disp, int x, int
 		break;
 	}
 
-	disp->video_info.fb.addr[0] = cedrus_mem_get_phys_addr(surface->yuv->data);
-	disp->video_info.fb.addr[1] = cedrus_mem_get_phys_addr(surface->yuv->data) + surface->vs->luma_size;
-	disp->video_info.fb.addr[2] = cedrus_mem_get_phys_addr(surface->yuv->data) + surface->vs->luma_size + surface->vs->chroma_size / 2;
+	uint32_t fb_width, fb_height;
+	video_surface_get_display_size(surface->vs, &fb_width, &fb_height);
+
+	// linear 4:2:0 source formats only come from imported buffers, which bring their own pitch
+	if (surface->vs->source_format == VDP_YCBCR_FORMAT_NV12 || surface->vs->source_format == VDP_YCBCR_FORMAT_YV12)
+		fb_width = surface->vs->pitches[0];
+
+	disp->video_info.fb.addr[0] = arena_get_phys_addr(surface->yuv->data) + surface->vs->offsets[0];
+	disp->video_info.fb.addr[1] = arena_get_phys_addr(surface->yuv->data) + surface->vs->offsets[1];
+	disp->video_info.fb.addr[2] = arena_get_phys_addr(surface->yuv->data) + surface->vs->offsets[2];
 
-	disp->video_info.fb.size.width = surface->vs->width;
-	disp->video_info.fb.size.height = surface->vs->height;
-	disp->video_info.src_win.x = surface->video_src_rect.x0;
-	disp->video_info.src_win.y = surface->video_src_rect.y0;
-	disp->video_info.src_win.width = surface->video_src_rect.x1 - surface->video_src_rect.x0;
-	disp->video_info.src_win.height = surface->video_src_rect.y1 - surface->video_src_rect.y0;
+	disp->video_info.fb.size.width = fb_width;
+	disp->video_info.fb.size.height = fb_height;
+	disp->video_info.src_win.x = src_rect.x0;
+	disp->video_info.src_win.y = src_rect.y0;
+	disp->video_info.src_win.width = src_rect.x1 - src_rect.x0;
+	disp->video_info.src_win.height = src_rect.y1 - src_rect.y0;
 	disp->video_info.scn_win.x = x + surface->video_dst_rect.x0;
 	disp->video_info.scn_win.y = y + surface->video_dst_rect.y0;
 	disp->video_info.scn_win.width = surface->video_dst_rect.x1 - surface->video_dst_rect.x0;
@@ -249,7 +259,7 @@ static int sunxi_disp_set_osd_layer(struct sunxi_disp *sunxi_disp, int x, int y,
 		break;
 	}
 
-	disp->osd_info.fb.addr[0] = cedrus_mem_get_phys_addr(surface->rgba.data);
+	disp->osd_info.fb.addr[0] = arena_get_phys_addr(surface->rgba.data);
 	disp->osd_info.fb.size.width = surface->rgba.width;
 	disp->osd_info.fb.size.height = surface->rgba.height;
 	disp->osd_info.src_win.x = surface->rgba.dirty.x0;
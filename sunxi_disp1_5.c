@@ -132,9 +132,12 @@ static int sunxi_disp1_5_set_video_layer(struct sunxi_disp *sunxi_disp, int x, i
 {
 	struct sunxi_disp1_5_private *disp = (struct sunxi_disp1_5_private *)sunxi_disp;
 
-	disp_window src = { .x = surface->video_src_rect.x0, .y = surface->video_src_rect.y0,
-			    .width = surface->video_src_rect.x1 - surface->video_src_rect.x0,
-			    .height = surface->video_src_rect.y1 - surface->video_src_rect.y0 };
+	VdpRect src_rect;
+	video_surface_get_display_rect(surface->vs, &surface->video_src_rect, &src_rect);
+
+	disp_window src = { .x = src_rect.x0, .y = src_rect.y0,
+			    .width = src_rect.x1 - src_rect.x0,
+			    .height = src_rect.y1 - src_rect.y0 };
 	disp_window scn = { .x = x + surface->video_dst_rect.x0, .y = y + surface->video_dst_rect.y0,
 			    .width = surface->video_dst_rect.x1 - surface->video_dst_rect.x0,
 			    .height = surface->video_dst_rect.y1 - surface->video_dst_rect.y0 };
@@ -186,12 +189,19 @@ static int sunxi_disp1_5_set_video_layer(struct sunxi_disp *sunxi_disp, int x, i
 		break;
 	}
 
-	disp->video_info.fb.addr[0] = cedrus_mem_get_phys_addr(surface->yuv->data);
-	disp->video_info.fb.addr[1] = cedrus_mem_get_phys_addr(surface->yuv->data) + surface->vs->luma_size;
-	disp->video_info.fb.addr[2] = cedrus_mem_get_phys_addr(surface->yuv->data) + surface->vs->luma_size + surface->vs->chroma_size / 2;
+	uint32_t fb_width, fb_height;
+	video_surface_get_display_size(surface->vs, &fb_width, &fb_height);
+
+	// linear 4:2:0 source formats only come from imported buffers, which bring their own pitch
+	if (surface->vs->source_format == VDP_YCBCR_FORMAT_NV12 || surface->vs->source_format == VDP_YCBCR_FORMAT_YV12)
+		fb_width = surface->vs->pitches[0];
+
+	disp->video_info.fb.addr[0] = arena_get_phys_addr(surface->yuv->data) + surface->vs->offsets[0];
+	disp->video_info.fb.addr[1] = arena_get_phys_addr(surface->yuv->data) + surface->vs->offsets[1];
+	disp->video_info.fb.addr[2] = arena_get_phys_addr(surface->yuv->data) + surface->vs->offsets[2];
 
-	disp->video_info.fb.size.width = surface->vs->width;
-	disp->video_info.fb.size.height = surface->vs->height;
+	disp->video_info.fb.size.width = fb_width;
+	disp->video_info.fb.size.height = fb_height;
 	disp->video_info.fb.src_win = src;
 	disp->video_info.screen_win = scn;
 	disp->video_info.fb.pre_multiply = 1;
@@ -238,7 +248,7 @@ static int sunxi_disp1_5_set_osd_layer(struct sunxi_disp *sunxi_disp, int x, int
 		break;
 	}
 
-	disp->osd_info.fb.addr[0] = cedrus_mem_get_phys_addr(surface->rgba.data);
+	disp->osd_info.fb.addr[0] = arena_get_phys_addr(surface->rgba.data);
 	disp->osd_info.fb.size.width = surface->rgba.width;
 	disp->osd_info.fb.size.height = surface->rgba.height;
 	disp->osd_info.fb.src_win = src;
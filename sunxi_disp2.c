@@ -151,9 +151,12 @@ static int sunxi_disp2_set_video_layer(struct sunxi_disp *sunxi_disp, int x, int
 {
 	struct sunxi_disp2_private *disp = (struct sunxi_disp2_private *)sunxi_disp;
 
-	disp_rect src = { .x = surface->video_src_rect.x0, .y = surface->video_src_rect.y0,
-			  .width = surface->video_src_rect.x1 - surface->video_src_rect.x0,
-			  .height = surface->video_src_rect.y1 - surface->video_src_rect.y0 };
+	VdpRect src_rect;
+	video_surface_get_display_rect(surface->vs, &surface->video_src_rect, &src_rect);
+
+	disp_rect src = { .x = src_rect.x0, .y = src_rect.y0,
+			  .width = src_rect.x1 - src_rect.x0,
+			  .height = src_rect.y1 - src_rect.y0 };
 	disp_rect scn = { .x = x + surface->video_dst_rect.x0, .y = y + surface->video_dst_rect.y0,
 			  .width = surface->video_dst_rect.x1 - surface->video_dst_rect.x0,
 			  .height = surface->video_dst_rect.y1 - surface->video_dst_rect.y0 };
@@ -179,18 +182,25 @@ static int sunxi_disp2_set_video_layer(struct sunxi_disp *sunxi_disp, int x, int
 		break;
 	}
 
-	disp->video_config.info.fb.addr[0] = cedrus_mem_get_phys_addr(surface->yuv->data);
-	disp->video_config.info.fb.addr[1] = cedrus_mem_get_phys_addr(surface->yuv->data) + surface->vs->luma_size;
-	disp->video_config.info.fb.addr[2] = cedrus_mem_get_phys_addr(surface->yuv->data) + surface->vs->luma_size + surface->vs->chroma_size / 2;
+	uint32_t fb_width, fb_height;
+	video_surface_get_display_size(surface->vs, &fb_width, &fb_height);
+
+	// linear 4:2:0 source formats only come from imported buffers, which bring their own pitch
+	if (surface->vs->source_format == VDP_YCBCR_FORMAT_NV12 || surface->vs->source_format == VDP_YCBCR_FORMAT_YV12)
+		fb_width = surface->vs->pitches[0];
+
+	disp->video_config.info.fb.addr[0] = arena_get_phys_addr(surface->yuv->data) + surface->vs->offsets[0];
+	disp->video_config.info.fb.addr[1] = arena_get_phys_addr(surface->yuv->data) + surface->vs->offsets[1];
+	disp->video_config.info.fb.addr[2] = arena_get_phys_addr(surface->yuv->data) + surface->vs->offsets[2];
 
-	disp->video_config.info.fb.size[0].width = surface->vs->width;
-	disp->video_config.info.fb.size[0].height = surface->vs->height;
+	disp->video_config.info.fb.size[0].width = fb_width;
+	disp->video_config.info.fb.size[0].height = fb_height;
 	disp->video_config.info.fb.align[0] = 32;
-	disp->video_config.info.fb.size[1].width = surface->vs->width / 2;
-	disp->video_config.info.fb.size[1].height = surface->vs->height / 2;
+	disp->video_config.info.fb.size[1].width = fb_width / 2;
+	disp->video_config.info.fb.size[1].height = fb_height / 2;
 	disp->video_config.info.fb.align[1] = 16;
-	disp->video_config.info.fb.size[2].width = surface->vs->width / 2;
-	disp->video_config.info.fb.size[2].height = surface->vs->height / 2;
+	disp->video_config.info.fb.size[2].width = fb_width / 2;
+	disp->video_config.info.fb.size[2].height = fb_height / 2;
 	disp->video_config.info.fb.align[2] = 16;
 	disp->video_config.info.fb.crop.x = (unsigned long long)(src.x) << 32;
 	disp->video_config.info.fb.crop.y = (unsigned long long)(src.y) << 32;
@@ -242,7 +252,7 @@ static int sunxi_disp2_set_osd_layer(struct sunxi_disp *sunxi_disp, int x, int y
 		break;
 	}
 
-	disp->osd_config.info.fb.addr[0] = cedrus_mem_get_phys_addr(surface->rgba.data);
+	disp->osd_config.info.fb.addr[0] = arena_get_phys_addr(surface->rgba.data);
 	disp->osd_config.info.fb.size[0].width = surface->rgba.width;
 	disp->osd_config.info.fb.size[0].height = surface->rgba.height;
 	disp->osd_config.info.fb.align[0] = 1;
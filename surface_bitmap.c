@@ -36,7 +36,7 @@ VdpStatus vdp_bitmap_surface_create(VdpDevice device,
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	bitmap_surface_ctx_t *out = handle_create(sizeof(*out), surface);
+	bitmap_surface_ctx_t *out = handle_create(HANDLE_TYPE_BITMAP_SURFACE, sizeof(*out), surface);
 	if (!out)
 		return VDP_STATUS_RESOURCES;
 
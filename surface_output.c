@@ -35,7 +35,7 @@ VdpStatus vdp_output_surface_create(VdpDevice device,
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	output_surface_ctx_t *out = handle_create(sizeof(*out), surface);
+	output_surface_ctx_t *out = handle_create(HANDLE_TYPE_OUTPUT_SURFACE, sizeof(*out), surface);
 	if (!out)
 		return VDP_STATUS_RESOURCES;
 
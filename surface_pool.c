@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+
+/*
+ * Players tend to destroy and recreate all their video surfaces on seeks
+ * and stream switches. Instead of freeing the buffers of a destroyed
+ * surface they are parked here, and the next surface created with the
+ * same size and chroma type takes them over.
+ *
+ * Parked entries are kept in LRU order, the oldest ones are freed once
+ * the byte budget is exceeded.
+ */
+
+#define SURFACE_POOL_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+typedef struct surface_pool_entry
+{
+	struct surface_pool_entry *prev, *next;
+	uint32_t width, height;
+	VdpChromaType chroma_type;
+	unsigned int scale_shift;
+	unsigned int rotation;
+	yuv_data_t *yuv;
+	yuv_data_t *spare_yuv;
+	arena_mem_t *rec;
+	void *decoder_private;
+	void (*decoder_private_free)(video_surface_ctx_t *surface);
+	size_t bytes;
+} surface_pool_entry_t;
+
+struct surface_pool
+{
+	pthread_mutex_t mutex;
+	surface_pool_entry_t *head, *tail;
+	size_t bytes;
+	size_t budget;
+	unsigned int hits, misses;
+};
+
+static void entry_unlink(struct surface_pool *pool, surface_pool_entry_t *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		pool->head = e->next;
+
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		pool->tail = e->prev;
+
+	pool->bytes -= e->bytes;
+}
+
+static void entry_free(surface_pool_entry_t *e)
+{
+	if (e->decoder_private_free)
+	{
+		video_surface_ctx_t tmp = { .decoder_private = e->decoder_private };
+		e->decoder_private_free(&tmp);
+	}
+
+	arena_free(e->rec);
+	if (e->spare_yuv)
+		yuv_unref(e->spare_yuv);
+	yuv_unref(e->yuv);
+	free(e);
+}
+
+VdpStatus surface_pool_create(device_ctx_t *device)
+{
+	size_t budget = SURFACE_POOL_DEFAULT_BUDGET;
+
+	char *env_vdpau_pool = getenv("VDPAU_SURFACE_POOL");
+	if (env_vdpau_pool)
+		budget = (size_t)strtoul(env_vdpau_pool, NULL, 10) * 1024 * 1024;
+
+	if (!budget)
+		return VDP_STATUS_OK;
+
+	struct surface_pool *pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return VDP_STATUS_RESOURCES;
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pool->budget = budget;
+
+	device->surface_pool = pool;
+
+	return VDP_STATUS_OK;
+}
+
+void surface_pool_flush(device_ctx_t *device)
+{
+	struct surface_pool *pool = device->surface_pool;
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->tail)
+	{
+		surface_pool_entry_t *e = pool->tail;
+		entry_unlink(pool, e);
+		entry_free(e);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void surface_pool_destroy(device_ctx_t *device)
+{
+	struct surface_pool *pool = device->surface_pool;
+	if (!pool)
+		return;
+
+	VDPAU_DBG("Surface pool: %u hits, %u misses", pool->hits, pool->misses);
+
+	surface_pool_flush(device);
+
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+
+	device->surface_pool = NULL;
+}
+
+int surface_pool_put(video_surface_ctx_t *surface)
+{
+	struct surface_pool *pool = surface->device->surface_pool;
+	if (!pool || !yuv_exclusive(surface->yuv) || arena_is_imported(surface->yuv->data))
+		return 0;
+
+	surface_pool_entry_t *e = calloc(1, sizeof(*e));
+	if (!e)
+		return 0;
+
+	size_t size = surface->luma_size + surface->chroma_size;
+
+	e->width = surface->width;
+	e->height = surface->height;
+	e->chroma_type = surface->chroma_type;
+	e->scale_shift = surface->scale_shift;
+	e->rotation = surface->rotation;
+	e->yuv = surface->yuv;
+	e->bytes = surface->yuv->size;
+	e->decoder_private = surface->decoder_private;
+	e->decoder_private_free = surface->decoder_private_free;
+
+	// on old VE versions rec is one of the yuv buffers
+	if (surface->rec && surface->rec != surface->yuv->data &&
+	    !(surface->spare_yuv && surface->rec == surface->spare_yuv->data))
+	{
+		e->rec = surface->rec;
+		e->bytes += size;
+	}
+
+	if (surface->spare_yuv)
+	{
+		if (yuv_exclusive(surface->spare_yuv))
+		{
+			e->spare_yuv = surface->spare_yuv;
+			e->bytes += surface->spare_yuv->size;
+		}
+		else
+			yuv_unref(surface->spare_yuv);
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+
+	e->next = pool->head;
+	if (pool->head)
+		pool->head->prev = e;
+	else
+		pool->tail = e;
+	pool->head = e;
+	pool->bytes += e->bytes;
+
+	while (pool->bytes > pool->budget)
+	{
+		surface_pool_entry_t *old = pool->tail;
+		entry_unlink(pool, old);
+		entry_free(old);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	return 1;
+}
+
+int surface_pool_get(video_surface_ctx_t *surface)
+{
+	struct surface_pool *pool = surface->device->surface_pool;
+	if (!pool)
+		return 0;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	surface_pool_entry_t *e;
+	for (e = pool->head; e; e = e->next)
+		if (e->width == surface->width && e->height == surface->height && e->chroma_type == surface->chroma_type)
+			break;
+
+	if (!e)
+	{
+		pool->misses++;
+		pthread_mutex_unlock(&pool->mutex);
+		return 0;
+	}
+
+	entry_unlink(pool, e);
+	pool->hits++;
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	surface->scale_shift = e->scale_shift;
+	surface->rotation = e->rotation;
+	surface->yuv = e->yuv;
+	surface->spare_yuv = e->spare_yuv;
+	surface->rec = e->rec;
+	surface->decoder_private = e->decoder_private;
+	surface->decoder_private_free = e->decoder_private_free;
+	free(e);
+
+	return 1;
+}
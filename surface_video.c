@@ -17,54 +17,241 @@
  *
  */
 
+#include <pthread.h>
 #include <string.h>
+#include <unistd.h>
 #include <cedrus/cedrus.h>
 #include "vdpau_private.h"
 #include "tiled_yuv.h"
 
-void yuv_unref(yuv_data_t *yuv)
+/*
+ * Released yuv buffers are kept on a small per-device free list, so
+ * yuv_new() can hand them out again instead of going to the arena.
+ */
+#define YUV_POOL_MAX 8
+
+struct yuv_pool
 {
-	yuv->ref_count--;
+	pthread_mutex_t mutex;
+	yuv_data_t *free;
+	unsigned int count;
+	unsigned int hits, misses;
+};
+
+VdpStatus yuv_pool_create(device_ctx_t *device)
+{
+	struct yuv_pool *pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return VDP_STATUS_RESOURCES;
 
-	if (yuv->ref_count == 0)
+	pthread_mutex_init(&pool->mutex, NULL);
+
+	device->yuv_pool = pool;
+
+	return VDP_STATUS_OK;
+}
+
+static void yuv_pool_flush(struct yuv_pool *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->free)
 	{
-		cedrus_mem_free(yuv->data);
+		yuv_data_t *yuv = pool->free;
+		pool->free = yuv->next;
+
+		arena_free(yuv->data);
+		free(yuv);
+	}
+	pool->count = 0;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void yuv_pool_destroy(device_ctx_t *device)
+{
+	struct yuv_pool *pool = device->yuv_pool;
+	if (!pool)
+		return;
+
+	VDPAU_DBG("yuv pool: %u hits, %u misses", pool->hits, pool->misses);
+
+	yuv_pool_flush(pool);
+
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+
+	device->yuv_pool = NULL;
+}
+
+/*
+ * yuv buffers are shared between video surfaces and the output surfaces
+ * showing them, which can be used from different threads. The acq_rel
+ * decrement orders all accesses of a holder before the buffer gets reused.
+ */
+void yuv_unref(yuv_data_t *yuv)
+{
+	if (__atomic_sub_fetch(&yuv->ref_count, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		struct yuv_pool *pool = yuv->device->yuv_pool;
+
+		if (pool && !arena_is_imported(yuv->data))
+		{
+			pthread_mutex_lock(&pool->mutex);
+			if (pool->count < YUV_POOL_MAX)
+			{
+				yuv->next = pool->free;
+				pool->free = yuv;
+				pool->count++;
+				yuv = NULL;
+			}
+			pthread_mutex_unlock(&pool->mutex);
+
+			if (!yuv)
+				return;
+		}
+
+		arena_free(yuv->data);
 		free(yuv);
 	}
 }
 
 yuv_data_t *yuv_ref(yuv_data_t *yuv)
 {
-	yuv->ref_count++;
+	__atomic_add_fetch(&yuv->ref_count, 1, __ATOMIC_RELAXED);
 	return yuv;
 }
 
-static VdpStatus yuv_new(video_surface_ctx_t *video_surface)
+// only meaningful for buffers nobody can take new references to concurrently
+int yuv_exclusive(yuv_data_t *yuv)
 {
-	video_surface->yuv = calloc(1, sizeof(yuv_data_t));
-	if (!video_surface->yuv)
-		return VDP_STATUS_RESOURCES;
+	return __atomic_load_n(&yuv->ref_count, __ATOMIC_ACQUIRE) == 1;
+}
 
-	video_surface->yuv->ref_count = 1;
-	video_surface->yuv->data = cedrus_mem_alloc(video_surface->device->cedrus, video_surface->luma_size + video_surface->chroma_size);
+static yuv_data_t *yuv_pool_get(struct yuv_pool *pool, size_t size)
+{
+	yuv_data_t **yuv;
+	yuv_data_t *found = NULL;
 
-	if (!(video_surface->yuv->data))
+	pthread_mutex_lock(&pool->mutex);
+	for (yuv = &pool->free; *yuv; yuv = &(*yuv)->next)
 	{
-		free(video_surface->yuv);
-		return VDP_STATUS_RESOURCES;
+		if ((*yuv)->size == size)
+		{
+			found = *yuv;
+			*yuv = found->next;
+			pool->count--;
+			break;
+		}
 	}
 
-	return VDP_STATUS_OK;
+	if (found)
+		pool->hits++;
+	else
+		pool->misses++;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return found;
+}
+
+// scaled down or rotated copies have their own size
+static void display_size(video_surface_ctx_t *vs, unsigned int scale_shift, unsigned int rotation,
+                         uint32_t *width, uint32_t *height)
+{
+	*width = vs->width >> scale_shift;
+	*height = vs->height >> scale_shift;
+
+	if (rotation & 1)
+	{
+		uint32_t tmp = *width;
+		*width = *height;
+		*height = tmp;
+	}
 }
 
-VdpStatus yuv_prepare(video_surface_ctx_t *video_surface)
+static size_t yuv_size(video_surface_ctx_t *video_surface, unsigned int scale_shift, unsigned int rotation)
 {
-	if (video_surface->yuv->ref_count > 1)
+	if (!scale_shift && !rotation)
+		return video_surface->luma_size + video_surface->chroma_size;
+
+	uint32_t width, height;
+	display_size(video_surface, scale_shift, rotation, &width, &height);
+
+	return ALIGN(width, 32) * ALIGN(height, 32) + ALIGN(width, 32) * ALIGN(height / 2, 32);
+}
+
+static yuv_data_t *yuv_new(video_surface_ctx_t *video_surface, size_t size)
+{
+	device_ctx_t *dev = video_surface->device;
+	yuv_data_t *yuv;
+
+	if (dev->yuv_pool)
 	{
-		video_surface->yuv->ref_count--;
-		return yuv_new(video_surface);
+		yuv = yuv_pool_get(dev->yuv_pool, size);
+		if (yuv)
+		{
+			yuv->ref_count = 1;
+			return yuv;
+		}
 	}
 
+	yuv = calloc(1, sizeof(yuv_data_t));
+	if (!yuv)
+		return NULL;
+
+	yuv->ref_count = 1;
+	yuv->device = dev;
+	yuv->size = size;
+	yuv->data = arena_alloc(dev, size);
+
+	if (!yuv->data && dev->yuv_pool)
+	{
+		// buffers of other sizes might be in the way
+		yuv_pool_flush(dev->yuv_pool);
+		yuv->data = arena_alloc(dev, size);
+	}
+
+	if (!yuv->data)
+	{
+		free(yuv);
+		return NULL;
+	}
+
+	return yuv;
+}
+
+/*
+ * Makes sure video_surface->yuv is unshared and large enough for a picture
+ * scaled down by scale_shift and rotated, the caller switches the surface
+ * to them once everything else has succeeded.
+ *
+ * The surface keeps the last buffer it had to give up to an output surface
+ * as spare, once the output surface lets go of it they are swapped back and
+ * forth without any allocation.
+ */
+VdpStatus yuv_prepare(video_surface_ctx_t *video_surface, unsigned int scale_shift, unsigned int rotation)
+{
+	size_t size = yuv_size(video_surface, scale_shift, rotation);
+
+	yuv_data_t *yuv = video_surface->yuv;
+	if (yuv->size == size && yuv_exclusive(yuv))
+		return VDP_STATUS_OK;
+
+	// the spare isn't reachable through the surface, its count can only drop
+	yuv_data_t *spare = video_surface->spare_yuv;
+	if (!spare || spare->size != size || !yuv_exclusive(spare))
+	{
+		yuv_data_t *new = yuv_new(video_surface, size);
+		if (!new)
+			return VDP_STATUS_RESOURCES;
+
+		if (spare)
+			yuv_unref(spare);
+		spare = new;
+	}
+
+	// readers may pick up video_surface->yuv concurrently, publish it last
+	video_surface->spare_yuv = yuv;
+	__atomic_store_n(&video_surface->yuv, spare, __ATOMIC_RELEASE);
+
 	return VDP_STATUS_OK;
 }
 
@@ -74,7 +261,7 @@ VdpStatus rec_prepare(video_surface_ctx_t *video_surface)
 	{
 		if (!video_surface->rec)
 		{
-			video_surface->rec = cedrus_mem_alloc(video_surface->device->cedrus, video_surface->luma_size + video_surface->chroma_size);
+			video_surface->rec = arena_alloc(video_surface->device, video_surface->luma_size + video_surface->chroma_size);
 			if (!video_surface->rec)
 				return VDP_STATUS_RESOURCES;
 		}
@@ -101,7 +288,7 @@ VdpStatus vdp_video_surface_create(VdpDevice device,
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	video_surface_ctx_t *vs = handle_create(sizeof(*vs), surface);
+	video_surface_ctx_t *vs = handle_create(HANDLE_TYPE_VIDEO_SURFACE, sizeof(*vs), surface);
 	if (!vs)
 		return VDP_STATUS_RESOURCES;
 
@@ -127,13 +314,210 @@ VdpStatus vdp_video_surface_create(VdpDevice device,
 		return VDP_STATUS_INVALID_CHROMA_TYPE;
 	}
 
-	VdpStatus ret = yuv_new(vs);
-	if (ret != VDP_STATUS_OK)
+	if (!surface_pool_get(vs))
 	{
-		handle_destroy(*surface);
-		return ret;
+		vs->yuv = yuv_new(vs, yuv_size(vs, 0, 0));
+		if (!vs->yuv)
+		{
+			// parked buffers of other sizes might be in the way
+			surface_pool_flush(dev);
+			vs->yuv = yuv_new(vs, yuv_size(vs, 0, 0));
+		}
+
+		if (!vs->yuv)
+		{
+			handle_destroy(*surface);
+			return VDP_STATUS_RESOURCES;
+		}
 	}
 
+	// pooled buffers may hold a scaled down picture
+	video_surface_set_decoded_layout(vs);
+
+	return VDP_STATUS_OK;
+}
+
+VdpStatus vdp_video_surface_import_dma_buf_sunxi(VdpDevice device,
+                                                 VdpChromaType chroma_type,
+                                                 uint32_t width,
+                                                 uint32_t height,
+                                                 VdpYCbCrFormat format,
+                                                 int fd,
+                                                 uint32_t const offsets[3],
+                                                 uint32_t const pitches[3],
+                                                 VdpVideoSurface *surface)
+{
+	uint32_t luma_pitch = ALIGN(width, 32);
+	VdpStatus ret = VDP_STATUS_RESOURCES;
+	uint64_t size;
+
+	if (!surface || !offsets || !pitches)
+		return VDP_STATUS_INVALID_POINTER;
+
+	if (width < 1 || width > 8192 || height < 1 || height > 8192)
+		return VDP_STATUS_INVALID_SIZE;
+
+	if (chroma_type != VDP_CHROMA_TYPE_420)
+		return VDP_STATUS_INVALID_CHROMA_TYPE;
+
+	device_ctx_t *dev = handle_get(device);
+	if (!dev)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	switch (format)
+	{
+	case VDP_YCBCR_FORMAT_NV12:
+		if (pitches[0] != luma_pitch || pitches[1] != luma_pitch)
+			return VDP_STATUS_ERROR;
+		size = max((uint64_t)offsets[0] + luma_pitch * height, (uint64_t)offsets[1] + luma_pitch * (height / 2));
+		break;
+
+	case VDP_YCBCR_FORMAT_YV12:
+	case VDP_YCBCR_FORMAT_SUNXI_I420:
+		if (pitches[0] != luma_pitch || pitches[1] != luma_pitch / 2 || pitches[2] != luma_pitch / 2)
+			return VDP_STATUS_ERROR;
+		size = max((uint64_t)offsets[0] + luma_pitch * height,
+		           (uint64_t)max(offsets[1], offsets[2]) + luma_pitch / 2 * (height / 2));
+		break;
+
+	default:
+		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	}
+
+	if (size > UINT32_MAX)
+		return VDP_STATUS_ERROR;
+
+	video_surface_ctx_t *vs = handle_create(HANDLE_TYPE_VIDEO_SURFACE, sizeof(*vs), surface);
+	if (!vs)
+		return VDP_STATUS_RESOURCES;
+
+	vs->device = dev;
+	vs->width = width;
+	vs->height = height;
+	vs->chroma_type = chroma_type;
+	vs->luma_size = ALIGN(width, 32) * ALIGN(height, 32);
+	vs->chroma_size = ALIGN(width, 32) * ALIGN(height / 2, 32);
+
+	vs->yuv = calloc(1, sizeof(yuv_data_t));
+	if (!vs->yuv)
+		goto err_handle;
+
+	vs->yuv->ref_count = 1;
+	vs->yuv->device = dev;
+	vs->yuv->size = size;
+	vs->yuv->data = arena_import(fd, size);
+	if (!vs->yuv->data)
+		goto err_yuv;
+
+	// without a physical address the buffer could never be displayed
+	if (!arena_get_phys_addr(vs->yuv->data))
+	{
+		VDPAU_DBG("Imported dma-buf has no known physical address");
+		ret = VDP_STATUS_ERROR;
+		goto err_data;
+	}
+
+	// the display handles both as linear buffers with the pitch of the surface
+	if (format == VDP_YCBCR_FORMAT_NV12)
+	{
+		vs->source_format = VDP_YCBCR_FORMAT_NV12;
+		video_surface_set_layout(vs, SURFACE_LAYOUT_NV12, pitches[0], pitches[1]);
+		vs->offsets[0] = offsets[0];
+		vs->offsets[1] = offsets[1];
+	}
+	else
+	{
+		// YV12 has Cr before Cb
+		int cb = format == VDP_YCBCR_FORMAT_YV12 ? 2 : 1;
+
+		vs->source_format = VDP_YCBCR_FORMAT_YV12;
+		video_surface_set_layout(vs, SURFACE_LAYOUT_PLANAR, pitches[0], pitches[1]);
+		vs->offsets[0] = offsets[0];
+		vs->offsets[1] = offsets[cb];
+		vs->offsets[2] = offsets[3 - cb];
+	}
+
+	VDPAU_DBG("Imported %ux%u dma-buf, physical address 0x%08x", width, height, arena_get_phys_addr(vs->yuv->data));
+
+	return VDP_STATUS_OK;
+
+err_data:
+	arena_free(vs->yuv->data);
+err_yuv:
+	free(vs->yuv);
+err_handle:
+	handle_destroy(*surface);
+	return ret;
+}
+
+VdpStatus vdp_video_surface_export_sunxi(VdpVideoSurface surface,
+                                         VdpSunxiSurfaceDescriptor *descriptor,
+                                         VdpSunxiExport *export_handle)
+{
+	static const VdpSunxiLayout layouts[] =
+	{
+		[SURFACE_LAYOUT_TILED] = VDP_SUNXI_LAYOUT_TILED,
+		[SURFACE_LAYOUT_PLANAR] = VDP_SUNXI_LAYOUT_PLANAR,
+		[SURFACE_LAYOUT_NV12] = VDP_SUNXI_LAYOUT_NV12,
+		[SURFACE_LAYOUT_YUYV] = VDP_SUNXI_LAYOUT_YUYV,
+		[SURFACE_LAYOUT_UYVY] = VDP_SUNXI_LAYOUT_UYVY,
+	};
+
+	if (!descriptor || !export_handle)
+		return VDP_STATUS_INVALID_POINTER;
+
+	video_surface_ctx_t *vs = handle_get(surface);
+	if (!vs)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	// the importer gets the finished picture
+	decode_queue_wait(vs->device, vs->fence);
+
+	surface_export_ctx_t *ex = handle_create(HANDLE_TYPE_SURFACE_EXPORT, sizeof(*ex), export_handle);
+	if (!ex)
+		return VDP_STATUS_RESOURCES;
+
+	// the next decode or put bits goes to another buffer while this reference is held
+	ex->yuv = yuv_ref(__atomic_load_n(&vs->yuv, __ATOMIC_ACQUIRE));
+
+	descriptor->fd = -1;
+	if (arena_get_fd(ex->yuv->data) != -1)
+	{
+		descriptor->fd = dup(arena_get_fd(ex->yuv->data));
+		if (descriptor->fd == -1)
+		{
+			yuv_unref(ex->yuv);
+			handle_destroy(*export_handle);
+			*export_handle = VDP_INVALID_HANDLE;
+			return VDP_STATUS_RESOURCES;
+		}
+	}
+
+	descriptor->layout = layouts[vs->layout];
+	video_surface_get_display_size(vs, &descriptor->width, &descriptor->height);
+	descriptor->phys_addr = arena_get_phys_addr(ex->yuv->data);
+	descriptor->pointer = arena_get_pointer(ex->yuv->data);
+	descriptor->size = ex->yuv->size;
+
+	int i;
+	for (i = 0; i < 3; i++)
+	{
+		descriptor->pitches[i] = vs->pitches[i];
+		descriptor->offsets[i] = vs->pitches[i] ? vs->offsets[i] : 0;
+	}
+
+	return VDP_STATUS_OK;
+}
+
+VdpStatus vdp_video_surface_export_release_sunxi(VdpSunxiExport export_handle)
+{
+	surface_export_ctx_t *ex = handle_get(export_handle);
+	if (!ex)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	yuv_unref(ex->yuv);
+	handle_destroy(export_handle);
+
 	return VDP_STATUS_OK;
 }
 
@@ -143,14 +527,23 @@ VdpStatus vdp_video_surface_destroy(VdpVideoSurface surface)
 	if (!vs)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	if (vs->decoder_private_free)
-		vs->decoder_private_free(vs);
+	// queued jobs may still use this surface as reference
+	decode_queue_drain(vs->device);
+
+	if (!surface_pool_put(vs))
+	{
+		if (vs->decoder_private_free)
+			vs->decoder_private_free(vs);
 
-	if (vs->rec && vs->rec != vs->yuv->data)
-		cedrus_mem_free(vs->rec);
+		if (vs->rec && vs->rec != vs->yuv->data && !(vs->spare_yuv && vs->rec == vs->spare_yuv->data))
+			arena_free(vs->rec);
 
-	yuv_unref(vs->yuv);
+		yuv_unref(vs->yuv);
+		if (vs->spare_yuv)
+			yuv_unref(vs->spare_yuv);
+	}
 
+	free(vs->scratch);
 	handle_destroy(surface);
 
 	return VDP_STATUS_OK;
@@ -177,6 +570,247 @@ VdpStatus vdp_video_surface_get_parameters(VdpVideoSurface surface,
 	return VDP_STATUS_OK;
 }
 
+void video_surface_set_layout(video_surface_ctx_t *vs, surface_layout_t layout,
+                              uint32_t luma_pitch, uint32_t chroma_pitch)
+{
+	vs->layout = layout;
+	vs->pitches[0] = luma_pitch;
+	vs->pitches[1] = chroma_pitch;
+	vs->pitches[2] = layout == SURFACE_LAYOUT_PLANAR ? chroma_pitch : 0;
+	vs->offsets[0] = 0;
+	vs->offsets[1] = vs->luma_size;
+	vs->offsets[2] = vs->luma_size + vs->chroma_size / 2;
+}
+
+void video_surface_set_decoded_layout(video_surface_ctx_t *vs)
+{
+	uint32_t width, height;
+	video_surface_get_display_size(vs, &width, &height);
+
+	// newer VEs write a planar copy to yuv->data, the tiled picture goes to rec
+	if (cedrus_get_ve_version(vs->device->cedrus) >= 0x1680)
+		video_surface_set_layout(vs, SURFACE_LAYOUT_PLANAR, ALIGN(width, 32), ALIGN(width / 2, 16));
+	else
+		video_surface_set_layout(vs, SURFACE_LAYOUT_TILED, ALIGN(width, 32), ALIGN(width, 32));
+
+	if (vs->scale_shift || vs->rotation)
+	{
+		vs->offsets[1] = ALIGN(width, 32) * ALIGN(height, 32);
+		vs->offsets[2] = vs->offsets[1] + ALIGN(width, 32) * ALIGN(height / 2, 32) / 2;
+	}
+}
+
+// size of the picture in yuv->data
+void video_surface_get_display_size(video_surface_ctx_t *vs, uint32_t *width, uint32_t *height)
+{
+	display_size(vs, vs->scale_shift, vs->rotation, width, height);
+}
+
+// maps a rectangle of the surface to the picture in yuv->data
+void video_surface_get_display_rect(video_surface_ctx_t *vs, VdpRect const *rect, VdpRect *display_rect)
+{
+	uint32_t width = vs->width >> vs->scale_shift, height = vs->height >> vs->scale_shift;
+	uint32_t x0 = rect->x0 >> vs->scale_shift, y0 = rect->y0 >> vs->scale_shift;
+	uint32_t x1 = rect->x1 >> vs->scale_shift, y1 = rect->y1 >> vs->scale_shift;
+
+	switch (vs->rotation)
+	{
+	case 0:
+		*display_rect = (VdpRect){ x0, y0, x1, y1 };
+		break;
+	case 1:
+		*display_rect = (VdpRect){ height - y1, x0, height - y0, x1 };
+		break;
+	case 2:
+		*display_rect = (VdpRect){ width - x1, height - y1, width - x0, height - y0 };
+		break;
+	case 3:
+		*display_rect = (VdpRect){ y0, width - x1, y1, width - x0 };
+		break;
+	}
+}
+
+// SDROT_CTRL bits for writing the display copy of this surface
+uint32_t video_surface_sdrot_ctrl(video_surface_ctx_t *vs)
+{
+	uint32_t ctrl = 0;
+
+	if (vs->scale_shift)
+		ctrl |= SDROT_CTRL_SCALE_DOWN_EN | SDROT_CTRL_SCALE_DOWN(vs->scale_shift);
+
+	if (vs->rotation)
+		ctrl |= SDROT_CTRL_ROTATE_EN | SDROT_CTRL_ROTATE(vs->rotation);
+
+	return ctrl;
+}
+
+static void *surface_scratch(video_surface_ctx_t *vs, size_t size)
+{
+	if (vs->scratch_size < size)
+	{
+		void *scratch = realloc(vs->scratch, size);
+		if (!scratch)
+			return NULL;
+
+		vs->scratch = scratch;
+		vs->scratch_size = size;
+	}
+
+	return vs->scratch;
+}
+
+static void copy_plane(uint8_t *dst, unsigned int dst_pitch, const uint8_t *src, unsigned int src_pitch,
+                       unsigned int width, unsigned int height)
+{
+	if (dst_pitch == src_pitch && src_pitch == width)
+	{
+		memcpy(dst, src, width * height);
+		return;
+	}
+
+	unsigned int y;
+	for (y = 0; y < height; y++)
+		memcpy(dst + y * dst_pitch, src + y * src_pitch, width);
+}
+
+static VdpStatus get_bits_420(video_surface_ctx_t *vs, VdpYCbCrFormat format,
+                              void *const *dst, uint32_t const *pitches)
+{
+	const uint8_t *base = arena_get_pointer(vs->yuv->data);
+	const uint8_t *y = base + vs->offsets[0];
+	const uint8_t *c = base + vs->offsets[1];
+	const uint8_t *c2 = base + vs->offsets[2];
+	uint8_t *cb, *cr;
+	int semiplanar, swapped;
+
+	switch (format)
+	{
+	case VDP_YCBCR_FORMAT_NV12:
+	case VDP_YCBCR_FORMAT_SUNXI_NV21:
+		semiplanar = 1;
+		swapped = format == VDP_YCBCR_FORMAT_SUNXI_NV21;
+		if (pitches[0] < vs->width || pitches[1] < vs->width)
+			return VDP_STATUS_ERROR;
+		break;
+
+	case VDP_YCBCR_FORMAT_YV12:
+	case VDP_YCBCR_FORMAT_SUNXI_I420:
+		semiplanar = 0;
+		swapped = format == VDP_YCBCR_FORMAT_YV12;
+		if (pitches[0] < vs->width || pitches[1] < vs->width / 2 || pitches[2] != pitches[1])
+			return VDP_STATUS_ERROR;
+		break;
+
+	default:
+		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	}
+
+	// YV12 has Cr before Cb
+	cb = dst[swapped ? 2 : 1];
+	cr = dst[swapped ? 1 : 2];
+
+	switch (vs->layout)
+	{
+	case SURFACE_LAYOUT_TILED:
+		readback_tiled_to_planar(vs->device, (void *)y, dst[0], pitches[0], vs->width, vs->height);
+		if (!semiplanar)
+			readback_tiled_deinterleave_to_planar(vs->device, (void *)c, cb, cr, pitches[1], vs->width, vs->height / 2);
+		else if (swapped)
+			readback_tiled_swap_to_planar(vs->device, (void *)c, dst[1], pitches[1], vs->width, vs->height / 2);
+		else
+			readback_tiled_to_planar(vs->device, (void *)c, dst[1], pitches[1], vs->width, vs->height / 2);
+		return VDP_STATUS_OK;
+
+	case SURFACE_LAYOUT_PLANAR:
+		copy_plane(dst[0], pitches[0], y, vs->pitches[0], vs->width, vs->height);
+		if (!semiplanar)
+		{
+			copy_plane(cb, pitches[1], c, vs->pitches[1], vs->width / 2, vs->height / 2);
+			copy_plane(cr, pitches[1], c2, vs->pitches[2], vs->width / 2, vs->height / 2);
+		}
+		else if (swapped)
+			readback_planar_interleave(vs->device, (void *)c2, (void *)c, dst[1], vs->pitches[1], pitches[1], vs->width, vs->height / 2);
+		else
+			readback_planar_interleave(vs->device, (void *)c, (void *)c2, dst[1], vs->pitches[1], pitches[1], vs->width, vs->height / 2);
+		return VDP_STATUS_OK;
+
+	case SURFACE_LAYOUT_NV12:
+		copy_plane(dst[0], pitches[0], y, vs->pitches[0], vs->width, vs->height);
+		if (!semiplanar)
+			readback_planar_deinterleave(vs->device, (void *)c, cb, cr, vs->pitches[1], pitches[1], vs->width, vs->height / 2);
+		else if (swapped)
+			readback_planar_swap(vs->device, (void *)c, dst[1], vs->pitches[1], pitches[1], vs->width, vs->height / 2);
+		else
+			copy_plane(dst[1], pitches[1], c, vs->pitches[1], vs->width, vs->height / 2);
+		return VDP_STATUS_OK;
+
+	default:
+		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	}
+}
+
+static VdpStatus get_bits_422(video_surface_ctx_t *vs, VdpYCbCrFormat format,
+                              void *const *dst, uint32_t const *pitches)
+{
+	const uint8_t *src = arena_get_pointer(vs->yuv->data);
+
+	if (format != VDP_YCBCR_FORMAT_YUYV && format != VDP_YCBCR_FORMAT_UYVY)
+		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+
+	if (vs->layout != SURFACE_LAYOUT_YUYV && vs->layout != SURFACE_LAYOUT_UYVY)
+		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+
+	if (pitches[0] < 2 * vs->width)
+		return VDP_STATUS_ERROR;
+
+	// YUYV and UYVY only differ in the order within each byte pair
+	if ((format == VDP_YCBCR_FORMAT_YUYV) == (vs->layout == SURFACE_LAYOUT_YUYV))
+		copy_plane(dst[0], pitches[0], src, vs->pitches[0], 2 * vs->width, vs->height);
+	else
+		readback_planar_swap(vs->device, (void *)src, dst[0], vs->pitches[0], pitches[0], 2 * vs->width, vs->height);
+
+	return VDP_STATUS_OK;
+}
+
+static VdpStatus get_bits_packed(video_surface_ctx_t *vs, VdpYCbCrFormat format,
+                                 void *const *dst, uint32_t const *pitches)
+{
+	unsigned int cw = (vs->width + 1) / 2, ch = (vs->height + 1) / 2;
+	unsigned int x, y;
+
+	if (pitches[0] < 4 * vs->width)
+		return VDP_STATUS_ERROR;
+
+	// read back as I420 first, then spread the chroma over 2x2 pixels
+	uint8_t *tmp = surface_scratch(vs, vs->width * vs->height + 2 * cw * ch);
+	if (!tmp)
+		return VDP_STATUS_RESOURCES;
+
+	void *planes[3] = { tmp, tmp + vs->width * vs->height, tmp + vs->width * vs->height + cw * ch };
+	uint32_t tmp_pitches[3] = { vs->width, cw, cw };
+
+	VdpStatus ret = get_bits_420(vs, VDP_YCBCR_FORMAT_SUNXI_I420, planes, tmp_pitches);
+	if (ret != VDP_STATUS_OK)
+		return ret;
+
+	const uint8_t *ty = planes[0], *tu = planes[1], *tv = planes[2];
+	int yc = format == VDP_YCBCR_FORMAT_Y8U8V8A8 ? 0 : 2;
+
+	for (y = 0; y < vs->height; y++)
+	{
+		uint8_t *d = (uint8_t *)dst[0] + y * pitches[0];
+		for (x = 0; x < vs->width; x++, d += 4)
+		{
+			d[yc] = ty[y * vs->width + x];
+			d[1] = tu[(y / 2) * cw + x / 2];
+			d[2 - yc] = tv[(y / 2) * cw + x / 2];
+			d[3] = 0xff;
+		}
+	}
+
+	return VDP_STATUS_OK;
+}
+
 VdpStatus vdp_video_surface_get_bits_y_cb_cr(VdpVideoSurface surface,
                                              VdpYCbCrFormat destination_ycbcr_format,
                                              void *const *destination_data,
@@ -186,30 +820,157 @@ VdpStatus vdp_video_surface_get_bits_y_cb_cr(VdpVideoSurface surface,
 	if (!vs)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	if (vs->chroma_type != VDP_CHROMA_TYPE_420 || vs->source_format != INTERNAL_YCBCR_FORMAT)
-		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	if (!destination_data || !destination_pitches)
+		return VDP_STATUS_INVALID_POINTER;
 
-	if (destination_pitches[0] < vs->width || destination_pitches[1] < vs->width / 2)
-		return VDP_STATUS_ERROR;
+	decode_queue_wait(vs->device, vs->fence);
 
-#ifndef __aarch64__
-	switch (destination_ycbcr_format)
+	// the unchanged picture of scaled down or rotated surfaces is only in rec, tiled
+	video_surface_ctx_t *owner = vs, full;
+	yuv_data_t rec;
+	if (vs->scale_shift || vs->rotation)
 	{
-	case VDP_YCBCR_FORMAT_NV12:
-		tiled_to_planar(cedrus_mem_get_pointer(vs->yuv->data), destination_data[0], destination_pitches[0], vs->width, vs->height);
-		tiled_to_planar(cedrus_mem_get_pointer(vs->yuv->data) + vs->luma_size, destination_data[1], destination_pitches[1], vs->width, vs->height / 2);
-		return VDP_STATUS_OK;
-
-	case VDP_YCBCR_FORMAT_YV12:
-		if (destination_pitches[2] != destination_pitches[1])
+		if (!vs->rec)
 			return VDP_STATUS_ERROR;
-		tiled_to_planar(cedrus_mem_get_pointer(vs->yuv->data), destination_data[0], destination_pitches[0], vs->width, vs->height);
-		tiled_deinterleave_to_planar(cedrus_mem_get_pointer(vs->yuv->data) + vs->luma_size, destination_data[2], destination_data[1], destination_pitches[1], vs->width, vs->height / 2);
-		return VDP_STATUS_OK;
+
+		full = *vs;
+		rec = (yuv_data_t){ .data = vs->rec, .size = vs->luma_size + vs->chroma_size };
+		full.yuv = &rec;
+		full.scale_shift = 0;
+		full.rotation = 0;
+		video_surface_set_layout(&full, SURFACE_LAYOUT_TILED, ALIGN(vs->width, 32), ALIGN(vs->width, 32));
+		vs = &full;
+	}
+
+	VdpStatus ret;
+	switch (vs->chroma_type)
+	{
+	case VDP_CHROMA_TYPE_420:
+		if (destination_ycbcr_format == VDP_YCBCR_FORMAT_Y8U8V8A8 ||
+		    destination_ycbcr_format == VDP_YCBCR_FORMAT_V8U8Y8A8)
+			ret = get_bits_packed(vs, destination_ycbcr_format, destination_data, destination_pitches);
+		else
+			ret = get_bits_420(vs, destination_ycbcr_format, destination_data, destination_pitches);
+		break;
+
+	case VDP_CHROMA_TYPE_422:
+		ret = get_bits_422(vs, destination_ycbcr_format, destination_data, destination_pitches);
+		break;
+
+	default:
+		ret = VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+		break;
 	}
-#endif
 
-	return VDP_STATUS_ERROR;
+	// the copy may have grown the surface's scratch buffer
+	owner->scratch = vs->scratch;
+	owner->scratch_size = vs->scratch_size;
+
+	return ret;
+}
+
+static void put_bits_420(video_surface_ctx_t *vs, VdpYCbCrFormat format,
+                         void const *const *src, uint32_t const *pitches)
+{
+	uint8_t *base = arena_get_pointer(vs->yuv->data);
+	uint8_t *y, *c, *c2;
+	int semiplanar = format == VDP_YCBCR_FORMAT_NV12 || format == VDP_YCBCR_FORMAT_SUNXI_NV21;
+	int swapped = format == VDP_YCBCR_FORMAT_SUNXI_NV21 || format == VDP_YCBCR_FORMAT_YV12;
+
+	// YV12 has Cr before Cb
+	int cb = swapped ? 2 : 1;
+	int cr = swapped ? 1 : 2;
+
+	y = base + vs->offsets[0];
+	c = base + vs->offsets[1];
+	c2 = base + vs->offsets[2];
+
+	if (vs->layout == SURFACE_LAYOUT_TILED)
+	{
+		planar_to_tiled((void *)src[0], y, pitches[0], vs->width, vs->height);
+		if (!semiplanar)
+			planar_interleave_to_tiled((void *)src[cb], (void *)src[cr], c, pitches[1], vs->width, vs->height / 2);
+		else if (swapped)
+			planar_swap_to_tiled((void *)src[1], c, pitches[1], vs->width, vs->height / 2);
+		else
+			planar_to_tiled((void *)src[1], c, pitches[1], vs->width, vs->height / 2);
+	}
+	else
+	{
+		copy_plane(y, vs->pitches[0], src[0], pitches[0], vs->width, vs->height);
+		if (!semiplanar)
+		{
+			copy_plane(c, vs->pitches[1], src[cb], pitches[cb], vs->width / 2, vs->height / 2);
+			copy_plane(c2, vs->pitches[2], src[cr], pitches[cr], vs->width / 2, vs->height / 2);
+		}
+		else if (swapped)
+			planar_deinterleave((void *)src[1], c2, c, pitches[1], vs->pitches[1], vs->width, vs->height / 2);
+		else
+			planar_deinterleave((void *)src[1], c, c2, pitches[1], vs->pitches[1], vs->width, vs->height / 2);
+	}
+}
+
+static void packed_lines_to_420(VdpYCbCrFormat format, const uint8_t *src, uint32_t src_pitch,
+                                uint8_t *y, uint32_t y_pitch, uint8_t *u, uint8_t *v, uint32_t c_pitch,
+                                unsigned int width, unsigned int height)
+{
+	int yuva = format == VDP_YCBCR_FORMAT_Y8U8V8A8;
+	unsigned int fast = width & ~15;
+	unsigned int i, x;
+
+	for (i = 0; i + 1 < height; i += 2)
+	{
+		void *s0 = (void *)(src + i * src_pitch), *s1 = (void *)(src + (i + 1) * src_pitch);
+		uint8_t *y0 = y + i * y_pitch, *y1 = y0 + y_pitch;
+		uint8_t *cu = u + (i / 2) * c_pitch, *cv = v + (i / 2) * c_pitch;
+
+		(yuva ? yuva_to_420 : vuya_to_420)(s0, s1, y0, y1, cu, cv, fast);
+
+		if (fast < width)
+			(yuva ? yuva_to_420_ref : vuya_to_420_ref)(s0 + 4 * fast, s1 + 4 * fast, y0 + fast, y1 + fast,
+			                                           cu + fast / 2, cv + fast / 2, width - fast);
+	}
+
+	// an odd last line has no chroma line of its own
+	if (i < height)
+		for (x = 0; x < width; x++)
+			y[i * y_pitch + x] = src[i * src_pitch + 4 * x + (yuva ? 0 : 2)];
+}
+
+static void put_bits_packed(video_surface_ctx_t *vs, VdpYCbCrFormat format,
+                            void const *const *src, uint32_t const *pitches)
+{
+	uint8_t *base = arena_get_pointer(vs->yuv->data);
+	uint8_t *y, *c;
+	unsigned int row;
+
+	y = base + vs->offsets[0];
+	c = base + vs->offsets[1];
+
+	if (vs->layout == SURFACE_LAYOUT_PLANAR)
+	{
+		packed_lines_to_420(format, src[0], pitches[0], y, vs->pitches[0], c, base + vs->offsets[2],
+		                    vs->pitches[1], vs->width, vs->height);
+		return;
+	}
+
+	// tiled surfaces are filled through the strip put_bits reserved in the scratch buffer
+	unsigned int cw = vs->width / 2;
+	uint8_t *strip = vs->scratch;
+
+	uint8_t *strip_u = strip + 64 * vs->width;
+	uint8_t *strip_v = strip_u + 32 * cw;
+
+	for (row = 0; row < vs->height; row += 64)
+	{
+		unsigned int height = min(vs->height - row, 64);
+
+		packed_lines_to_420(format, (const uint8_t *)src[0] + row * pitches[0], pitches[0],
+		                    strip, vs->width, strip_u, strip_v, cw, vs->width, height);
+
+		planar_to_tiled(strip, y + row * vs->pitches[0], vs->width, vs->width, height);
+		planar_interleave_to_tiled(strip_u, strip_v, c + row / 2 * vs->pitches[1], cw, vs->width, height / 2);
+	}
 }
 
 VdpStatus vdp_video_surface_put_bits_y_cb_cr(VdpVideoSurface surface,
@@ -217,85 +978,96 @@ VdpStatus vdp_video_surface_put_bits_y_cb_cr(VdpVideoSurface surface,
                                              void const *const *source_data,
                                              uint32_t const *source_pitches)
 {
-	int i;
-	const uint8_t *src;
 	uint8_t *dst;
 	video_surface_ctx_t *vs = handle_get(surface);
 	if (!vs)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	VdpStatus ret = yuv_prepare(vs);
-	if (ret != VDP_STATUS_OK)
-		return ret;
+	if (!source_data || !source_pitches)
+		return VDP_STATUS_INVALID_POINTER;
 
-	vs->source_format = source_ycbcr_format;
+	// imported buffers belong to the application, which can write them directly
+	if (arena_is_imported(vs->yuv->data))
+		return VDP_STATUS_ERROR;
 
+	// check everything before the surface is touched
 	switch (source_ycbcr_format)
 	{
 	case VDP_YCBCR_FORMAT_YUYV:
 	case VDP_YCBCR_FORMAT_UYVY:
 		if (vs->chroma_type != VDP_CHROMA_TYPE_422)
 			return VDP_STATUS_INVALID_CHROMA_TYPE;
-		src = source_data[0];
-		dst = cedrus_mem_get_pointer(vs->yuv->data);
-		for (i = 0; i < vs->height; i++) {
-			memcpy(dst, src, 2*vs->width);
-			src += source_pitches[0];
-			dst += 2*vs->width;
-		}
 		break;
+
 	case VDP_YCBCR_FORMAT_Y8U8V8A8:
 	case VDP_YCBCR_FORMAT_V8U8Y8A8:
-
+		if (vs->chroma_type != VDP_CHROMA_TYPE_420)
+			return VDP_STATUS_INVALID_CHROMA_TYPE;
+		/*
+		 * Tiled surfaces are filled through a strip of one chroma tile row
+		 * (64 luma lines), which stays in cache between repacking and tiling.
+		 */
+		if (cedrus_get_ve_version(vs->device->cedrus) < 0x1680 &&
+		    !surface_scratch(vs, 64 * vs->width + 2 * 32 * (vs->width / 2)))
+			return VDP_STATUS_RESOURCES;
 		break;
 
 	case VDP_YCBCR_FORMAT_NV12:
+	case VDP_YCBCR_FORMAT_SUNXI_NV21:
 		if (vs->chroma_type != VDP_CHROMA_TYPE_420)
 			return VDP_STATUS_INVALID_CHROMA_TYPE;
-		src = source_data[0];
-		dst = cedrus_mem_get_pointer(vs->yuv->data);
-		for (i = 0; i < vs->height; i++) {
-			memcpy(dst, src, vs->width);
-			src += source_pitches[0];
-			dst += vs->width;
-		}
-		src = source_data[1];
-		dst = cedrus_mem_get_pointer(vs->yuv->data) + vs->luma_size;
-		for (i = 0; i < vs->height / 2; i++) {
-			memcpy(dst, src, vs->width);
-			src += source_pitches[1];
-			dst += vs->width;
-		}
 		break;
 
 	case VDP_YCBCR_FORMAT_YV12:
+	case VDP_YCBCR_FORMAT_SUNXI_I420:
 		if (vs->chroma_type != VDP_CHROMA_TYPE_420)
 			return VDP_STATUS_INVALID_CHROMA_TYPE;
-		src = source_data[0];
-		dst = cedrus_mem_get_pointer(vs->yuv->data);
-		for (i = 0; i < vs->height; i++) {
-			memcpy(dst, src, vs->width);
-			src += source_pitches[0];
-			dst += vs->width;
-		}
-		src = source_data[2];
-		dst = cedrus_mem_get_pointer(vs->yuv->data) + vs->luma_size;
-		for (i = 0; i < vs->height / 2; i++) {
-			memcpy(dst, src, vs->width / 2);
-			src += source_pitches[1];
-			dst += vs->width / 2;
-		}
-		src = source_data[1];
-		dst = cedrus_mem_get_pointer(vs->yuv->data) + vs->luma_size + vs->chroma_size / 2;
-		for (i = 0; i < vs->height / 2; i++) {
-			memcpy(dst, src, vs->width / 2);
-			src += source_pitches[2];
-			dst += vs->width / 2;
-		}
+		// tiled surfaces get both chroma planes interleaved in one go
+		if (cedrus_get_ve_version(vs->device->cedrus) < 0x1680 && source_pitches[1] != source_pitches[2])
+			return VDP_STATUS_ERROR;
+		break;
+
+	default:
+		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	}
+
+	// queued decodes may still read the old picture as reference
+	decode_queue_wait(vs->device, max(vs->fence, vs->ref_fence));
+
+	// uploads are always full size and upright
+	VdpStatus ret = yuv_prepare(vs, 0, 0);
+	if (ret != VDP_STATUS_OK)
+		return ret;
+
+	vs->scale_shift = 0;
+	vs->rotation = 0;
+	dst = arena_get_pointer(vs->yuv->data);
+
+	switch (source_ycbcr_format)
+	{
+	case VDP_YCBCR_FORMAT_YUYV:
+	case VDP_YCBCR_FORMAT_UYVY:
+		vs->source_format = source_ycbcr_format;
+		video_surface_set_layout(vs, source_ycbcr_format == VDP_YCBCR_FORMAT_YUYV ? SURFACE_LAYOUT_YUYV : SURFACE_LAYOUT_UYVY, 2 * vs->width, 0);
+		copy_plane(dst, vs->pitches[0], source_data[0], source_pitches[0], 2 * vs->width, vs->height);
+		break;
+
+	case VDP_YCBCR_FORMAT_Y8U8V8A8:
+	case VDP_YCBCR_FORMAT_V8U8Y8A8:
+		// uploads are stored like decoded pictures, so display and readback treat both alike
+		vs->source_format = INTERNAL_YCBCR_FORMAT;
+		video_surface_set_decoded_layout(vs);
+		put_bits_packed(vs, source_ycbcr_format, source_data, source_pitches);
+		break;
+
+	default:
+		vs->source_format = INTERNAL_YCBCR_FORMAT;
+		video_surface_set_decoded_layout(vs);
+		put_bits_420(vs, source_ycbcr_format, source_data, source_pitches);
 		break;
 	}
 
-	cedrus_mem_flush_cache(vs->yuv->data);
+	arena_flush_cache(vs->yuv->data);
 
 	return VDP_STATUS_OK;
 }
@@ -313,7 +1085,8 @@ VdpStatus vdp_video_surface_query_capabilities(VdpDevice device,
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	*is_supported = surface_chroma_type == VDP_CHROMA_TYPE_420;
+	*is_supported = surface_chroma_type == VDP_CHROMA_TYPE_420 ||
+			surface_chroma_type == VDP_CHROMA_TYPE_422;
 	*max_width = 8192;
 	*max_height = 8192;
 
@@ -332,11 +1105,24 @@ VdpStatus vdp_video_surface_query_get_put_bits_y_cb_cr_capabilities(VdpDevice de
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	if (surface_chroma_type == VDP_CHROMA_TYPE_420)
+	switch (surface_chroma_type)
+	{
+	case VDP_CHROMA_TYPE_420:
 		*is_supported = (bits_ycbcr_format == VDP_YCBCR_FORMAT_NV12) ||
-				(bits_ycbcr_format == VDP_YCBCR_FORMAT_YV12);
-	else
+				(bits_ycbcr_format == VDP_YCBCR_FORMAT_YV12) ||
+				(bits_ycbcr_format == VDP_YCBCR_FORMAT_SUNXI_I420) ||
+				(bits_ycbcr_format == VDP_YCBCR_FORMAT_SUNXI_NV21) ||
+				(bits_ycbcr_format == VDP_YCBCR_FORMAT_Y8U8V8A8) ||
+				(bits_ycbcr_format == VDP_YCBCR_FORMAT_V8U8Y8A8);
+		break;
+	case VDP_CHROMA_TYPE_422:
+		*is_supported = (bits_ycbcr_format == VDP_YCBCR_FORMAT_YUYV) ||
+				(bits_ycbcr_format == VDP_YCBCR_FORMAT_UYVY);
+		break;
+	default:
 		*is_supported = VDP_FALSE;
+		break;
+	}
 
 	return VDP_STATUS_OK;
 }
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Time per H.264 picture on the software libcedrus stand-in, for a
+ * P picture stream with one and with sixteen reference frames, so the
+ * cost of keeping the reference model up to date shows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+#include "helpers.h"
+
+#define WIDTH		1920
+#define HEIGHT		1088
+#define SURFACES	17
+#define WARMUP		32
+#define PICTURES	2000
+
+static double bench(VdpDevice device, VdpVideoSurface *surfaces, unsigned int refs)
+{
+	VdpDecoder decoder;
+	uint8_t slice[64];
+	unsigned int n, i;
+	double start = 0.0;
+
+	if (vdp_decoder_create(device, VDP_DECODER_PROFILE_H264_HIGH, WIDTH, HEIGHT, refs, &decoder) != VDP_STATUS_OK)
+		return -1.0;
+
+	VdpPictureInfoH264 info;
+	test_h264_info(&info, refs);
+
+	for (n = 0; n < WARMUP + PICTURES; n++)
+	{
+		if (n == WARMUP)
+			start = test_now();
+
+		info.frame_num = n % 16;
+		info.field_order_cnt[0] = info.field_order_cnt[1] = 2 * n;
+		info.num_ref_idx_l0_active_minus1 = min(n, refs) ? min(n, refs) - 1 : 0;
+
+		// a sliding window of the last refs pictures
+		for (i = 0; i < 16; i++)
+		{
+			VdpReferenceFrameH264 *rf = &info.referenceFrames[i];
+			memset(rf, 0, sizeof(*rf));
+			rf->surface = VDP_INVALID_HANDLE;
+
+			if (i < min(n, refs))
+			{
+				unsigned int p = n - 1 - i;
+				rf->surface = surfaces[p % SURFACES];
+				rf->top_is_reference = rf->bottom_is_reference = VDP_TRUE;
+				rf->field_order_cnt[0] = rf->field_order_cnt[1] = 2 * p;
+				rf->frame_idx = p % 16;
+			}
+		}
+
+		VdpBitstreamBuffer buffer = { .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = slice,
+		                              .bitstream_bytes = test_h264_p_slice(slice, n % 16) };
+
+		if (vdp_decoder_render(decoder, surfaces[n % SURFACES], (VdpPictureInfo const *)&info, 1, &buffer) != VDP_STATUS_OK)
+			return -1.0;
+	}
+
+	double us = (test_now() - start) / PICTURES * 1e6;
+
+	vdp_decoder_destroy(decoder);
+
+	return us;
+}
+
+int main(void)
+{
+	VdpDevice device;
+	VdpVideoSurface surfaces[SURFACES];
+	int i;
+
+	test_device_create(NULL, &device);
+
+	for (i = 0; i < SURFACES; i++)
+		if (vdp_video_surface_create(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, &surfaces[i]) != VDP_STATUS_OK)
+			return 1;
+
+	double one = bench(device, surfaces, 1);
+	double sixteen = bench(device, surfaces, 16);
+
+	printf("H.264 1920x1088 P pictures, time per picture:\n");
+	printf("  1 reference:   %6.2f us\n", one);
+	printf("  16 references: %6.2f us\n", sixteen);
+
+	for (i = 0; i < SURFACES; i++)
+		vdp_video_surface_destroy(surfaces[i]);
+	test_device_destroy(device);
+
+	return one < 0.0 || sixteen < 0.0;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * handle_get() throughput with one to four threads, next to a table
+ * behind a pthread rwlock as handle_get() used to be.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include "vdpau_private.h"
+#include "helpers.h"
+
+#define HANDLES		64
+#define LOOKUPS		(4 * 1000 * 1000)
+
+static VdpHandle handles[HANDLES];
+
+static struct
+{
+	pthread_rwlock_t lock;
+	void *data[HANDLES];
+} rwlock_table = { PTHREAD_RWLOCK_INITIALIZER };
+
+static void *rwlock_get(VdpHandle handle)
+{
+	pthread_rwlock_rdlock(&rwlock_table.lock);
+	void *data = rwlock_table.data[handle % HANDLES];
+	pthread_rwlock_unlock(&rwlock_table.lock);
+
+	return data;
+}
+
+static void *(*lookup)(VdpHandle handle);
+
+static void *lookup_thread(void *arg)
+{
+	uintptr_t sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < LOOKUPS; i++)
+		sum += (uintptr_t)lookup(handles[i % HANDLES]);
+
+	return (void *)sum;
+}
+
+static void bench(const char *name, void *(*func)(VdpHandle handle))
+{
+	pthread_t threads[4];
+	int n, i;
+
+	lookup = func;
+
+	for (n = 1; n <= 4; n++)
+	{
+		double start = test_now();
+
+		for (i = 0; i < n; i++)
+			pthread_create(&threads[i], NULL, lookup_thread, NULL);
+		for (i = 0; i < n; i++)
+			pthread_join(threads[i], NULL);
+
+		double secs = test_now() - start;
+
+		printf("%-10s %d thread%s: %7.1f M lookups/s\n", name, n, n > 1 ? "s" : " ",
+		       n * (double)LOOKUPS / secs / 1e6);
+	}
+}
+
+int main(void)
+{
+	int i;
+
+	for (i = 0; i < HANDLES; i++)
+		rwlock_table.data[i] = handle_create(HANDLE_TYPE_VIDEO_SURFACE, 64, &handles[i]);
+
+	bench("handle_get", handle_get);
+	bench("rwlock", rwlock_get);
+
+	for (i = 0; i < HANDLES; i++)
+		handle_destroy(handles[i]);
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Readback throughput of a 1080p and a 2160p picture (luma and NV12
+ * chroma) with one to four threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+#include "helpers.h"
+
+#define FRAMES	50
+
+static void bench(unsigned int width, unsigned int height)
+{
+	size_t luma = ALIGN(width, 32) * ALIGN(height, 32);
+	size_t chroma = ALIGN(width, 32) * ALIGN(height / 2, 32);
+	uint8_t *src = malloc(luma + chroma);
+	uint8_t *dst = malloc(width * height * 3 / 2);
+	double base = 0.0;
+	int threads;
+
+	memset(src, 0x80, luma + chroma);
+
+	for (threads = 1; threads <= 4; threads++)
+	{
+		device_ctx_t device = { .readback_pool = NULL };
+		double start;
+		int i;
+
+		readback_pool_create(&device, threads);
+
+		// warm up caches and workers
+		readback_tiled_to_planar(&device, src, dst, width, width, height);
+
+		start = test_now();
+		for (i = 0; i < FRAMES; i++)
+		{
+			readback_tiled_to_planar(&device, src, dst, width, width, height);
+			readback_tiled_deinterleave_to_planar(&device, src + luma, dst + width * height,
+			                                      dst + width * height * 5 / 4, width / 2, width, height / 2);
+		}
+		double ms = (test_now() - start) * 1000.0 / FRAMES;
+
+		if (threads == 1)
+			base = ms;
+
+		printf("%4ux%-4u %d thread%s: %6.2f ms/frame, %6.1f MB/s, speedup %.2f\n",
+		       width, height, threads, threads > 1 ? "s" : " ", ms,
+		       width * height * 1.5 / ms / 1000.0, base / ms);
+
+		readback_pool_destroy(&device);
+	}
+
+	free(dst);
+	free(src);
+}
+
+int main(void)
+{
+	bench(1920, 1080);
+	bench(3840, 2160);
+
+	return 0;
+}
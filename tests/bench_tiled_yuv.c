@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Single threaded detiling and tiling throughput of a 1080p and a 2160p
+ * picture, from and to a planar buffer with a pitch larger than the width,
+ * and of the linear chroma conversions of the planar layout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+#include "tiled_yuv.h"
+#include "helpers.h"
+
+#define FRAMES	50
+
+static void bench(unsigned int width, unsigned int height)
+{
+	unsigned int pitch = width + 64;
+	size_t luma = ALIGN(width, 32) * ALIGN(height, 32);
+	size_t chroma = ALIGN(width, 32) * ALIGN(height / 2, 32);
+	uint8_t *src = malloc(luma + chroma);
+	uint8_t *dst = malloc(pitch * height * 2);
+	double start, s;
+	int i;
+
+	memset(src, 0x80, luma + chroma);
+	memset(dst, 0, pitch * height * 2);
+
+	start = test_now();
+	for (i = 0; i < FRAMES; i++)
+		tiled_to_planar(src, dst, pitch, width, height);
+	s = (test_now() - start) / FRAMES;
+	printf("%4ux%-4u tiled_to_planar:              %6.2f GB/s\n",
+	       width, height, width * height / s / 1e9);
+
+	start = test_now();
+	for (i = 0; i < FRAMES; i++)
+		tiled_deinterleave_to_planar(src + luma, dst, dst + pitch * height, pitch, width, height / 2);
+	s = (test_now() - start) / FRAMES;
+	printf("%4ux%-4u tiled_deinterleave_to_planar: %6.2f GB/s\n",
+	       width, height, width * height / 2 / s / 1e9);
+
+	start = test_now();
+	for (i = 0; i < FRAMES; i++)
+		tiled_swap_to_planar(src + luma, dst, pitch, width, height / 2);
+	s = (test_now() - start) / FRAMES;
+	printf("%4ux%-4u tiled_swap_to_planar:         %6.2f GB/s\n",
+	       width, height, width * height / 2 / s / 1e9);
+
+	// and the upload direction, from the pitched buffer back into tiles
+	start = test_now();
+	for (i = 0; i < FRAMES; i++)
+		planar_to_tiled(dst, src, pitch, width, height);
+	s = (test_now() - start) / FRAMES;
+	printf("%4ux%-4u planar_to_tiled:              %6.2f GB/s\n",
+	       width, height, width * height / s / 1e9);
+
+	start = test_now();
+	for (i = 0; i < FRAMES; i++)
+		planar_interleave_to_tiled(dst, dst + pitch * height, src + luma, pitch, width, height / 2);
+	s = (test_now() - start) / FRAMES;
+	printf("%4ux%-4u planar_interleave_to_tiled:   %6.2f GB/s\n",
+	       width, height, width * height / 2 / s / 1e9);
+
+	start = test_now();
+	for (i = 0; i < FRAMES; i++)
+		planar_swap_to_tiled(dst, src + luma, pitch, width, height / 2);
+	s = (test_now() - start) / FRAMES;
+	printf("%4ux%-4u planar_swap_to_tiled:         %6.2f GB/s\n",
+	       width, height, width * height / 2 / s / 1e9);
+
+	// linear chroma, as get_bits and put_bits use it on planar surfaces
+	start = test_now();
+	for (i = 0; i < FRAMES; i++)
+		planar_interleave(src, src + luma, dst, width / 2, pitch, width, height / 2);
+	s = (test_now() - start) / FRAMES;
+	printf("%4ux%-4u planar_interleave:            %6.2f GB/s\n",
+	       width, height, width * height / 2 / s / 1e9);
+
+	start = test_now();
+	for (i = 0; i < FRAMES; i++)
+		planar_deinterleave(src, dst, dst + pitch * height, width, pitch, width, height / 2);
+	s = (test_now() - start) / FRAMES;
+	printf("%4ux%-4u planar_deinterleave:          %6.2f GB/s\n",
+	       width, height, width * height / 2 / s / 1e9);
+
+	start = test_now();
+	for (i = 0; i < FRAMES; i++)
+		planar_swap(src, dst, width, pitch, width, height / 2);
+	s = (test_now() - start) / FRAMES;
+	printf("%4ux%-4u planar_swap:                  %6.2f GB/s\n",
+	       width, height, width * height / 2 / s / 1e9);
+
+	free(dst);
+	free(src);
+}
+
+int main(void)
+{
+	bench(1920, 1080);
+	bench(3840, 2160);
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Bitstream ingest of a 40 Mbit/s, 25 fps stream (200 kB per picture
+ * with a few slices): the fused copy and start code index against a
+ * memcpy() followed by the byte by byte start code search the codecs
+ * did before.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../decoder.c"
+#include "helpers.h"
+
+#define PICTURE		(200 * 1024)
+#define SLICES		8
+#define PICTURES	2000
+
+static uint8_t stream[PICTURE];
+
+static unsigned int naive_scan(const uint8_t *data, uint32_t len)
+{
+	unsigned int n = 0;
+	uint32_t i;
+
+	for (i = 2; i < len; i++)
+		if (data[i] == 0x01 && data[i - 1] == 0x00 && data[i - 2] == 0x00)
+			n++;
+
+	return n;
+}
+
+int main(void)
+{
+	vbv_t vbv = { .num_startcodes = 0 };
+	cedrus_t *cedrus = cedrus_open();
+	unsigned int i, found = 0;
+
+	vbv.data = cedrus_mem_alloc(cedrus, PICTURE);
+	uint8_t *dst = cedrus_mem_get_pointer(vbv.data);
+
+	// entropy coded data has no start codes and few zeros
+	srand(1);
+	for (i = 0; i < PICTURE; i++)
+		stream[i] = rand() | 0x01;
+	for (i = 0; i < SLICES; i++)
+		memcpy(stream + i * PICTURE / SLICES, "\x00\x00\x01\x65", 4);
+
+	double start = test_now();
+	for (i = 0; i < PICTURES; i++)
+	{
+		memcpy(dst, stream, PICTURE);
+		found += naive_scan(dst, PICTURE);
+	}
+	double naive = test_now() - start;
+
+	start = test_now();
+	for (i = 0; i < PICTURES; i++)
+	{
+		vbv.num_startcodes = 0;
+		vbv_copy_and_index(&vbv, stream, PICTURE, 0);
+		found += vbv.num_startcodes;
+	}
+	double fused = test_now() - start;
+
+	printf("memcpy + scan:  %7.1f MB/s, %5.1f us/picture\n", PICTURES * (double)PICTURE / naive / 1e6, naive / PICTURES * 1e6);
+	printf("copy and index: %7.1f MB/s, %5.1f us/picture\n", PICTURES * (double)PICTURE / fused / 1e6, fused / PICTURES * 1e6);
+
+	free(vbv.startcodes);
+	cedrus_mem_free(vbv.data);
+	cedrus_close(cedrus);
+
+	return found != 2 * PICTURES * SLICES;
+}
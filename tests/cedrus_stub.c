@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Software stand-in for libcedrus, so the driver's CPU side can run on
+ * the build host. Memory is plain heap with made up physical addresses,
+ * the register window is a zeroed block and the VE never has to be
+ * waited for. CEDRUS_STUB_VERSION selects the VE version, default is
+ * 0x1680 (H3).
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <cedrus/cedrus.h>
+
+struct cedrus
+{
+	int version;
+	void *regs;
+};
+
+struct cedrus_mem
+{
+	void *pointer;
+	uint32_t phys;
+};
+
+#define STUB_REGS_SIZE	0x1000
+#define STUB_PHYS_BASE	0x40000000
+
+static uint32_t next_phys = STUB_PHYS_BASE;
+
+unsigned int cedrus_stub_allocs;
+
+cedrus_t *cedrus_open(void)
+{
+	cedrus_t *dev = calloc(1, sizeof(*dev));
+	if (!dev)
+		return NULL;
+
+	const char *version = getenv("CEDRUS_STUB_VERSION");
+	dev->version = version ? strtol(version, NULL, 0) : 0x1680;
+	dev->regs = calloc(1, STUB_REGS_SIZE);
+	if (!dev->regs)
+	{
+		free(dev);
+		return NULL;
+	}
+
+	return dev;
+}
+
+void cedrus_close(cedrus_t *dev)
+{
+	if (!dev)
+		return;
+
+	free(dev->regs);
+	free(dev);
+}
+
+int cedrus_get_ve_version(cedrus_t *dev)
+{
+	return dev ? dev->version : 0x1680;
+}
+
+int cedrus_ve_wait(cedrus_t *dev, int timeout)
+{
+	return 0;
+}
+
+void *cedrus_ve_get(cedrus_t *dev, enum cedrus_engine engine, uint32_t flags)
+{
+	return dev->regs;
+}
+
+void cedrus_ve_put(cedrus_t *dev)
+{
+}
+
+cedrus_mem_t *cedrus_mem_alloc(cedrus_t *dev, size_t size)
+{
+	cedrus_mem_t *mem = malloc(sizeof(*mem));
+	if (!mem)
+		return NULL;
+
+	mem->pointer = calloc(1, size);
+	if (!mem->pointer)
+	{
+		free(mem);
+		return NULL;
+	}
+
+	mem->phys = __atomic_fetch_add(&next_phys, (size + 4095) & ~4095, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&cedrus_stub_allocs, 1, __ATOMIC_RELAXED);
+
+	return mem;
+}
+
+void cedrus_mem_free(cedrus_mem_t *mem)
+{
+	if (!mem)
+		return;
+
+	free(mem->pointer);
+	free(mem);
+}
+
+void cedrus_mem_flush_cache(cedrus_mem_t *mem)
+{
+}
+
+void *cedrus_mem_get_pointer(const cedrus_mem_t *mem)
+{
+	return mem->pointer;
+}
+
+uint32_t cedrus_mem_get_phys_addr(const cedrus_mem_t *mem)
+{
+	return mem->phys;
+}
+
+uint32_t cedrus_mem_get_bus_addr(const cedrus_mem_t *mem)
+{
+	return mem->phys - STUB_PHYS_BASE;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <cedrus/cedrus.h>
+#include "helpers.h"
+
+device_ctx_t *test_device_create(const char *ve_version, VdpDevice *device)
+{
+	if (ve_version)
+		setenv("CEDRUS_STUB_VERSION", ve_version, 1);
+
+	device_ctx_t *dev = handle_create(HANDLE_TYPE_DEVICE, sizeof(*dev), device);
+	if (!dev)
+		return NULL;
+
+	dev->cedrus = cedrus_open();
+	if (!dev->cedrus || arena_create(dev) != VDP_STATUS_OK ||
+	    surface_pool_create(dev) != VDP_STATUS_OK || yuv_pool_create(dev) != VDP_STATUS_OK)
+		abort();
+
+	return dev;
+}
+
+void test_device_destroy(VdpDevice device)
+{
+	device_ctx_t *dev = handle_get(device);
+
+	decode_queue_destroy(dev);
+	readback_pool_destroy(dev);
+	surface_pool_destroy(dev);
+	yuv_pool_destroy(dev);
+	arena_destroy(dev);
+	cedrus_close(dev->cedrus);
+	handle_destroy(device);
+}
+
+typedef struct
+{
+	uint8_t data[16];
+	unsigned int bits;
+} writer_t;
+
+static void put_u(writer_t *w, uint32_t val, int num)
+{
+	while (num--)
+	{
+		if ((val >> num) & 0x1)
+			w->data[w->bits / 8] |= 0x80 >> (w->bits % 8);
+		w->bits++;
+	}
+}
+
+static void put_ue(writer_t *w, uint32_t val)
+{
+	int len = 0;
+
+	while ((val + 1) >> (len + 1))
+		len++;
+
+	put_u(w, 0, len);
+	put_u(w, val + 1, len + 1);
+}
+
+unsigned int test_h264_p_slice(uint8_t *out, unsigned int frame_num)
+{
+	writer_t w = { .bits = 0 };
+
+	memset(w.data, 0, sizeof(w.data));
+	put_u(&w, 0x000001, 24);
+	put_u(&w, 0x41, 8);		// nal_ref_idc 2, non-IDR slice
+	put_ue(&w, 0);			// first_mb_in_slice
+	put_ue(&w, 5);			// slice_type P
+	put_ue(&w, 0);			// pic_parameter_set_id
+	put_u(&w, frame_num, 4);
+	put_u(&w, 0, 1);		// num_ref_idx_active_override_flag
+	put_u(&w, 0, 1);		// ref_pic_list_modification_flag_l0
+	put_u(&w, 0, 1);		// adaptive_ref_pic_marking_mode_flag
+	put_ue(&w, 0);			// slice_qp_delta
+	put_u(&w, 1, 1);		// rbsp_stop_one_bit
+	put_u(&w, 0x5555, 16);		// some macroblock data
+
+	memcpy(out, w.data, (w.bits + 7) / 8);
+	return (w.bits + 7) / 8;
+}
+
+void test_h264_info(VdpPictureInfoH264 *info, unsigned int num_ref_frames)
+{
+	int i;
+
+	memset(info, 0, sizeof(*info));
+	memset(info->scaling_lists_4x4, 16, sizeof(info->scaling_lists_4x4));
+	memset(info->scaling_lists_8x8, 16, sizeof(info->scaling_lists_8x8));
+	info->slice_count = 1;
+	info->is_reference = VDP_TRUE;
+	info->num_ref_frames = num_ref_frames;
+	info->frame_mbs_only_flag = 1;
+	info->pic_order_cnt_type = 2;
+	info->direct_8x8_inference_flag = 1;
+
+	for (i = 0; i < 16; i++)
+		info->referenceFrames[i].surface = VDP_INVALID_HANDLE;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __TESTS_HELPERS_H__
+#define __TESTS_HELPERS_H__
+
+#include <time.h>
+#include "vdpau_private.h"
+
+/*
+ * A device as vdp_imp_device_create() sets it up, on the libcedrus
+ * stand-in: arena, surface and yuv pools, but no decode queue or
+ * readback threads. ve_version overrides CEDRUS_STUB_VERSION if not NULL.
+ */
+device_ctx_t *test_device_create(const char *ve_version, VdpDevice *device);
+void test_device_destroy(VdpDevice device);
+
+/*
+ * A reference P slice with the given frame number for pictures set up by
+ * test_h264_info(), followed by some macroblock data. Returns its size,
+ * out needs 16 bytes.
+ */
+unsigned int test_h264_p_slice(uint8_t *out, unsigned int frame_num);
+void test_h264_info(VdpPictureInfoH264 *info, unsigned int num_ref_frames);
+
+static inline double test_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Counts heap allocations made by the driver code in the steady state
+ * of a playback loop: decoding into surfaces that are still being shown,
+ * and put and get bits in packed formats. All of it must run without a
+ * single malloc(), calloc() or realloc() once warmed up.
+ *
+ * The driver objects are linked with --wrap, so only their calls are
+ * counted, not those inside libc or libpthread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+#include "helpers.h"
+
+#define WIDTH	320
+#define HEIGHT	240
+#define WARMUP	8
+#define FRAMES	100
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static unsigned int allocs;
+
+void *__wrap_malloc(size_t size)
+{
+	__atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	__atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	__atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+	return __real_realloc(ptr, size);
+}
+
+static uint8_t bitstream[4096];
+static uint8_t packed[WIDTH * HEIGHT * 4];
+
+static int run(const char *version)
+{
+	VdpDevice device;
+	VdpDecoder decoder;
+	VdpVideoSurface surfaces[3];
+	yuv_data_t *shown = NULL;
+	unsigned int frame, counted = 0;
+	int i;
+
+	device_ctx_t *dev = test_device_create(version, &device);
+	decode_queue_create(dev);
+
+	if (vdp_decoder_create(device, VDP_DECODER_PROFILE_MPEG2_MAIN, WIDTH, HEIGHT, 2, &decoder) != VDP_STATUS_OK)
+		return 1;
+
+	for (i = 0; i < 3; i++)
+		if (vdp_video_surface_create(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, &surfaces[i]) != VDP_STATUS_OK)
+			return 1;
+
+	// a picture start code and a slice, the rest is filler
+	memset(bitstream, 0x55, sizeof(bitstream));
+	memcpy(bitstream, "\x00\x00\x01\x00", 4);
+	memcpy(bitstream + 16, "\x00\x00\x01\x01", 4);
+
+	for (frame = 0; frame < WARMUP + FRAMES; frame++)
+	{
+		if (frame == WARMUP)
+			counted = __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+
+		VdpVideoSurface target = surfaces[frame % 2];
+		VdpPictureInfoMPEG1Or2 info = { .forward_reference = VDP_INVALID_HANDLE, .backward_reference = VDP_INVALID_HANDLE };
+		if (frame)
+			info.forward_reference = surfaces[(frame + 1) % 2];
+		VdpBitstreamBuffer buffer = { .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = bitstream, .bitstream_bytes = sizeof(bitstream) };
+
+		if (vdp_decoder_render(decoder, target, (VdpPictureInfo const *)&info, 1, &buffer) != VDP_STATUS_OK)
+			return 1;
+
+		// the presentation queue shows the picture until the next one comes
+		video_surface_ctx_t *vs = handle_get(target);
+		decode_queue_wait(dev, vs->fence);
+		if (shown)
+			yuv_unref(shown);
+		shown = yuv_ref(vs->yuv);
+
+		void const *src[1] = { packed };
+		void *dst[1] = { packed };
+		uint32_t pitches[1] = { WIDTH * 4 };
+
+		if (vdp_video_surface_put_bits_y_cb_cr(surfaces[2], VDP_YCBCR_FORMAT_Y8U8V8A8, src, pitches) != VDP_STATUS_OK ||
+		    vdp_video_surface_get_bits_y_cb_cr(surfaces[2], VDP_YCBCR_FORMAT_V8U8Y8A8, dst, pitches) != VDP_STATUS_OK)
+			return 1;
+	}
+
+	counted = __atomic_load_n(&allocs, __ATOMIC_RELAXED) - counted;
+
+	yuv_unref(shown);
+	for (i = 0; i < 3; i++)
+		vdp_video_surface_destroy(surfaces[i]);
+	vdp_decoder_destroy(decoder);
+	test_device_destroy(device);
+
+	printf("allocations on VE %s: %u in %d frames\n", version, counted, FRAMES);
+
+	return counted != 0;
+}
+
+int main(void)
+{
+	int fails = run("0x1680") + run("0x1610");
+
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * What the arena reserves for typical buffer sizes: frame buffers must
+ * not be rounded up by much, and a small buffer must not make the arena
+ * reserve (and flush) a large chunk.
+ */
+
+#include <stdio.h>
+#include "vdpau_private.h"
+#include "helpers.h"
+
+#define KIB	1024
+
+static const struct
+{
+	const char *what;
+	size_t size;
+	size_t max_slot;
+	size_t max_reserved;
+} cases[] = {
+	{ "cursor", 64 * 64 * 4, 16 * KIB, 256 * KIB },
+	{ "small OSD", 256 * 64 * 4, 64 * KIB, 256 * KIB },
+	{ "320x240 4:2:0", 320 * 240 * 3 / 2, 128 * KIB, 512 * KIB },
+	{ "720x576 4:2:0", 720 * 576 * 3 / 2, 640 * KIB, 640 * KIB },
+	{ "1920x1088 4:2:0", 1920 * 1088 * 3 / 2, 3072 * KIB, 3072 * KIB },
+	{ "1920x1080 RGBA", 1920 * 1080 * 4, 8128 * KIB, 8128 * KIB },
+};
+
+static int fails;
+
+int main(void)
+{
+	VdpDevice device;
+	unsigned int i;
+
+	device_ctx_t *dev = test_device_create(NULL, &device);
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		arena_stats_t before, after;
+		arena_get_stats(dev, &before);
+
+		arena_mem_t *m = arena_alloc(dev, cases[i].size);
+		if (!m)
+			return 1;
+
+		arena_get_stats(dev, &after);
+		size_t slot = after.in_use - before.in_use;
+		size_t reserved = after.reserved - before.reserved;
+
+		if (slot > cases[i].max_slot || reserved > cases[i].max_reserved)
+		{
+			printf("%s: %zu bytes get a %zu byte buffer, %zu bytes reserved\n",
+			       cases[i].what, cases[i].size, slot, reserved);
+			fails++;
+		}
+
+		arena_free(m);
+	}
+
+	test_device_destroy(device);
+
+	printf("arena: %u sizes, %d failures\n", i, fails);
+
+	return fails != 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Writes random u(n), ue(v) and se(v) syntax elements, escapes them like
+ * an encoder does and checks that the bit reader gets them back, with
+ * rbsp_bits and the raw offset agreeing with the escaping.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitstream.h"
+
+#define ELEMENTS	2000
+
+typedef struct
+{
+	uint8_t data[64 * 1024];
+	unsigned int bits;
+} writer_t;
+
+static void put_u(writer_t *w, uint32_t val, int num)
+{
+	while (num--)
+	{
+		if ((val >> num) & 0x1)
+			w->data[w->bits / 8] |= 0x80 >> (w->bits % 8);
+		w->bits++;
+	}
+}
+
+static void put_ue(writer_t *w, uint32_t val)
+{
+	int len = 0;
+
+	while (((uint64_t)val + 1) >> (len + 1))
+		len++;
+
+	put_u(w, 0, len);
+	put_u(w, val + 1, len + 1);
+}
+
+static void put_se(writer_t *w, int32_t val)
+{
+	put_ue(w, val > 0 ? 2 * (uint32_t)val - 1 : -2 * (int64_t)val);
+}
+
+// insert emulation prevention bytes, remembering where each rbsp byte ended up
+static unsigned int escape(const uint8_t *rbsp, unsigned int len, uint8_t *out, unsigned int *map)
+{
+	unsigned int i, n = 0, zeros = 0;
+
+	for (i = 0; i < len; i++)
+	{
+		if (zeros >= 2 && rbsp[i] <= 0x03)
+		{
+			out[n++] = 0x03;
+			zeros = 0;
+		}
+
+		map[i] = n;
+		out[n++] = rbsp[i];
+		zeros = rbsp[i] == 0x00 ? zeros + 1 : 0;
+	}
+
+	return n;
+}
+
+int main(void)
+{
+	static writer_t w;
+	static uint8_t escaped[2 * sizeof(w.data)];
+	static unsigned int map[sizeof(w.data)];
+	static struct { int type, num; uint32_t val; } elements[ELEMENTS];
+	unsigned int escapes = 0;
+	int round, i, fails = 0;
+
+	srand(1);
+
+	for (round = 0; round < 50; round++)
+	{
+		memset(&w, 0, sizeof(w));
+
+		for (i = 0; i < ELEMENTS; i++)
+		{
+			elements[i].type = rand() % 3;
+
+			// plenty of zeros, so there is something to escape
+			uint32_t val = rand() % 4 ? rand() % 4 : (uint32_t)rand() << 1 ^ rand();
+			switch (elements[i].type)
+			{
+			case 0:
+				elements[i].num = 1 + rand() % 32;
+				elements[i].val = elements[i].num < 32 ? val & ((1u << elements[i].num) - 1) : val;
+				put_u(&w, elements[i].val, elements[i].num);
+				break;
+			case 1:
+				elements[i].val = val == UINT32_MAX ? 0 : val;
+				put_ue(&w, elements[i].val);
+				break;
+			case 2:
+				elements[i].val = (int32_t)(val >> 1) * (rand() % 2 ? 1 : -1);
+				put_se(&w, (int32_t)elements[i].val);
+				break;
+			}
+		}
+
+		unsigned int rbsp_len = (w.bits + 7) / 8;
+		unsigned int len = escape(w.data, rbsp_len, escaped + 1, map);
+		escapes += len - rbsp_len;
+
+		// a NAL header byte in front, so pos is tested as well
+		escaped[0] = 0x65;
+		bitstream_t bs;
+		bitstream_init(&bs, escaped, len + 1, 1);
+
+		for (i = 0; i < ELEMENTS; i++)
+		{
+			uint32_t val;
+			switch (elements[i].type)
+			{
+			case 0:
+				val = get_u(&bs, elements[i].num);
+				break;
+			case 1:
+				val = get_ue(&bs);
+				break;
+			default:
+				val = get_se(&bs);
+				break;
+			}
+
+			if (val != elements[i].val)
+			{
+				fprintf(stderr, "round %d element %d: read %u, wrote %u\n", round, i, val, elements[i].val);
+				fails++;
+				break;
+			}
+		}
+
+		if (bs.rbsp_bits != w.bits)
+			fails++;
+
+		// whenever the reader says it's safe, the raw offset must point at the same bit
+		unsigned int offset = bitstream_raw_offset(&bs);
+		if (offset && w.bits % 8 == 0 && w.bits / 8 < rbsp_len)
+			fails += offset != (1 + map[w.bits / 8]) * 8;
+		if (offset && w.bits % 8 != 0)
+			fails += offset != (1 + map[w.bits / 8]) * 8 + w.bits % 8;
+	}
+
+	printf("bitstream: 50 x %d syntax elements, %u escapes, %d failures\n", ELEMENTS, escapes, fails);
+
+	return fails || !escapes ? 1 : 0;
+}
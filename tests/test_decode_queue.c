@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * A surface read as reference by a queued decode must not be handed
+ * back for writing before that decode is done.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "vdpau_private.h"
+
+static int reading;
+
+static VdpStatus slow_decode(decoder_ctx_t *decoder, VdpPictureInfo const *info, const int len, video_surface_ctx_t *output)
+{
+	struct timespec ts = { 0, 20 * 1000 * 1000 };
+
+	__atomic_store_n(&reading, 1, __ATOMIC_RELEASE);
+	nanosleep(&ts, NULL);
+	__atomic_store_n(&reading, 0, __ATOMIC_RELEASE);
+
+	return VDP_STATUS_OK;
+}
+
+int main(void)
+{
+	device_ctx_t device = { .decode_queue = NULL };
+	decoder_ctx_t decoder = { .device = &device, .profile = VDP_DECODER_PROFILE_MPEG2_MAIN, .decode = slow_decode };
+	vbv_t vbv = { .fence = 0 };
+	VdpVideoSurface ref_handle, out_handle;
+	int fails = 0, i;
+
+	if (decode_queue_create(&device) != VDP_STATUS_OK)
+		return 1;
+
+	video_surface_ctx_t *ref = handle_create(HANDLE_TYPE_VIDEO_SURFACE, sizeof(*ref), &ref_handle);
+	video_surface_ctx_t *out = handle_create(HANDLE_TYPE_VIDEO_SURFACE, sizeof(*out), &out_handle);
+
+	for (i = 0; i < 10; i++)
+	{
+		VdpPictureInfoMPEG1Or2 info = { .forward_reference = ref_handle, .backward_reference = VDP_INVALID_HANDLE };
+
+		decode_queue_submit(&decoder, &vbv, (VdpPictureInfo const *)&info, 0, out);
+
+		// what vdp_decoder_render() and put_bits wait for before touching ref
+		decode_queue_wait(&device, max(ref->fence, ref->ref_fence));
+		if (__atomic_load_n(&reading, __ATOMIC_ACQUIRE) || ref->ref_fence != out->fence)
+			fails++;
+	}
+
+	decode_queue_destroy(&device);
+	handle_destroy(out_handle);
+	handle_destroy(ref_handle);
+
+	printf("decode queue: %d reference waits, %d too early\n", i, fails);
+
+	return fails ? 1 : 0;
+}
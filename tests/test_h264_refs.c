@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The H.264 decoder keeps its reference frames from picture to picture, so
+ * only changed framebuffer list entries get written. Surfaces it kept may
+ * be destroyed or get decoded by another decoder in between though.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+#include "helpers.h"
+
+#define WIDTH		320
+#define HEIGHT		192
+#define REFS		4
+#define SURFACES	8
+#define PICTURES	32
+
+static int fails;
+
+static void foreign_private_free(video_surface_ctx_t *surface)
+{
+	free(surface->decoder_private);
+}
+
+static VdpStatus render(VdpDecoder decoder, VdpVideoSurface *surfaces, unsigned int n)
+{
+	unsigned int i;
+	uint8_t slice[16];
+
+	VdpPictureInfoH264 info;
+	test_h264_info(&info, REFS);
+	info.frame_num = n % 16;
+	info.field_order_cnt[0] = info.field_order_cnt[1] = 2 * n;
+	info.num_ref_idx_l0_active_minus1 = min(n, REFS) ? min(n, REFS) - 1 : 0;
+
+	// a sliding window of the last REFS pictures
+	for (i = 0; i < min(n, REFS); i++)
+	{
+		VdpReferenceFrameH264 *rf = &info.referenceFrames[i];
+		unsigned int p = n - 1 - i;
+		rf->surface = surfaces[p % SURFACES];
+		rf->top_is_reference = rf->bottom_is_reference = VDP_TRUE;
+		rf->field_order_cnt[0] = rf->field_order_cnt[1] = 2 * p;
+		rf->frame_idx = p % 16;
+	}
+
+	VdpBitstreamBuffer buffer = { .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = slice,
+	                              .bitstream_bytes = test_h264_p_slice(slice, n % 16) };
+
+	return vdp_decoder_render(decoder, surfaces[n % SURFACES], (VdpPictureInfo const *)&info, 1, &buffer);
+}
+
+int main(void)
+{
+	VdpDevice device;
+	VdpDecoder decoder;
+	VdpVideoSurface surfaces[SURFACES];
+	unsigned int n;
+
+	test_device_create("0x1680", &device);
+
+	if (vdp_decoder_create(device, VDP_DECODER_PROFILE_H264_HIGH, WIDTH, HEIGHT, REFS, &decoder) != VDP_STATUS_OK)
+		return 1;
+	decoder_ctx_t *dec = handle_get(decoder);
+
+	for (n = 0; n < SURFACES; n++)
+		if (vdp_video_surface_create(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, &surfaces[n]) != VDP_STATUS_OK)
+			return 1;
+
+	// once the window is full, each picture changes the entries of the
+	// output and of the dropped reference only, the other 16 stay
+	for (n = 0; n < PICTURES; n++)
+	{
+		if (render(decoder, surfaces, n) != VDP_STATUS_OK)
+			return 1;
+
+		if (n >= SURFACES && dec->shadow.suppressed < 16 * 8)
+		{
+			printf("picture %u: only %u writes left out\n", n, dec->shadow.suppressed);
+			fails++;
+		}
+	}
+
+	// another decoder replaces the private data of a reference frame
+	video_surface_ctx_t *vs = handle_get(surfaces[(n - 1) % SURFACES]);
+	vs->decoder_private_free(vs);
+	vs->decoder_private = calloc(1, 8);
+	vs->decoder_private_free = foreign_private_free;
+
+	if (render(decoder, surfaces, n) != VDP_STATUS_OK)
+	{
+		printf("picture %u: failed after a reference changed decoder\n", n);
+		fails++;
+	}
+	if (vs->decoder_private_free == foreign_private_free)
+	{
+		printf("picture %u: foreign private data taken as H.264 one\n", n);
+		fails++;
+	}
+	n++;
+
+	// a destroyed reference frame can not be decoded from
+	unsigned int gone = (n - 2) % SURFACES;
+	vdp_video_surface_destroy(surfaces[gone]);
+
+	if (render(decoder, surfaces, n) == VDP_STATUS_OK)
+	{
+		printf("picture %u: decoded from a destroyed reference\n", n);
+		fails++;
+	}
+
+	vdp_decoder_destroy(decoder);
+	for (n = 0; n < SURFACES; n++)
+		if (n != gone)
+			vdp_video_surface_destroy(surfaces[n]);
+	test_device_destroy(device);
+
+	printf("h264 refs: %d failures\n", fails);
+
+	return fails != 0;
+}
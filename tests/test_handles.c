@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Lookups racing with creation, destruction and table growth. A live
+ * handle must always give its own object, a destroyed one never any.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include "vdpau_private.h"
+
+#define LIVE		64
+#define ROUNDS		200
+#define GROW		600
+
+typedef struct
+{
+	VdpHandle self;
+} object_t;
+
+static VdpHandle live[LIVE];
+static VdpHandle stale[LIVE];
+static int done;
+
+static void *lookup_thread(void *arg)
+{
+	uintptr_t errors = 0;
+	int i;
+
+	while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE))
+	{
+		for (i = 0; i < LIVE; i++)
+		{
+			object_t *o = handle_get(live[i]);
+			if (!o || o->self != live[i])
+				errors++;
+
+			VdpHandle h = __atomic_load_n(&stale[i], __ATOMIC_ACQUIRE);
+			if (h != VDP_INVALID_HANDLE && handle_get(h))
+				errors++;
+		}
+	}
+
+	return (void *)errors;
+}
+
+int main(void)
+{
+	VdpHandle grown[GROW];
+	pthread_t threads[2];
+	void *ret;
+	int i, j, errors = 0;
+
+	for (i = 0; i < LIVE; i++)
+	{
+		object_t *o = handle_create(HANDLE_TYPE_OUTPUT_SURFACE, sizeof(*o), &live[i]);
+		o->self = live[i];
+		stale[i] = VDP_INVALID_HANDLE;
+	}
+
+	for (i = 0; i < 2; i++)
+		pthread_create(&threads[i], NULL, lookup_thread, NULL);
+
+	for (i = 0; i < ROUNDS; i++)
+	{
+		// grow the table past a few chunks, then give it all back
+		for (j = 0; j < GROW; j++)
+		{
+			object_t *o = handle_create(HANDLE_TYPE_BITMAP_SURFACE, sizeof(*o), &grown[j]);
+			if (!o)
+				errors++;
+			else
+				o->self = grown[j];
+		}
+
+		for (j = 0; j < GROW; j++)
+		{
+			handle_destroy(grown[j]);
+			if (j < LIVE)
+				__atomic_store_n(&stale[j], grown[j], __ATOMIC_RELEASE);
+		}
+	}
+
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < 2; i++)
+	{
+		pthread_join(threads[i], &ret);
+		errors += (uintptr_t)ret;
+	}
+
+	for (i = 0; i < LIVE; i++)
+		handle_destroy(live[i]);
+
+	printf("handles: %d rounds of %d creates, %d errors\n", ROUNDS, GROW, errors);
+
+	return errors ? 1 : 0;
+}
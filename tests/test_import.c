@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * dma-buf import: parameter checks, the pagemap lookup of the physical
+ * address, and what an imported surface holds when read back and
+ * exported. memfds stand in for dma-bufs.
+ *
+ * arena.c is linked with --wrap=pread, so the test decides what the
+ * pagemap reports: contiguous frames, scattered frames, or the zeroed
+ * frame numbers an unprivileged process gets on recent kernels.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "vdpau_private.h"
+#include "vdpau_sunxi.h"
+#include "helpers.h"
+
+#define WIDTH		100
+#define HEIGHT		50
+#define PITCH		128
+#define FIRST_PFN	0x48000
+
+enum { PAGEMAP_CONTIGUOUS, PAGEMAP_SCATTERED, PAGEMAP_HIDDEN } pagemap = PAGEMAP_CONTIGUOUS;
+
+ssize_t __real_pread(int fd, void *buf, size_t count, off_t offset);
+
+ssize_t __wrap_pread(int fd, void *buf, size_t count, off_t offset)
+{
+	static uint64_t first_page, next_page;
+	uint64_t page = offset / sizeof(uint64_t), entry = 1ULL << 63;
+
+	if (count != sizeof(entry))
+		return __real_pread(fd, buf, count, offset);
+
+	// a lookup reads the pages of a mapping one after the other
+	if (page != next_page)
+		first_page = page;
+	next_page = page + 1;
+
+	switch (pagemap)
+	{
+	case PAGEMAP_CONTIGUOUS:
+		entry |= FIRST_PFN + page - first_page;
+		break;
+	case PAGEMAP_SCATTERED:
+		entry |= FIRST_PFN + 2 * (page - first_page);
+		break;
+	case PAGEMAP_HIDDEN:
+		break;
+	}
+
+	memcpy(buf, &entry, sizeof(entry));
+	return sizeof(entry);
+}
+
+static int open_fds(void)
+{
+	DIR *dir = opendir("/proc/self/fd");
+	int count = 0;
+
+	while (readdir(dir))
+		count++;
+
+	closedir(dir);
+	return count;
+}
+
+static int buffer(size_t size, uint8_t **map)
+{
+	size_t i;
+	int fd = memfd_create("import", 0);
+
+	if (fd == -1 || ftruncate(fd, size) == -1)
+		return -1;
+
+	*map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	for (i = 0; i < size; i++)
+		(*map)[i] = i * 7;
+
+	return fd;
+}
+
+int main(void)
+{
+	VdpDevice device;
+	VdpVideoSurface surface;
+	long page_size = sysconf(_SC_PAGESIZE);
+	uint32_t offsets[3] = { 256, 256 + PITCH * HEIGHT, 256 + PITCH * HEIGHT + PITCH / 2 * (HEIGHT / 2) };
+	uint32_t pitches[3] = { PITCH, PITCH / 2, PITCH / 2 };
+	size_t size = offsets[2] + PITCH / 2 * (HEIGHT / 2);
+	uint8_t *m, y[WIDTH * HEIGHT], u[WIDTH / 2 * HEIGHT / 2], v[WIDTH / 2 * HEIGHT / 2];
+	int fails = 0, fds;
+	unsigned int i, j;
+
+	test_device_create(NULL, &device);
+
+	int fd = buffer(size, &m);
+	fds = open_fds();
+
+	// parameters
+	fails += vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_SUNXI_I420,
+	                                                fd, offsets, pitches, NULL) != VDP_STATUS_INVALID_POINTER;
+	fails += vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_420, 0, HEIGHT, VDP_YCBCR_FORMAT_SUNXI_I420,
+	                                                fd, offsets, pitches, &surface) != VDP_STATUS_INVALID_SIZE;
+	fails += vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_422, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_SUNXI_I420,
+	                                                fd, offsets, pitches, &surface) != VDP_STATUS_INVALID_CHROMA_TYPE;
+	fails += vdp_video_surface_import_dma_buf_sunxi(VDP_INVALID_HANDLE, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_SUNXI_I420,
+	                                                fd, offsets, pitches, &surface) != VDP_STATUS_INVALID_HANDLE;
+	fails += vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_YUYV,
+	                                                fd, offsets, pitches, &surface) != VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	pitches[0] = WIDTH;
+	fails += vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_SUNXI_I420,
+	                                                fd, offsets, pitches, &surface) != VDP_STATUS_ERROR;
+	pitches[0] = PITCH;
+
+	// planes reaching past the end of the buffer
+	offsets[2] += page_size;
+	fails += vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_SUNXI_I420,
+	                                                fd, offsets, pitches, &surface) != VDP_STATUS_RESOURCES;
+	offsets[2] -= page_size;
+
+	// no usable physical address
+	pagemap = PAGEMAP_HIDDEN;
+	fails += vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_SUNXI_I420,
+	                                                fd, offsets, pitches, &surface) != VDP_STATUS_ERROR;
+	pagemap = PAGEMAP_SCATTERED;
+	fails += vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_SUNXI_I420,
+	                                                fd, offsets, pitches, &surface) != VDP_STATUS_ERROR;
+	pagemap = PAGEMAP_CONTIGUOUS;
+
+	// failed imports keep no copy of the fd
+	fails += open_fds() != fds;
+
+	// a good I420 import, the caller may close its fd right away
+	if (vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_SUNXI_I420,
+	                                           fd, offsets, pitches, &surface) != VDP_STATUS_OK)
+	{
+		printf("import failed\n");
+		return 1;
+	}
+	close(fd);
+
+	void *dst[3] = { y, u, v };
+	uint32_t dst_pitches[3] = { WIDTH, WIDTH / 2, WIDTH / 2 };
+	fails += vdp_video_surface_get_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_SUNXI_I420, dst, dst_pitches) != VDP_STATUS_OK;
+	for (j = 0; j < HEIGHT; j++)
+		fails += memcmp(y + j * WIDTH, m + offsets[0] + j * PITCH, WIDTH) != 0;
+	for (j = 0; j < HEIGHT / 2; j++)
+	{
+		fails += memcmp(u + j * WIDTH / 2, m + offsets[1] + j * PITCH / 2, WIDTH / 2) != 0;
+		fails += memcmp(v + j * WIDTH / 2, m + offsets[2] + j * PITCH / 2, WIDTH / 2) != 0;
+	}
+
+	void const *src[3] = { y, u, v };
+	fails += vdp_video_surface_put_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_SUNXI_I420, src, dst_pitches) == VDP_STATUS_OK;
+
+	VdpSunxiSurfaceDescriptor desc;
+	VdpSunxiExport export;
+	fails += vdp_video_surface_export_sunxi(surface, &desc, &export) != VDP_STATUS_OK;
+	vdp_video_surface_destroy(surface);
+
+	// the export keeps the buffer alive after the surface is gone
+	fails += desc.fd < 0 || desc.layout != VDP_SUNXI_LAYOUT_PLANAR;
+	fails += desc.phys_addr != FIRST_PFN * page_size;
+	for (i = 0; i < 3; i++)
+		fails += desc.offsets[i] != offsets[i] || desc.pitches[i] != pitches[i];
+	fails += memcmp(desc.pointer, m, size) != 0;
+	close(desc.fd);
+	fails += vdp_video_surface_export_release_sunxi(export) != VDP_STATUS_OK;
+	fails += vdp_video_surface_export_release_sunxi(export) != VDP_STATUS_INVALID_HANDLE;
+
+	// NV12 with the chroma plane right after the luma plane
+	munmap(m, size);
+	size = PITCH * HEIGHT * 3 / 2;
+	fd = buffer(size, &m);
+	uint32_t nv12_offsets[3] = { 0, PITCH * HEIGHT, 0 };
+	uint32_t nv12_pitches[3] = { PITCH, PITCH, 0 };
+	fails += vdp_video_surface_import_dma_buf_sunxi(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, VDP_YCBCR_FORMAT_NV12,
+	                                                fd, nv12_offsets, nv12_pitches, &surface) != VDP_STATUS_OK;
+	close(fd);
+
+	uint8_t uv[WIDTH * HEIGHT / 2];
+	void *nv12_dst[3] = { y, uv, NULL };
+	uint32_t nv12_dst_pitches[3] = { WIDTH, WIDTH, 0 };
+	fails += vdp_video_surface_get_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_NV12, nv12_dst, nv12_dst_pitches) != VDP_STATUS_OK;
+	for (j = 0; j < HEIGHT; j++)
+		fails += memcmp(y + j * WIDTH, m + j * PITCH, WIDTH) != 0;
+	for (j = 0; j < HEIGHT / 2; j++)
+		fails += memcmp(uv + j * WIDTH, m + PITCH * HEIGHT + j * PITCH, WIDTH) != 0;
+	vdp_video_surface_destroy(surface);
+	munmap(m, size);
+
+	// only the first buffer's fd was open at the start
+	fails += open_fds() != fds - 1;
+
+	test_device_destroy(device);
+
+	printf("dma-buf import: %d failures\n", fails);
+
+	return fails != 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * put_bits must leave a surface as it was when it refuses the data, and
+ * what it takes has to come back unchanged from get_bits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+#include "helpers.h"
+
+#define WIDTH	200
+#define HEIGHT	120
+
+static uint8_t y[WIDTH * HEIGHT], u[WIDTH / 2 * HEIGHT / 2], v[WIDTH / 2 * HEIGHT / 2];
+static uint8_t oy[WIDTH * HEIGHT], ou[WIDTH / 2 * HEIGHT / 2], ov[WIDTH / 2 * HEIGHT / 2];
+
+static int unchanged(video_surface_ctx_t *vs, const video_surface_ctx_t *before)
+{
+	return vs->yuv == before->yuv && vs->scale_shift == before->scale_shift &&
+	       vs->rotation == before->rotation && vs->source_format == before->source_format &&
+	       vs->layout == before->layout && memcmp(vs->offsets, before->offsets, sizeof(vs->offsets)) == 0;
+}
+
+static int run(const char *version)
+{
+	VdpDevice device;
+	VdpVideoSurface surface;
+	int fails = 0;
+	unsigned int i;
+
+	// planar surfaces on new VEs, tiled ones before 0x1680
+	test_device_create(version, &device);
+
+	if (vdp_video_surface_create(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, &surface) != VDP_STATUS_OK)
+		return 1;
+
+	video_surface_ctx_t *vs = handle_get(surface);
+
+	// pretend it holds a scaled down decoded picture
+	vs->scale_shift = 1;
+	yuv_prepare(vs, 1, 0);
+	video_surface_set_decoded_layout(vs);
+	video_surface_ctx_t before = *vs;
+
+	void const *src[3] = { y, u, v };
+	uint32_t pitches[3] = { WIDTH, WIDTH / 2, WIDTH / 2 };
+
+	fails += vdp_video_surface_put_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_YUYV, src, pitches) != VDP_STATUS_INVALID_CHROMA_TYPE;
+	fails += !unchanged(vs, &before);
+	fails += vdp_video_surface_put_bits_y_cb_cr(surface, 0x7fff, src, pitches) != VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	fails += !unchanged(vs, &before);
+	fails += vdp_video_surface_put_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_YV12, NULL, pitches) != VDP_STATUS_INVALID_POINTER;
+	fails += !unchanged(vs, &before);
+
+	for (i = 0; i < sizeof(y); i++)
+		y[i] = i * 7;
+	for (i = 0; i < sizeof(u); i++)
+	{
+		u[i] = i * 3;
+		v[i] = i * 5 + 1;
+	}
+
+	void *dst[3] = { oy, ou, ov };
+	fails += vdp_video_surface_put_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_SUNXI_I420, src, pitches) != VDP_STATUS_OK;
+	fails += vs->scale_shift != 0;
+	fails += vdp_video_surface_get_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_SUNXI_I420, dst, pitches) != VDP_STATUS_OK;
+	fails += memcmp(y, oy, sizeof(y)) || memcmp(u, ou, sizeof(u)) || memcmp(v, ov, sizeof(v));
+
+	vdp_video_surface_destroy(surface);
+	test_device_destroy(device);
+
+	printf("put bits on VE %s: %d failures\n", version, fails);
+
+	return fails;
+}
+
+int main(void)
+{
+	int fails = run("0x1680") + run("0x1610");
+
+	return fails ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Checks the banded readback of tiled and linear planes against the
+ * reference conversion, with several threads reading back at the same
+ * time through one pool.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+#include "tiled_yuv.h"
+
+#define CALLERS		3
+#define ITERATIONS	40
+#define MODES		6
+
+static device_ctx_t device;
+
+struct picture
+{
+	unsigned int width;
+	unsigned int height;
+	uint8_t *src;
+	uint8_t *ref1, *ref2;
+	uint8_t *dst1, *dst2;
+};
+
+static void picture_init(struct picture *p, unsigned int width, unsigned int height, unsigned int seed)
+{
+	size_t tiled = ALIGN(width, 32) * ALIGN(height, 32);
+	size_t planar = width * height;
+	size_t i;
+
+	p->width = width;
+	p->height = height;
+	p->src = malloc(tiled);
+	p->ref1 = malloc(planar);
+	p->ref2 = malloc(planar);
+	p->dst1 = malloc(planar);
+	p->dst2 = malloc(planar);
+
+	srand(seed);
+	for (i = 0; i < tiled; i++)
+		p->src[i] = rand();
+}
+
+static void picture_free(struct picture *p)
+{
+	free(p->src);
+	free(p->ref1);
+	free(p->ref2);
+	free(p->dst1);
+	free(p->dst2);
+}
+
+static int check_picture(struct picture *p, int mode)
+{
+	unsigned int w = p->width, h = p->height;
+
+	memset(p->dst1, 0, w * h);
+	memset(p->dst2, 0, w * h);
+
+	switch (mode)
+	{
+	case 0:
+		tiled_to_planar_ref(p->src, p->ref1, w, w, h);
+		readback_tiled_to_planar(&device, p->src, p->dst1, w, w, h);
+		return memcmp(p->ref1, p->dst1, w * h);
+	case 1:
+		tiled_deinterleave_to_planar_ref(p->src, p->ref1, p->ref2, w / 2, w, h);
+		readback_tiled_deinterleave_to_planar(&device, p->src, p->dst1, p->dst2, w / 2, w, h);
+		return memcmp(p->ref1, p->dst1, w / 2 * h) || memcmp(p->ref2, p->dst2, w / 2 * h);
+	case 2:
+		tiled_swap_to_planar_ref(p->src, p->ref1, w, w, h);
+		readback_tiled_swap_to_planar(&device, p->src, p->dst1, w, w, h);
+		return memcmp(p->ref1, p->dst1, w * h);
+	case 3:
+		planar_interleave_ref(p->src, p->src + w / 2 * h, p->ref1, w / 2, w, w, h);
+		readback_planar_interleave(&device, p->src, p->src + w / 2 * h, p->dst1, w / 2, w, w, h);
+		return memcmp(p->ref1, p->dst1, w * h);
+	case 4:
+		planar_deinterleave_ref(p->src, p->ref1, p->ref2, w, w / 2, w, h);
+		readback_planar_deinterleave(&device, p->src, p->dst1, p->dst2, w, w / 2, w, h);
+		return memcmp(p->ref1, p->dst1, w / 2 * h) || memcmp(p->ref2, p->dst2, w / 2 * h);
+	default:
+		planar_swap_ref(p->src, p->ref1, w, w, w, h);
+		readback_planar_swap(&device, p->src, p->dst1, w, w, w, h);
+		return memcmp(p->ref1, p->dst1, w * h);
+	}
+}
+
+static const unsigned int sizes[][2] =
+{
+	{ 1920, 1080 },
+	{ 720, 576 },
+	{ 1280, 720 },
+	{ 352, 288 },
+	{ 3840, 2160 },
+};
+
+static void *caller(void *arg)
+{
+	uintptr_t id = (uintptr_t)arg;
+	int i, fails = 0;
+
+	for (i = 0; i < ITERATIONS; i++)
+	{
+		struct picture p;
+		unsigned int s = (id + i) % ARRAY_SIZE(sizes);
+
+		picture_init(&p, sizes[s][0], sizes[s][1], id * 1000 + i);
+		if (check_picture(&p, i % MODES))
+		{
+			fprintf(stderr, "caller %u: %ux%u mode %d mismatch\n",
+			        (unsigned int)id, p.width, p.height, i % MODES);
+			fails++;
+		}
+		picture_free(&p);
+	}
+
+	return (void *)(uintptr_t)fails;
+}
+
+int main(void)
+{
+	pthread_t threads[CALLERS];
+	uintptr_t i;
+	int fails = 0;
+
+	if (readback_pool_create(&device, 4) != VDP_STATUS_OK)
+	{
+		fprintf(stderr, "could not create readback pool\n");
+		return 1;
+	}
+
+	for (i = 0; i < CALLERS; i++)
+		pthread_create(&threads[i], NULL, caller, (void *)i);
+
+	for (i = 0; i < CALLERS; i++)
+	{
+		void *ret;
+		pthread_join(threads[i], &ret);
+		fails += (uintptr_t)ret;
+	}
+
+	readback_pool_destroy(&device);
+
+	printf("readback: %d callers x %d pictures, %d mismatches\n", CALLERS, ITERATIONS, fails);
+
+	return fails ? 1 : 0;
+}
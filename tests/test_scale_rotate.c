@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Scaled down and rotated display copies: buffer sizes and plane layout,
+ * the mapping of surface rectangles to the display copy, full size planar
+ * and packed readback from rec, and the SDROT setup the H.264 decoder
+ * programs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cedrus/cedrus_regs.h>
+#include "vdpau_private.h"
+#include "tiled_yuv.h"
+#include "helpers.h"
+
+#define WIDTH	320
+#define HEIGHT	192
+
+static uint8_t y[WIDTH * HEIGHT], c[WIDTH * HEIGHT / 2];
+static uint8_t oy[WIDTH * HEIGHT], ou[WIDTH / 2 * HEIGHT / 2], ov[WIDTH / 2 * HEIGHT / 2];
+static uint8_t packed[WIDTH * HEIGHT * 4];
+
+static int fails;
+
+static void check(int ok, const char *what, unsigned int scale_shift, unsigned int rotation)
+{
+	if (!ok)
+	{
+		printf("scale 1/%u, rotation %u: %s\n", 1 << scale_shift, rotation * 90, what);
+		fails++;
+	}
+}
+
+static void test(VdpDevice device, device_ctx_t *dev, unsigned int scale_shift, unsigned int rotation)
+{
+	VdpVideoSurface surface;
+	VdpDecoder decoder;
+	uint32_t width, height;
+	unsigned int i;
+	VdpRect rect;
+
+	dev->scale_shift = scale_shift;
+	dev->rotation = rotation;
+
+	vdp_video_surface_create(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, &surface);
+	video_surface_ctx_t *vs = handle_get(surface);
+	size_t full = vs->luma_size + vs->chroma_size;
+
+	if (vdp_decoder_create(device, VDP_DECODER_PROFILE_H264_MAIN, WIDTH, HEIGHT, 1, &decoder) != VDP_STATUS_OK)
+	{
+		check(0, "no decoder", scale_shift, rotation);
+		return;
+	}
+
+	uint8_t bitstream[16];
+	VdpBitstreamBuffer buffer = { .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = bitstream,
+	                              .bitstream_bytes = test_h264_p_slice(bitstream, 0) };
+	VdpPictureInfoH264 info;
+	test_h264_info(&info, 1);
+
+	check(vdp_decoder_render(decoder, surface, (VdpPictureInfo const *)&info, 1, &buffer) == VDP_STATUS_OK,
+	      "render failed", scale_shift, rotation);
+	check(vs->scale_shift == scale_shift && vs->rotation == rotation, "surface not switched", scale_shift, rotation);
+
+	// the VE writes the display copy to yuv->data and the full picture to rec
+	uint8_t *regs = cedrus_ve_get(dev->cedrus, CEDRUS_ENGINE_H264, 0);
+	check(readl(regs + VE_H264_SDROT_CTRL) == video_surface_sdrot_ctrl(vs), "wrong SDROT_CTRL", scale_shift, rotation);
+	check(!!(readl(regs + VE_H264_SDROT_CTRL) & SDROT_CTRL_SCALE_DOWN_EN) == !!scale_shift,
+	      "scale down enable wrong", scale_shift, rotation);
+	check(readl(regs + VE_H264_SDROT_LUMA) == arena_get_bus_addr(vs->yuv->data), "wrong SDROT_LUMA", scale_shift, rotation);
+	cedrus_ve_put(dev->cedrus);
+	check(vs->rec && vs->rec != vs->yuv->data, "no separate rec", scale_shift, rotation);
+
+	// display copy size and planes
+	video_surface_get_display_size(vs, &width, &height);
+	if (rotation & 1)
+		check(width == HEIGHT >> scale_shift && height == WIDTH >> scale_shift, "wrong display size", scale_shift, rotation);
+	else
+		check(width == WIDTH >> scale_shift && height == HEIGHT >> scale_shift, "wrong display size", scale_shift, rotation);
+	check(vs->pitches[0] == ALIGN(width, 32) && vs->pitches[1] == ALIGN(width / 2, 16), "wrong pitches", scale_shift, rotation);
+	check(vs->offsets[2] + vs->pitches[2] * (height / 2) <= vs->yuv->size, "planes past the buffer", scale_shift, rotation);
+	if (scale_shift)
+		check(vs->yuv->size < full, "display copy not smaller", scale_shift, rotation);
+
+	// the whole surface covers the whole display copy, the top left corner moves with the rotation
+	video_surface_get_display_rect(vs, &(VdpRect){ 0, 0, WIDTH, HEIGHT }, &rect);
+	check(rect.x0 == 0 && rect.y0 == 0 && rect.x1 == width && rect.y1 == height, "wrong full rect", scale_shift, rotation);
+
+	video_surface_get_display_rect(vs, &(VdpRect){ 0, 0, 32, 16 }, &rect);
+	uint32_t w = 32 >> scale_shift, h = 16 >> scale_shift;
+	static const char *corner = "wrong corner rect";
+	switch (rotation)
+	{
+	case 0:
+		check(rect.x0 == 0 && rect.y0 == 0 && rect.x1 == w && rect.y1 == h, corner, scale_shift, rotation);
+		break;
+	case 1:
+		check(rect.x0 == width - h && rect.y0 == 0 && rect.x1 == width && rect.y1 == w, corner, scale_shift, rotation);
+		break;
+	case 2:
+		check(rect.x0 == width - w && rect.y0 == height - h && rect.x1 == width && rect.y1 == height, corner, scale_shift, rotation);
+		break;
+	case 3:
+		check(rect.x0 == 0 && rect.y0 == height - w && rect.x1 == h && rect.y1 == height, corner, scale_shift, rotation);
+		break;
+	}
+
+	// readback gives the full size picture from rec
+	if (!scale_shift && !rotation)
+		goto out;
+
+	uint8_t *rec = arena_get_pointer(vs->rec);
+	planar_to_tiled(y, rec, WIDTH, WIDTH, HEIGHT);
+	planar_to_tiled(c, rec + vs->luma_size, WIDTH, WIDTH, HEIGHT / 2);
+
+	void *dst[3] = { oy, ou, ov };
+	uint32_t pitches[3] = { WIDTH, WIDTH / 2, WIDTH / 2 };
+	check(vdp_video_surface_get_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_SUNXI_I420, dst, pitches) == VDP_STATUS_OK,
+	      "get_bits failed", scale_shift, rotation);
+	check(memcmp(oy, y, sizeof(y)) == 0, "wrong luma read back", scale_shift, rotation);
+	for (i = 0; i < sizeof(ou); i++)
+		if (ou[i] != c[2 * i] || ov[i] != c[2 * i + 1])
+			break;
+	check(i == sizeof(ou), "wrong chroma read back", scale_shift, rotation);
+
+	// packed readback converts through the surface's own scratch buffer, twice to reuse it
+	void *packed_dst[1] = { packed };
+	uint32_t packed_pitches[1] = { WIDTH * 4 };
+	void *scratch = NULL;
+	for (i = 0; i < 2; i++)
+	{
+		check(vdp_video_surface_get_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_V8U8Y8A8, packed_dst, packed_pitches) == VDP_STATUS_OK,
+		      "packed get_bits failed", scale_shift, rotation);
+		check(vs->scratch && vs->scratch_size >= sizeof(y) * 3 / 2, "scratch buffer lost", scale_shift, rotation);
+		check(!scratch || vs->scratch == scratch, "scratch buffer reallocated", scale_shift, rotation);
+		scratch = vs->scratch;
+	}
+	check(packed[2] == y[0] && packed[1] == c[0] && packed[0] == c[1] && packed[3] == 0xff &&
+	      packed[sizeof(packed) - 2] == y[sizeof(y) - 1], "wrong packed read back", scale_shift, rotation);
+
+	// put_bits makes it an ordinary full size surface again
+	void const *src[3] = { oy, ou, ov };
+	check(vdp_video_surface_put_bits_y_cb_cr(surface, VDP_YCBCR_FORMAT_SUNXI_I420, src, pitches) == VDP_STATUS_OK,
+	      "put_bits failed", scale_shift, rotation);
+	check(vs->scale_shift == 0 && vs->rotation == 0 && vs->yuv->size == full, "put_bits kept the scale", scale_shift, rotation);
+
+out:
+	vdp_decoder_destroy(decoder);
+	vdp_video_surface_destroy(surface);
+}
+
+int main(void)
+{
+	VdpDevice device;
+	unsigned int scale_shift, rotation, i;
+
+	for (i = 0; i < sizeof(y); i++)
+		y[i] = i * 13;
+	for (i = 0; i < sizeof(c); i++)
+		c[i] = i * 5;
+
+	// scaling and rotation need VE 0x1680
+	device_ctx_t *dev = test_device_create("0x1680", &device);
+
+	for (scale_shift = 0; scale_shift <= 2; scale_shift++)
+		for (rotation = 0; rotation < 4; rotation++)
+			test(device, dev, scale_shift, rotation);
+
+	test_device_destroy(device);
+
+	printf("scale and rotate: 12 modes, %d failures\n", fails);
+
+	return fails != 0;
+}
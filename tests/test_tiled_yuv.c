@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Checks the (de)tiling functions against the portable reference and
+ * against a tile address computed here, at sizes that are no multiple of
+ * the tile size and with a pitch larger than the width. Bytes between
+ * width and pitch have to stay untouched. Tiling is also checked by
+ * detiling the result again. The linear (de)interleave and swap and the
+ * packed YUVA/VUYA to 4:2:0 conversion are checked against their
+ * references too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+#include "tiled_yuv.h"
+
+#define CANARY	0xa5
+
+static const unsigned int sizes[][2] =
+{
+	{ 32, 32 }, { 1, 1 }, { 2, 3 }, { 17, 9 }, { 31, 33 }, { 33, 31 },
+	{ 46, 70 }, { 63, 17 }, { 66, 2 }, { 100, 57 }, { 720, 576 }, { 721, 481 },
+	{ 1920, 1080 },
+};
+
+/* width has to be a multiple of 16 */
+static const unsigned int packed_widths[] = { 16, 48, 720, 1920 };
+
+static int failures;
+
+static size_t tiled_offset(unsigned int width, unsigned int x, unsigned int y)
+{
+	return (y / 32) * ALIGN(width, 32) * 32 + (x / 32) * 1024 + (y % 32) * 32 + x % 32;
+}
+
+static uint8_t *tiled_new(unsigned int width, unsigned int height)
+{
+	size_t size = ALIGN(width, 32) * ALIGN(height, 32);
+	uint8_t *buf = malloc(size);
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = rand();
+
+	return buf;
+}
+
+static uint8_t *planar_new(unsigned int pitch, unsigned int height)
+{
+	uint8_t *buf = malloc(pitch * height);
+
+	memset(buf, CANARY, pitch * height);
+
+	return buf;
+}
+
+static void compare(const char *name, unsigned int width, unsigned int height,
+                    const uint8_t *a, const uint8_t *b, size_t size)
+{
+	if (memcmp(a, b, size) != 0)
+	{
+		printf("%s %ux%u: differs from reference\n", name, width, height);
+		failures++;
+	}
+}
+
+static void check_canary(const char *name, unsigned int width, unsigned int height,
+                         const uint8_t *buf, unsigned int bytes, unsigned int pitch)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+		for (x = bytes; x < pitch; x++)
+			if (buf[y * pitch + x] != CANARY)
+			{
+				printf("%s %ux%u: wrote past the line end at %u,%u\n", name, width, height, x, y);
+				failures++;
+				return;
+			}
+}
+
+static void test_detile(unsigned int width, unsigned int height)
+{
+	unsigned int pitch = ALIGN(width, 16) + 16, x, y;
+	uint8_t *src = tiled_new(width, height);
+	uint8_t *d1 = planar_new(pitch, height), *d2 = planar_new(pitch, height);
+	uint8_t *r1 = planar_new(pitch, height), *r2 = planar_new(pitch, height);
+
+	tiled_to_planar(src, d1, pitch, width, height);
+	tiled_to_planar_ref(src, r1, pitch, width, height);
+	compare("tiled_to_planar", width, height, d1, r1, pitch * height);
+	check_canary("tiled_to_planar", width, height, d1, width, pitch);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+			if (r1[y * pitch + x] != src[tiled_offset(width, x, y)])
+			{
+				printf("tiled_to_planar_ref %ux%u: wrong byte at %u,%u\n", width, height, x, y);
+				failures++;
+				goto deinterleave;
+			}
+
+deinterleave:
+	memset(d1, CANARY, pitch * height);
+	memset(r1, CANARY, pitch * height);
+	tiled_deinterleave_to_planar(src, d1, d2, pitch, width, height);
+	tiled_deinterleave_to_planar_ref(src, r1, r2, pitch, width, height);
+	compare("tiled_deinterleave_to_planar", width, height, d1, r1, pitch * height);
+	compare("tiled_deinterleave_to_planar", width, height, d2, r2, pitch * height);
+	check_canary("tiled_deinterleave_to_planar", width, height, d1, width / 2, pitch);
+	check_canary("tiled_deinterleave_to_planar", width, height, d2, width / 2, pitch);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width / 2; x++)
+			if (r1[y * pitch + x] != src[tiled_offset(width, 2 * x, y)] ||
+			    r2[y * pitch + x] != src[tiled_offset(width, 2 * x + 1, y)])
+			{
+				printf("tiled_deinterleave_to_planar_ref %ux%u: wrong byte at %u,%u\n", width, height, x, y);
+				failures++;
+				goto swap;
+			}
+
+swap:
+	memset(d1, CANARY, pitch * height);
+	memset(r1, CANARY, pitch * height);
+	tiled_swap_to_planar(src, d1, pitch, width, height);
+	tiled_swap_to_planar_ref(src, r1, pitch, width, height);
+	compare("tiled_swap_to_planar", width, height, d1, r1, pitch * height);
+	check_canary("tiled_swap_to_planar", width, height, d1, width & ~1, pitch);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < (width & ~1); x++)
+			if (r1[y * pitch + x] != src[tiled_offset(width, x ^ 1, y)])
+			{
+				printf("tiled_swap_to_planar_ref %ux%u: wrong byte at %u,%u\n", width, height, x, y);
+				failures++;
+				goto out;
+			}
+
+out:
+	free(r2);
+	free(r1);
+	free(d2);
+	free(d1);
+	free(src);
+}
+
+static void test_tile(unsigned int width, unsigned int height)
+{
+	unsigned int pitch = ALIGN(width, 16) + 16, x, y;
+	size_t tiled = ALIGN(width, 32) * ALIGN(height, 32);
+	uint8_t *s1 = tiled_new(pitch, height), *s2 = tiled_new(pitch, height);
+	uint8_t *d = malloc(tiled), *r = malloc(tiled);
+	uint8_t *b1 = planar_new(pitch, height), *b2 = planar_new(pitch, height);
+
+	memset(d, CANARY, tiled);
+	memset(r, CANARY, tiled);
+	planar_to_tiled(s1, d, pitch, width, height);
+	planar_to_tiled_ref(s1, r, pitch, width, height);
+	compare("planar_to_tiled", width, height, d, r, tiled);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+			if (r[tiled_offset(width, x, y)] != s1[y * pitch + x])
+			{
+				printf("planar_to_tiled_ref %ux%u: wrong byte at %u,%u\n", width, height, x, y);
+				failures++;
+				goto interleave;
+			}
+
+	tiled_to_planar(d, b1, pitch, width, height);
+	for (y = 0; y < height; y++)
+		if (memcmp(b1 + y * pitch, s1 + y * pitch, width) != 0)
+		{
+			printf("planar_to_tiled %ux%u: round trip differs in line %u\n", width, height, y);
+			failures++;
+			break;
+		}
+
+interleave:
+	memset(d, CANARY, tiled);
+	memset(r, CANARY, tiled);
+	planar_interleave_to_tiled(s1, s2, d, pitch, width, height);
+	planar_interleave_to_tiled_ref(s1, s2, r, pitch, width, height);
+	compare("planar_interleave_to_tiled", width, height, d, r, tiled);
+
+	memset(b1, CANARY, pitch * height);
+	tiled_deinterleave_to_planar(d, b1, b2, pitch, width, height);
+	for (y = 0; y < height; y++)
+		if (memcmp(b1 + y * pitch, s1 + y * pitch, width / 2) != 0 ||
+		    memcmp(b2 + y * pitch, s2 + y * pitch, width / 2) != 0)
+		{
+			printf("planar_interleave_to_tiled %ux%u: round trip differs in line %u\n", width, height, y);
+			failures++;
+			break;
+		}
+
+	memset(d, CANARY, tiled);
+	memset(r, CANARY, tiled);
+	planar_swap_to_tiled(s1, d, pitch, width, height);
+	planar_swap_to_tiled_ref(s1, r, pitch, width, height);
+	compare("planar_swap_to_tiled", width, height, d, r, tiled);
+
+	memset(b1, CANARY, pitch * height);
+	tiled_swap_to_planar(d, b1, pitch, width, height);
+	for (y = 0; y < height; y++)
+		if (memcmp(b1 + y * pitch, s1 + y * pitch, width & ~1) != 0)
+		{
+			printf("planar_swap_to_tiled %ux%u: round trip differs in line %u\n", width, height, y);
+			failures++;
+			break;
+		}
+
+	free(b2);
+	free(b1);
+	free(r);
+	free(d);
+	free(s2);
+	free(s1);
+}
+
+static void test_linear(unsigned int width, unsigned int height)
+{
+	unsigned int pitch = ALIGN(width, 16) + 16, x, y;
+	uint8_t *s1 = tiled_new(pitch, height), *s2 = tiled_new(pitch, height);
+	uint8_t *d1 = planar_new(pitch, height), *d2 = planar_new(pitch, height);
+	uint8_t *r1 = planar_new(pitch, height), *r2 = planar_new(pitch, height);
+
+	planar_interleave(s1, s2, d1, pitch, pitch, width, height);
+	planar_interleave_ref(s1, s2, r1, pitch, pitch, width, height);
+	compare("planar_interleave", width, height, d1, r1, pitch * height);
+	check_canary("planar_interleave", width, height, d1, width & ~1, pitch);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width / 2; x++)
+			if (r1[y * pitch + 2 * x] != s1[y * pitch + x] || r1[y * pitch + 2 * x + 1] != s2[y * pitch + x])
+			{
+				printf("planar_interleave_ref %ux%u: wrong byte at %u,%u\n", width, height, x, y);
+				failures++;
+				goto deinterleave;
+			}
+
+deinterleave:
+	memset(d1, CANARY, pitch * height);
+	memset(r1, CANARY, pitch * height);
+	planar_deinterleave(s1, d1, d2, pitch, pitch, width, height);
+	planar_deinterleave_ref(s1, r1, r2, pitch, pitch, width, height);
+	compare("planar_deinterleave", width, height, d1, r1, pitch * height);
+	compare("planar_deinterleave", width, height, d2, r2, pitch * height);
+	check_canary("planar_deinterleave", width, height, d1, width / 2, pitch);
+	check_canary("planar_deinterleave", width, height, d2, width / 2, pitch);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width / 2; x++)
+			if (r1[y * pitch + x] != s1[y * pitch + 2 * x] || r2[y * pitch + x] != s1[y * pitch + 2 * x + 1])
+			{
+				printf("planar_deinterleave_ref %ux%u: wrong byte at %u,%u\n", width, height, x, y);
+				failures++;
+				goto swap;
+			}
+
+swap:
+	memset(d1, CANARY, pitch * height);
+	memset(r1, CANARY, pitch * height);
+	planar_swap(s1, d1, pitch, pitch, width, height);
+	planar_swap_ref(s1, r1, pitch, pitch, width, height);
+	compare("planar_swap", width, height, d1, r1, pitch * height);
+	check_canary("planar_swap", width, height, d1, width & ~1, pitch);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < (width & ~1); x++)
+			if (r1[y * pitch + x] != s1[y * pitch + (x ^ 1)])
+			{
+				printf("planar_swap_ref %ux%u: wrong byte at %u,%u\n", width, height, x, y);
+				failures++;
+				goto out;
+			}
+
+out:
+	free(r2);
+	free(r1);
+	free(d2);
+	free(d1);
+	free(s2);
+	free(s1);
+}
+
+static void test_packed_to_420(unsigned int width)
+{
+	uint8_t *src0 = tiled_new(width * 4, 1), *src1 = tiled_new(width * 4, 1);
+	uint8_t *d = malloc(width * 3), *r = malloc(width * 3);
+	unsigned int x;
+
+	memset(d, CANARY, width * 3);
+	memset(r, CANARY, width * 3);
+	yuva_to_420(src0, src1, d, d + width, d + 2 * width, d + 5 * width / 2, width);
+	yuva_to_420_ref(src0, src1, r, r + width, r + 2 * width, r + 5 * width / 2, width);
+	compare("yuva_to_420", width, 2, d, r, width * 3);
+
+	memset(d, CANARY, width * 3);
+	memset(r, CANARY, width * 3);
+	vuya_to_420(src0, src1, d, d + width, d + 2 * width, d + 5 * width / 2, width);
+	vuya_to_420_ref(src0, src1, r, r + width, r + 2 * width, r + 5 * width / 2, width);
+	compare("vuya_to_420", width, 2, d, r, width * 3);
+
+	// a flat colour has to come out unchanged
+	for (x = 0; x < width; x++)
+	{
+		memcpy(src0 + 4 * x, "\x10\x20\x30\xff", 4);
+		memcpy(src1 + 4 * x, "\x10\x20\x30\xff", 4);
+	}
+
+	yuva_to_420_ref(src0, src1, r, r + width, r + 2 * width, r + 5 * width / 2, width);
+	if (r[0] != 0x10 || r[width] != 0x10 || r[2 * width] != 0x20 || r[5 * width / 2] != 0x30)
+	{
+		printf("yuva_to_420_ref %u: wrong flat colour\n", width);
+		failures++;
+	}
+
+	vuya_to_420_ref(src0, src1, r, r + width, r + 2 * width, r + 5 * width / 2, width);
+	if (r[0] != 0x30 || r[width] != 0x30 || r[2 * width] != 0x20 || r[5 * width / 2] != 0x10)
+	{
+		printf("vuya_to_420_ref %u: wrong flat colour\n", width);
+		failures++;
+	}
+
+	free(r);
+	free(d);
+	free(src1);
+	free(src0);
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	srand(1);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+	{
+		test_detile(sizes[i][0], sizes[i][1]);
+		test_tile(sizes[i][0], sizes[i][1]);
+		test_linear(sizes[i][0], sizes[i][1]);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(packed_widths); i++)
+		test_packed_to_420(packed_widths[i]);
+
+	printf("tiled yuv: %u sizes, %d failures\n", (unsigned int)ARRAY_SIZE(sizes), failures);
+
+	return failures != 0;
+}
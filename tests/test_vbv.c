@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The start code index built while copying the bitstream has to match a
+ * plain byte by byte search, also for start codes split over bitstream
+ * buffers, and the copy has to be exact. The VBV stats have to cover all
+ * slots of the ring, not only the last one used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../decoder.c"
+#include "helpers.h"
+
+#define SIZE	(256 * 1024)
+
+static uint8_t stream[SIZE];
+
+static unsigned int naive_index(const uint8_t *data, uint32_t len, uint32_t *offsets, unsigned int max)
+{
+	unsigned int n = 0;
+	uint32_t i;
+
+	for (i = 2; i < len && n < max; i++)
+		if (data[i] == 0x01 && data[i - 1] == 0x00 && data[i - 2] == 0x00)
+			offsets[n++] = i + 1;
+
+	return n;
+}
+
+static int check_stats(void)
+{
+	VdpDevice device;
+	VdpDecoder decoder;
+	VdpVideoSurface surfaces[2];
+	unsigned int i;
+	int fails = 0;
+
+	test_device_create(NULL, &device);
+
+	if (vdp_decoder_create(device, VDP_DECODER_PROFILE_H264_HIGH, 320, 192, 1, &decoder) != VDP_STATUS_OK)
+		return 1;
+	decoder_ctx_t *dec = handle_get(decoder);
+
+	VdpPictureInfoH264 info;
+	test_h264_info(&info, 1);
+
+	// a large picture grows the first slot, the second one stays as it is
+	uint32_t lens[2] = { 600 * 1024, 0 };
+	uint8_t slice[16];
+	uint32_t high_water = 0;
+	uint8_t *padding = calloc(1, lens[0]);
+
+	for (i = 0; i < 2; i++)
+	{
+		if (vdp_video_surface_create(device, VDP_CHROMA_TYPE_420, 320, 192, &surfaces[i]) != VDP_STATUS_OK)
+			return 1;
+
+		info.frame_num = i;
+		VdpBitstreamBuffer buffers[2] =
+		{
+			{ .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = slice,
+			  .bitstream_bytes = test_h264_p_slice(slice, i) },
+			{ .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = padding,
+			  .bitstream_bytes = lens[i] },
+		};
+
+		if (vdp_decoder_render(decoder, surfaces[i], (VdpPictureInfo const *)&info, 2, buffers) != VDP_STATUS_OK)
+			return 1;
+
+		high_water = max(high_water, buffers[0].bitstream_bytes + lens[i]);
+	}
+
+	vbv_stats_t stats;
+	decoder_get_vbv_stats(dec, &stats);
+
+	if (stats.high_water != high_water || stats.largest_slot < high_water ||
+	    stats.reserved != dec->vbv_ring[0].size + dec->vbv_ring[1].size)
+	{
+		fprintf(stderr, "vbv stats: high-water %u, largest slot %u, %u reserved\n",
+		        stats.high_water, stats.largest_slot, stats.reserved);
+		fails++;
+	}
+
+	vdp_decoder_destroy(decoder);
+	for (i = 0; i < 2; i++)
+		vdp_video_surface_destroy(surfaces[i]);
+	test_device_destroy(device);
+	free(padding);
+
+	return fails;
+}
+
+int main(void)
+{
+	static uint32_t expected[SIZE / 3];
+	vbv_t vbv = { .num_startcodes = 0 };
+	cedrus_t *cedrus = cedrus_open();
+	int fails = 0, round;
+
+	vbv.data = cedrus_mem_alloc(cedrus, SIZE);
+	srand(1);
+
+	for (round = 0; round < 200; round++)
+	{
+		uint32_t i, len = 1 + rand() % SIZE;
+
+		// mostly entropy coded data, sometimes runs of zeros and start codes
+		for (i = 0; i < len; i++)
+			stream[i] = rand() % 4 ? rand() : (rand() % 3 ? 0x00 : 0x01);
+
+		unsigned int n = naive_index(stream, len, expected, ARRAY_SIZE(expected));
+
+		// the application may hand over the picture in pieces
+		uint32_t pos = 0;
+		vbv.num_startcodes = 0;
+		while (pos < len)
+		{
+			uint32_t piece = min(len - pos, 1 + (rand() % 4 ? rand() % 64 : rand() % SIZE));
+			if (!vbv_copy_and_index(&vbv, stream + pos, piece, pos))
+				return 1;
+			pos += piece;
+		}
+
+		if (vbv.num_startcodes != n || memcmp(vbv.startcodes, expected, n * sizeof(uint32_t)) != 0 ||
+		    memcmp(cedrus_mem_get_pointer(vbv.data), stream, len) != 0)
+		{
+			fprintf(stderr, "round %d: %u start codes, expected %u\n", round, vbv.num_startcodes, n);
+			fails++;
+		}
+	}
+
+	free(vbv.startcodes);
+	cedrus_mem_free(vbv.data);
+	cedrus_close(cedrus);
+
+	fails += check_stats();
+
+	printf("vbv index: 200 bitstreams, %d mismatches\n", fails);
+
+	return fails ? 1 : 0;
+}
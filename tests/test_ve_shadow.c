@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The VE shadow has to leave out unchanged writes from picture to picture,
+ * but never once another decoder used the VE in between: every decoder
+ * must find its own values in the registers after each picture.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <cedrus/cedrus_regs.h>
+#include "vdpau_private.h"
+#include "helpers.h"
+
+static const unsigned int sizes[2][2] = { { 320, 192 }, { 640, 368 } };
+
+// decoders used for each picture, a switch makes the next one write everything
+static const char order[] = "aaabaabbba";
+
+static int fails;
+
+static uint32_t frame_size(unsigned int width, unsigned int height)
+{
+	return (0x1 << 19) | (0x1 << 18) | (0x1 << 16) | ((width / 16 - 1) << 8) | (height / 16 - 1);
+}
+
+int main(void)
+{
+	VdpDevice device;
+	VdpDecoder decoders[2];
+	VdpVideoSurface surfaces[2];
+	unsigned int i, suppressed = 0;
+	char last = 0;
+	uint8_t slice[16];
+
+	device_ctx_t *dev = test_device_create("0x1680", &device);
+
+	for (i = 0; i < 2; i++)
+		if (vdp_decoder_create(device, VDP_DECODER_PROFILE_H264_HIGH, sizes[i][0], sizes[i][1], 1, &decoders[i]) != VDP_STATUS_OK ||
+		    vdp_video_surface_create(device, VDP_CHROMA_TYPE_420, sizes[i][0], sizes[i][1], &surfaces[i]) != VDP_STATUS_OK)
+			return 1;
+
+	VdpPictureInfoH264 info;
+	test_h264_info(&info, 1);
+
+	for (i = 0; i < sizeof(order) - 1; i++)
+	{
+		unsigned int d = order[i] - 'a';
+		decoder_ctx_t *dec = handle_get(decoders[d]);
+
+		info.frame_num = i % 16;
+		VdpBitstreamBuffer buffer = { .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = slice,
+		                              .bitstream_bytes = test_h264_p_slice(slice, i % 16) };
+
+		if (vdp_decoder_render(decoders[d], surfaces[d], (VdpPictureInfo const *)&info, 1, &buffer) != VDP_STATUS_OK)
+			return 1;
+
+		uint8_t *regs = cedrus_ve_get(dev->cedrus, CEDRUS_ENGINE_H264, 0);
+		if (readl(regs + VE_H264_FRAME_SIZE) != frame_size(sizes[d][0], sizes[d][1]))
+		{
+			printf("picture %u: decoder %c left another decoder's frame size\n", i, order[i]);
+			fails++;
+		}
+		cedrus_ve_put(dev->cedrus);
+
+		if (order[i] != last && dec->shadow.suppressed)
+		{
+			printf("picture %u: decoder %c left out %u writes after a switch\n", i, order[i], dec->shadow.suppressed);
+			fails++;
+		}
+		if (order[i] == last && !dec->shadow.suppressed)
+		{
+			printf("picture %u: decoder %c left out nothing\n", i, order[i]);
+			fails++;
+		}
+
+		suppressed += dec->shadow.suppressed;
+		last = order[i];
+	}
+
+	// a new decoder may get the memory of a destroyed one, but not its VE state
+	vdp_decoder_destroy(decoders[0]);
+	if (dev->ve_owner)
+	{
+		printf("destroyed decoder still owns the VE state\n");
+		fails++;
+	}
+
+	if (vdp_decoder_create(device, VDP_DECODER_PROFILE_H264_HIGH, sizes[0][0], sizes[0][1], 1, &decoders[0]) != VDP_STATUS_OK)
+		return 1;
+
+	VdpBitstreamBuffer buffer = { .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = slice,
+	                              .bitstream_bytes = test_h264_p_slice(slice, 0) };
+	info.frame_num = 0;
+	if (vdp_decoder_render(decoders[0], surfaces[0], (VdpPictureInfo const *)&info, 1, &buffer) != VDP_STATUS_OK)
+		return 1;
+	decoder_ctx_t *dec = handle_get(decoders[0]);
+	if (dec->shadow.suppressed)
+	{
+		printf("new decoder left out %u writes\n", dec->shadow.suppressed);
+		fails++;
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		vdp_video_surface_destroy(surfaces[i]);
+		vdp_decoder_destroy(decoders[i]);
+	}
+	test_device_destroy(device);
+
+	printf("ve shadow: %u writes left out, %d failures\n", suppressed, fails);
+
+	return fails != 0 || suppressed == 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * One thread decodes and mixes like an application does, preparing and
+ * filling a video surface and then taking a reference on its buffer for
+ * the display. Another one plays the presentation queue, it shows and
+ * drops these references later. A buffer must never change while it is
+ * referenced, and ThreadSanitizer (make check-tsan) must not see a race
+ * between the refilling and the display.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "vdpau_private.h"
+#include "helpers.h"
+
+#define FRAMES		20000
+#define QUEUE_SIZE	3
+
+static video_surface_ctx_t *vs;
+
+static struct
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	yuv_data_t *yuv[QUEUE_SIZE];
+	uint8_t value[QUEUE_SIZE];
+	unsigned int head, tail;
+	int done;
+} queue = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static void *decode_thread(void *arg)
+{
+	unsigned int frame;
+
+	for (frame = 1; frame <= FRAMES; frame++)
+	{
+		if (yuv_prepare(vs, 0, 0) != VDP_STATUS_OK)
+			break;
+
+		memset(arena_get_pointer(vs->yuv->data), frame & 0xff, vs->yuv->size);
+
+		// what vdp_video_mixer_render() keeps for the output surface
+		yuv_data_t *yuv = yuv_ref(__atomic_load_n(&vs->yuv, __ATOMIC_ACQUIRE));
+
+		pthread_mutex_lock(&queue.mutex);
+		while (queue.tail - queue.head == QUEUE_SIZE)
+			pthread_cond_wait(&queue.cond, &queue.mutex);
+		queue.yuv[queue.tail % QUEUE_SIZE] = yuv;
+		queue.value[queue.tail % QUEUE_SIZE] = frame & 0xff;
+		queue.tail++;
+		pthread_cond_broadcast(&queue.cond);
+		pthread_mutex_unlock(&queue.mutex);
+	}
+
+	pthread_mutex_lock(&queue.mutex);
+	queue.done = 1;
+	pthread_cond_broadcast(&queue.cond);
+	pthread_mutex_unlock(&queue.mutex);
+
+	return NULL;
+}
+
+static void *present_thread(void *arg)
+{
+	uintptr_t torn = 0;
+
+	while (1)
+	{
+		pthread_mutex_lock(&queue.mutex);
+		while (!queue.done && queue.tail == queue.head)
+			pthread_cond_wait(&queue.cond, &queue.mutex);
+		if (queue.tail == queue.head)
+		{
+			pthread_mutex_unlock(&queue.mutex);
+			break;
+		}
+		yuv_data_t *yuv = queue.yuv[queue.head % QUEUE_SIZE];
+		uint8_t value = queue.value[queue.head % QUEUE_SIZE];
+		queue.head++;
+		pthread_cond_broadcast(&queue.cond);
+		pthread_mutex_unlock(&queue.mutex);
+
+		// the display scans the buffer for a while after it was dequeued
+		const uint8_t *data = arena_get_pointer(yuv->data);
+		sched_yield();
+		if (data[0] != value || data[yuv->size - 1] != value)
+			torn++;
+
+		yuv_unref(yuv);
+	}
+
+	return (void *)torn;
+}
+
+int main(void)
+{
+	VdpDevice device;
+	VdpVideoSurface surface;
+	pthread_t decoder, presenter;
+	void *torn;
+
+	test_device_create(NULL, &device);
+
+	if (vdp_video_surface_create(device, VDP_CHROMA_TYPE_420, 64, 64, &surface) != VDP_STATUS_OK)
+		return 1;
+
+	vs = handle_get(surface);
+
+	pthread_create(&presenter, NULL, present_thread, NULL);
+	pthread_create(&decoder, NULL, decode_thread, NULL);
+	pthread_join(decoder, NULL);
+	pthread_join(presenter, &torn);
+
+	vdp_video_surface_destroy(surface);
+	test_device_destroy(device);
+
+	printf("yuv refcount: %d frames, %u torn reads\n", FRAMES, (unsigned int)(uintptr_t)torn);
+
+	return torn ? 1 : 0;
+}
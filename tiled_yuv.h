@@ -27,4 +27,75 @@ void tiled_deinterleave_to_planar(void *src, void *dst1, void *dst2,
                                   unsigned int dst_pitch,
                                   unsigned int width, unsigned int height);
 
+void tiled_swap_to_planar(void *src, void *dst, unsigned int dst_pitch,
+                          unsigned int width, unsigned int height);
+
+void planar_to_tiled(void *src, void *dst, unsigned int src_pitch,
+                     unsigned int width, unsigned int height);
+
+void planar_interleave_to_tiled(void *src1, void *src2, void *dst,
+                                unsigned int src_pitch,
+                                unsigned int width, unsigned int height);
+
+void planar_swap_to_tiled(void *src, void *dst, unsigned int src_pitch,
+                          unsigned int width, unsigned int height);
+
+/* width is that of the interleaved lines */
+void planar_interleave(void *src1, void *src2, void *dst,
+                       unsigned int src_pitch, unsigned int dst_pitch,
+                       unsigned int width, unsigned int height);
+
+void planar_deinterleave(void *src, void *dst1, void *dst2,
+                         unsigned int src_pitch, unsigned int dst_pitch,
+                         unsigned int width, unsigned int height);
+
+void planar_swap(void *src, void *dst,
+                 unsigned int src_pitch, unsigned int dst_pitch,
+                 unsigned int width, unsigned int height);
+
+/* width has to be a multiple of 16 */
+void yuva_to_420(void *src0, void *src1, void *dst_y0, void *dst_y1,
+                 void *dst_u, void *dst_v, unsigned int width);
+
+void vuya_to_420(void *src0, void *src1, void *dst_y0, void *dst_y1,
+                 void *dst_u, void *dst_v, unsigned int width);
+
+void tiled_to_planar_ref(void *src, void *dst, unsigned int dst_pitch,
+                         unsigned int width, unsigned int height);
+
+void tiled_deinterleave_to_planar_ref(void *src, void *dst1, void *dst2,
+                                      unsigned int dst_pitch,
+                                      unsigned int width, unsigned int height);
+
+void tiled_swap_to_planar_ref(void *src, void *dst, unsigned int dst_pitch,
+                              unsigned int width, unsigned int height);
+
+void planar_to_tiled_ref(void *src, void *dst, unsigned int src_pitch,
+                         unsigned int width, unsigned int height);
+
+void planar_interleave_to_tiled_ref(void *src1, void *src2, void *dst,
+                                    unsigned int src_pitch,
+                                    unsigned int width, unsigned int height);
+
+void planar_swap_to_tiled_ref(void *src, void *dst, unsigned int src_pitch,
+                              unsigned int width, unsigned int height);
+
+void planar_interleave_ref(void *src1, void *src2, void *dst,
+                           unsigned int src_pitch, unsigned int dst_pitch,
+                           unsigned int width, unsigned int height);
+
+void planar_deinterleave_ref(void *src, void *dst1, void *dst2,
+                             unsigned int src_pitch, unsigned int dst_pitch,
+                             unsigned int width, unsigned int height);
+
+void planar_swap_ref(void *src, void *dst,
+                     unsigned int src_pitch, unsigned int dst_pitch,
+                     unsigned int width, unsigned int height);
+
+void yuva_to_420_ref(void *src0, void *src1, void *dst_y0, void *dst_y1,
+                     void *dst_u, void *dst_v, unsigned int width);
+
+void vuya_to_420_ref(void *src0, void *src1, void *dst_y0, void *dst_y1,
+                     void *dst_u, void *dst_v, unsigned int width);
+
 #endif
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "tiled_yuv.h"
+
+/*
+ * Portable versions of the functions in tiled_yuv.S, used on
+ * architectures without an assembler version and as reference for them.
+ *
+ * The VE writes 32x32 byte tiles, a row of tiles covers 32 lines of the
+ * picture and is stored tile after tile.
+ */
+
+static const uint8_t *tiled_line(const uint8_t *src, unsigned int width, unsigned int y)
+{
+	unsigned int tiles_per_row = (width + 31) / 32;
+
+	return src + (y / 32) * tiles_per_row * 1024 + (y % 32) * 32;
+}
+
+void tiled_to_planar_ref(void *src, void *dst, unsigned int dst_pitch,
+                         unsigned int width, unsigned int height)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint8_t *s = tiled_line(src, width, y);
+		uint8_t *d = (uint8_t *)dst + y * dst_pitch;
+
+		for (x = 0; x + 32 <= width; x += 32, s += 1024)
+			memcpy(d + x, s, 32);
+
+		if (x < width)
+			memcpy(d + x, s, width - x);
+	}
+}
+
+void tiled_deinterleave_to_planar_ref(void *src, void *dst1, void *dst2,
+                                      unsigned int dst_pitch,
+                                      unsigned int width, unsigned int height)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint8_t *s = tiled_line(src, width, y);
+		uint8_t *d1 = (uint8_t *)dst1 + y * dst_pitch;
+		uint8_t *d2 = (uint8_t *)dst2 + y * dst_pitch;
+
+		for (x = 0; x < width / 2; x++)
+		{
+			const uint8_t *p = s + (x / 16) * 1024 + (x % 16) * 2;
+			d1[x] = p[0];
+			d2[x] = p[1];
+		}
+	}
+}
+
+void tiled_swap_to_planar_ref(void *src, void *dst, unsigned int dst_pitch,
+                              unsigned int width, unsigned int height)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint8_t *s = tiled_line(src, width, y);
+		uint8_t *d = (uint8_t *)dst + y * dst_pitch;
+
+		for (x = 0; x < width / 2; x++)
+		{
+			const uint8_t *p = s + (x / 16) * 1024 + (x % 16) * 2;
+			d[2 * x] = p[1];
+			d[2 * x + 1] = p[0];
+		}
+	}
+}
+
+static uint8_t *tiled_line_dst(uint8_t *dst, unsigned int width, unsigned int y)
+{
+	return (uint8_t *)tiled_line(dst, width, y);
+}
+
+void planar_to_tiled_ref(void *src, void *dst, unsigned int src_pitch,
+                         unsigned int width, unsigned int height)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint8_t *s = (const uint8_t *)src + y * src_pitch;
+		uint8_t *d = tiled_line_dst(dst, width, y);
+
+		for (x = 0; x + 32 <= width; x += 32, d += 1024)
+			memcpy(d, s + x, 32);
+
+		if (x < width)
+			memcpy(d, s + x, width - x);
+	}
+}
+
+void planar_interleave_to_tiled_ref(void *src1, void *src2, void *dst,
+                                    unsigned int src_pitch,
+                                    unsigned int width, unsigned int height)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint8_t *s1 = (const uint8_t *)src1 + y * src_pitch;
+		const uint8_t *s2 = (const uint8_t *)src2 + y * src_pitch;
+		uint8_t *d = tiled_line_dst(dst, width, y);
+
+		for (x = 0; x < width / 2; x++)
+		{
+			uint8_t *p = d + (x / 16) * 1024 + (x % 16) * 2;
+			p[0] = s1[x];
+			p[1] = s2[x];
+		}
+	}
+}
+
+void planar_swap_to_tiled_ref(void *src, void *dst, unsigned int src_pitch,
+                              unsigned int width, unsigned int height)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint8_t *s = (const uint8_t *)src + y * src_pitch;
+		uint8_t *d = tiled_line_dst(dst, width, y);
+
+		for (x = 0; x < width / 2; x++)
+		{
+			uint8_t *p = d + (x / 16) * 1024 + (x % 16) * 2;
+			p[0] = s[2 * x + 1];
+			p[1] = s[2 * x];
+		}
+	}
+}
+
+void planar_interleave_ref(void *src1, void *src2, void *dst,
+                           unsigned int src_pitch, unsigned int dst_pitch,
+                           unsigned int width, unsigned int height)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint8_t *s1 = (const uint8_t *)src1 + y * src_pitch;
+		const uint8_t *s2 = (const uint8_t *)src2 + y * src_pitch;
+		uint8_t *d = (uint8_t *)dst + y * dst_pitch;
+
+		for (x = 0; x < width / 2; x++)
+		{
+			d[2 * x] = s1[x];
+			d[2 * x + 1] = s2[x];
+		}
+	}
+}
+
+void planar_deinterleave_ref(void *src, void *dst1, void *dst2,
+                             unsigned int src_pitch, unsigned int dst_pitch,
+                             unsigned int width, unsigned int height)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint8_t *s = (const uint8_t *)src + y * src_pitch;
+		uint8_t *d1 = (uint8_t *)dst1 + y * dst_pitch;
+		uint8_t *d2 = (uint8_t *)dst2 + y * dst_pitch;
+
+		for (x = 0; x < width / 2; x++)
+		{
+			d1[x] = s[2 * x];
+			d2[x] = s[2 * x + 1];
+		}
+	}
+}
+
+void planar_swap_ref(void *src, void *dst,
+                     unsigned int src_pitch, unsigned int dst_pitch,
+                     unsigned int width, unsigned int height)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		const uint8_t *s = (const uint8_t *)src + y * src_pitch;
+		uint8_t *d = (uint8_t *)dst + y * dst_pitch;
+
+		for (x = 0; x < width / 2; x++)
+		{
+			d[2 * x] = s[2 * x + 1];
+			d[2 * x + 1] = s[2 * x];
+		}
+	}
+}
+
+static void packed_to_420_ref(const uint8_t *src0, const uint8_t *src1, uint8_t *y0, uint8_t *y1,
+                              uint8_t *u, uint8_t *v, unsigned int width, int yc, int vc)
+{
+	unsigned int x;
+
+	for (x = 0; x < width; x++)
+	{
+		y0[x] = src0[4 * x + yc];
+		y1[x] = src1[4 * x + yc];
+	}
+
+	for (x = 0; x < width / 2; x++)
+	{
+		const uint8_t *a = src0 + 8 * x, *b = src1 + 8 * x;
+		u[x] = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;
+		v[x] = (a[vc] + a[vc + 4] + b[vc] + b[vc + 4] + 2) >> 2;
+	}
+}
+
+void yuva_to_420_ref(void *src0, void *src1, void *dst_y0, void *dst_y1,
+                     void *dst_u, void *dst_v, unsigned int width)
+{
+	packed_to_420_ref(src0, src1, dst_y0, dst_y1, dst_u, dst_v, width, 0, 2);
+}
+
+void vuya_to_420_ref(void *src0, void *src1, void *dst_y0, void *dst_y1,
+                     void *dst_u, void *dst_v, unsigned int width)
+{
+	packed_to_420_ref(src0, src1, dst_y0, dst_y1, dst_u, dst_v, width, 2, 0);
+}
+
+#if !defined(__arm__) && !defined(__aarch64__)
+
+void tiled_to_planar(void *src, void *dst, unsigned int dst_pitch,
+                     unsigned int width, unsigned int height)
+{
+	tiled_to_planar_ref(src, dst, dst_pitch, width, height);
+}
+
+void tiled_deinterleave_to_planar(void *src, void *dst1, void *dst2,
+                                  unsigned int dst_pitch,
+                                  unsigned int width, unsigned int height)
+{
+	tiled_deinterleave_to_planar_ref(src, dst1, dst2, dst_pitch, width, height);
+}
+
+void tiled_swap_to_planar(void *src, void *dst, unsigned int dst_pitch,
+                          unsigned int width, unsigned int height)
+{
+	tiled_swap_to_planar_ref(src, dst, dst_pitch, width, height);
+}
+
+void planar_to_tiled(void *src, void *dst, unsigned int src_pitch,
+                     unsigned int width, unsigned int height)
+{
+	planar_to_tiled_ref(src, dst, src_pitch, width, height);
+}
+
+void planar_interleave_to_tiled(void *src1, void *src2, void *dst,
+                                unsigned int src_pitch,
+                                unsigned int width, unsigned int height)
+{
+	planar_interleave_to_tiled_ref(src1, src2, dst, src_pitch, width, height);
+}
+
+void planar_swap_to_tiled(void *src, void *dst, unsigned int src_pitch,
+                          unsigned int width, unsigned int height)
+{
+	planar_swap_to_tiled_ref(src, dst, src_pitch, width, height);
+}
+
+void planar_interleave(void *src1, void *src2, void *dst,
+                       unsigned int src_pitch, unsigned int dst_pitch,
+                       unsigned int width, unsigned int height)
+{
+	planar_interleave_ref(src1, src2, dst, src_pitch, dst_pitch, width, height);
+}
+
+void planar_deinterleave(void *src, void *dst1, void *dst2,
+                         unsigned int src_pitch, unsigned int dst_pitch,
+                         unsigned int width, unsigned int height)
+{
+	planar_deinterleave_ref(src, dst1, dst2, src_pitch, dst_pitch, width, height);
+}
+
+void planar_swap(void *src, void *dst,
+                 unsigned int src_pitch, unsigned int dst_pitch,
+                 unsigned int width, unsigned int height)
+{
+	planar_swap_ref(src, dst, src_pitch, dst_pitch, width, height);
+}
+
+void yuva_to_420(void *src0, void *src1, void *dst_y0, void *dst_y1,
+                 void *dst_u, void *dst_v, unsigned int width)
+{
+	yuva_to_420_ref(src0, src1, dst_y0, dst_y1, dst_u, dst_v, width);
+}
+
+void vuya_to_420(void *src0, void *src1, void *dst_y0, void *dst_y1,
+                 void *dst_u, void *dst_v, unsigned int width)
+{
+	vuya_to_420_ref(src0, src1, dst_y0, dst_y1, dst_u, dst_v, width);
+}
+
+#endif
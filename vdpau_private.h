@@ -22,18 +22,34 @@
 
 #define DEBUG
 #define MAX_HANDLES 64
-#define VBV_SIZE (1 * 1024 * 1024)
+#define VBV_MIN_SIZE (256 * 1024)
+#define VBV_ALIGN (64 * 1024)
+#define VBV_COUNT 2
 
 #include <stdlib.h>
 #include <cedrus/cedrus.h>
 #include <vdpau/vdpau.h>
 #include <vdpau/vdpau_x11.h>
 #include <X11/Xlib.h>
+#include "vdpau_sunxi.h"
 #include "sunxi_disp.h"
 #include "pixman.h"
 
 #define INTERNAL_YCBCR_FORMAT (VdpYCbCrFormat)0xffff
 
+typedef struct arena_mem arena_mem_t;
+
+typedef struct
+{
+	size_t requested;
+	size_t in_use;
+	size_t reserved;
+	size_t high_water;
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int trims;
+} arena_stats_t;
+
 typedef struct
 {
 	cedrus_t *cedrus;
@@ -45,32 +61,123 @@ typedef struct
 	int g2d_fd;
 	int osd_enabled;
 	int g2d_enabled;
+	struct decode_queue *decode_queue;
+	struct arena *arena;
+	struct surface_pool *surface_pool;
+	struct yuv_pool *yuv_pool;
+	struct readback_pool *readback_pool;
+	unsigned int scale_shift;
+	unsigned int rotation;
+	const void *ve_owner;		/* ve_shadow_t matching the VE state */
 } device_ctx_t;
 
-typedef struct
+typedef struct yuv_data_struct
 {
 	int ref_count;
-	cedrus_mem_t *data;
+	arena_mem_t *data;
+	device_ctx_t *device;
+	size_t size;
+	struct yuv_data_struct *next;
 } yuv_data_t;
 
+typedef enum
+{
+	SURFACE_LAYOUT_TILED,	// 32x32 tiles, chroma interleaved (VE < 0x1680 output)
+	SURFACE_LAYOUT_PLANAR,	// Y, Cb, Cr planes
+	SURFACE_LAYOUT_NV12,
+	SURFACE_LAYOUT_YUYV,
+	SURFACE_LAYOUT_UYVY,
+} surface_layout_t;
+
 typedef struct video_surface_ctx_struct
 {
 	device_ctx_t *device;
 	uint32_t width, height;
 	VdpChromaType chroma_type;
 	VdpYCbCrFormat source_format;
+	surface_layout_t layout;
+	uint32_t pitches[3];
+	uint32_t offsets[3];
+	unsigned int scale_shift;	// yuv holds the picture scaled down by 1 << scale_shift
+	unsigned int rotation;		// and turned clockwise by rotation * 90 degrees
 	yuv_data_t *yuv;
+	yuv_data_t *spare_yuv;
 	int luma_size, chroma_size;
-	cedrus_mem_t *rec;
+	arena_mem_t *rec;
 	void *decoder_private;
 	void (*decoder_private_free)(struct video_surface_ctx_struct *surface);
+	uint64_t fence;		// last queued decode writing this surface
+	uint64_t ref_fence;	// last queued decode reading it as reference
+	void *scratch;		// conversion buffer of get/put bits, kept between calls
+	size_t scratch_size;
 } video_surface_ctx_t;
 
+typedef struct
+{
+	yuv_data_t *yuv;
+} surface_export_ctx_t;
+
+typedef struct
+{
+	cedrus_mem_t *data;
+	uint32_t size;
+	uint32_t len;
+	uint32_t *startcodes;
+	unsigned int num_startcodes;
+	unsigned int max_startcodes;
+	uint64_t fence;
+} vbv_t;
+
+typedef struct
+{
+	uint32_t high_water;	/* largest picture bitstream so far */
+	uint32_t largest_slot;
+	uint32_t reserved;	/* all slots of the ring together */
+} vbv_stats_t;
+
+/*
+ * Scale-down/rotate unit control, the same for the H.264 and MPEG engines.
+ * On VE >= 0x1680 this unit writes the linear copy to yuv->data.
+ */
+#define SDROT_CTRL_SCALE_DOWN(shift)	(((shift) & 0x3) << 2 | ((shift) & 0x3) << 0)
+#define SDROT_CTRL_SCALE_DOWN_EN	(0x1 << 8)
+#define SDROT_CTRL_ROTATE(quarters)	(((quarters) & 0x3) << 4)
+#define SDROT_CTRL_ROTATE_EN		(0x1 << 9)
+
+#define VE_SHADOW_REGS (0x1000 / 4)
+
+typedef enum
+{
+	VE_SHADOW_TABLE_MPEG_IQ,
+	VE_SHADOW_TABLE_H264_SCALING_LISTS,
+	VE_SHADOW_TABLE_H264_FRAMEBUFFER_LIST,
+	VE_SHADOW_TABLE_HEVC_SCALING_LISTS,
+	VE_SHADOW_TABLE_COUNT
+} ve_shadow_table_t;
+
+typedef struct
+{
+	uint32_t value[VE_SHADOW_REGS];
+	uint32_t valid[VE_SHADOW_REGS / 32];
+	void *table[VE_SHADOW_TABLE_COUNT];
+	size_t table_size[VE_SHADOW_TABLE_COUNT];
+	int table_valid[VE_SHADOW_TABLE_COUNT];
+	unsigned int issued, suppressed;
+	uint64_t total_issued, total_suppressed;
+	unsigned int frames;
+} ve_shadow_t;
+
 typedef struct decoder_ctx_struct
 {
 	uint32_t width, height;
 	VdpDecoderProfile profile;
-	cedrus_mem_t *data;
+	vbv_t vbv_ring[VBV_COUNT];
+	unsigned int vbv_next;
+	vbv_t *vbv;
+	uint32_t vbv_high_water;
+	unsigned int scale_shift;
+	unsigned int rotation;
+	ve_shadow_t shadow;
 	device_ctx_t *device;
 	VdpStatus (*decode)(struct decoder_ctx_struct *decoder, VdpPictureInfo const *info, const int len, video_surface_ctx_t *output);
 	void *private;
@@ -109,7 +216,7 @@ typedef struct
 	device_ctx_t *device;
 	VdpRGBAFormat format;
 	uint32_t width, height;
-	cedrus_mem_t *data;
+	arena_mem_t *data;
 	VdpRect dirty;
 	uint32_t flags;
 	pixman_image_t *pimage;
@@ -120,6 +227,7 @@ typedef struct output_surface_ctx_struct
 	rgba_surface_t rgba;
 	video_surface_ctx_t *vs;
 	yuv_data_t *yuv;
+	uint64_t video_fence;
 	VdpRect video_src_rect, video_dst_rect;
 	int csc_change;
 	float brightness;
@@ -176,15 +284,87 @@ VdpStatus new_decoder_mpeg12(decoder_ctx_t *decoder);
 VdpStatus new_decoder_h264(decoder_ctx_t *decoder);
 VdpStatus new_decoder_mpeg4(decoder_ctx_t *decoder);
 VdpStatus new_decoder_h265(decoder_ctx_t *decoder);
+void decoder_get_vbv_stats(decoder_ctx_t *decoder, vbv_stats_t *stats);
 
+VdpStatus yuv_pool_create(device_ctx_t *device);
+void yuv_pool_destroy(device_ctx_t *device);
 void yuv_unref(yuv_data_t *yuv);
 yuv_data_t *yuv_ref(yuv_data_t *yuv);
-VdpStatus yuv_prepare(video_surface_ctx_t *video_surface);
+int yuv_exclusive(yuv_data_t *yuv);
+VdpStatus yuv_prepare(video_surface_ctx_t *video_surface, unsigned int scale_shift, unsigned int rotation);
 VdpStatus rec_prepare(video_surface_ctx_t *video_surface);
+void video_surface_set_layout(video_surface_ctx_t *video_surface, surface_layout_t layout,
+                              uint32_t luma_pitch, uint32_t chroma_pitch);
+void video_surface_set_decoded_layout(video_surface_ctx_t *video_surface);
+void video_surface_get_display_size(video_surface_ctx_t *video_surface, uint32_t *width, uint32_t *height);
+void video_surface_get_display_rect(video_surface_ctx_t *video_surface, VdpRect const *rect, VdpRect *display_rect);
+uint32_t video_surface_sdrot_ctrl(video_surface_ctx_t *video_surface);
+
+void ve_shadow_begin(ve_shadow_t *shadow, device_ctx_t *device);
+void ve_shadow_end(ve_shadow_t *shadow);
+void ve_shadow_writel(ve_shadow_t *shadow, uint32_t val, void *regs, uint32_t reg);
+int ve_shadow_table_changed(ve_shadow_t *shadow, ve_shadow_table_t table, const void *data, size_t size, unsigned int writes);
+void ve_shadow_upload(ve_shadow_t *shadow, ve_shadow_table_t table, void *regs, uint32_t ptr_reg, uint32_t data_reg,
+                      uint32_t sram, const uint32_t *data, unsigned int words, unsigned int block_words);
+void ve_shadow_free(ve_shadow_t *shadow, device_ctx_t *device);
+
+VdpStatus decode_queue_create(device_ctx_t *device);
+void decode_queue_destroy(device_ctx_t *device);
+VdpStatus decode_queue_submit(decoder_ctx_t *decoder, vbv_t *vbv, VdpPictureInfo const *info, int len, video_surface_ctx_t *output);
+void decode_queue_wait(device_ctx_t *device, uint64_t fence);
+void decode_queue_drain(device_ctx_t *device);
+
+VdpStatus arena_create(device_ctx_t *device);
+void arena_destroy(device_ctx_t *device);
+arena_mem_t *arena_alloc(device_ctx_t *device, size_t size);
+void arena_free(arena_mem_t *mem);
+arena_mem_t *arena_import(int fd, size_t size);
+int arena_is_imported(const arena_mem_t *mem);
+int arena_get_fd(const arena_mem_t *mem);
+void arena_get_stats(device_ctx_t *device, arena_stats_t *stats);
+void *arena_get_pointer(const arena_mem_t *mem);
+uint32_t arena_get_bus_addr(const arena_mem_t *mem);
+uint32_t arena_get_phys_addr(const arena_mem_t *mem);
+void arena_flush_cache(arena_mem_t *mem);
+
+VdpStatus surface_pool_create(device_ctx_t *device);
+void surface_pool_destroy(device_ctx_t *device);
+void surface_pool_flush(device_ctx_t *device);
+int surface_pool_put(video_surface_ctx_t *surface);
+int surface_pool_get(video_surface_ctx_t *surface);
+
+VdpStatus readback_pool_create(device_ctx_t *device, int threads);
+void readback_pool_destroy(device_ctx_t *device);
+void readback_tiled_to_planar(device_ctx_t *device, void *src, void *dst, unsigned int dst_pitch,
+                              unsigned int width, unsigned int height);
+void readback_tiled_deinterleave_to_planar(device_ctx_t *device, void *src, void *dst1, void *dst2,
+                                           unsigned int dst_pitch, unsigned int width, unsigned int height);
+void readback_tiled_swap_to_planar(device_ctx_t *device, void *src, void *dst, unsigned int dst_pitch,
+                                   unsigned int width, unsigned int height);
+void readback_planar_interleave(device_ctx_t *device, void *src1, void *src2, void *dst, unsigned int src_pitch,
+                                unsigned int dst_pitch, unsigned int width, unsigned int height);
+void readback_planar_deinterleave(device_ctx_t *device, void *src, void *dst1, void *dst2, unsigned int src_pitch,
+                                  unsigned int dst_pitch, unsigned int width, unsigned int height);
+void readback_planar_swap(device_ctx_t *device, void *src, void *dst, unsigned int src_pitch,
+                          unsigned int dst_pitch, unsigned int width, unsigned int height);
 
 typedef uint32_t VdpHandle;
 
-void *handle_create(size_t size, VdpHandle *handle);
+typedef enum
+{
+	HANDLE_TYPE_DEVICE,
+	HANDLE_TYPE_DECODER,
+	HANDLE_TYPE_VIDEO_SURFACE,
+	HANDLE_TYPE_OUTPUT_SURFACE,
+	HANDLE_TYPE_BITMAP_SURFACE,
+	HANDLE_TYPE_VIDEO_MIXER,
+	HANDLE_TYPE_PRESENTATION_QUEUE,
+	HANDLE_TYPE_PRESENTATION_QUEUE_TARGET,
+	HANDLE_TYPE_SURFACE_EXPORT,
+	HANDLE_TYPE_COUNT
+} handle_type_t;
+
+void *handle_create(handle_type_t type, size_t size, VdpHandle *handle);
 void *handle_get(VdpHandle handle);
 void handle_destroy(VdpHandle handle);
 
@@ -216,6 +396,9 @@ VdpVideoSurfaceGetBitsYCbCr vdp_video_surface_get_bits_y_cb_cr;
 VdpVideoSurfacePutBitsYCbCr vdp_video_surface_put_bits_y_cb_cr;
 VdpVideoSurfaceQueryCapabilities vdp_video_surface_query_capabilities;
 VdpVideoSurfaceQueryGetPutBitsYCbCrCapabilities vdp_video_surface_query_get_put_bits_y_cb_cr_capabilities;
+VdpVideoSurfaceImportDmaBufSunxi vdp_video_surface_import_dma_buf_sunxi;
+VdpVideoSurfaceExportSunxi vdp_video_surface_export_sunxi;
+VdpVideoSurfaceExportReleaseSunxi vdp_video_surface_export_release_sunxi;
 
 VdpOutputSurfaceCreate vdp_output_surface_create;
 VdpOutputSurfaceDestroy vdp_output_surface_destroy;
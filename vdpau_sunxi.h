@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __VDPAU_SUNXI_H__
+#define __VDPAU_SUNXI_H__
+
+#include <vdpau/vdpau.h>
+
+/*
+ * Driver specific extensions, only available with VDPAU_DRIVER=sunxi.
+ * Check VdpVideoSurfaceQueryGetPutBitsYCbCrCapabilities before use.
+ */
+
+/* Y plane followed by Cb and Cr planes, like YV12 with swapped chroma planes */
+#define VDP_YCBCR_FORMAT_SUNXI_I420	((VdpYCbCrFormat)0x8000)
+
+/* Y plane followed by an interleaved CrCb plane, like NV12 with swapped chroma */
+#define VDP_YCBCR_FORMAT_SUNXI_NV21	((VdpYCbCrFormat)0x8001)
+
+/*
+ * Driver specific functions, get them with VdpGetProcAddress.
+ */
+
+#define VDP_FUNC_ID_VIDEO_SURFACE_IMPORT_DMA_BUF_SUNXI	(VDP_FUNC_ID_BASE_DRIVER + 0)
+#define VDP_FUNC_ID_VIDEO_SURFACE_EXPORT_SUNXI		(VDP_FUNC_ID_BASE_DRIVER + 1)
+#define VDP_FUNC_ID_VIDEO_SURFACE_EXPORT_RELEASE_SUNXI	(VDP_FUNC_ID_BASE_DRIVER + 2)
+
+/*
+ * Create a 4:2:0 video surface backed by a dma-buf, without copying.
+ *
+ * format can be NV12, YV12 or VDP_YCBCR_FORMAT_SUNXI_I420, offsets and
+ * pitches are given in the plane order of the format. The luma pitch
+ * has to be the width aligned to 32, the chroma pitches those of the
+ * format at that luma pitch. The fd is duplicated, the caller may close
+ * its own copy right away.
+ *
+ * The surface can be mixed, displayed and read back. It can't be decoded
+ * to or written with VdpVideoSurfacePutBitsYCbCr, the application writes
+ * the dma-buf directly instead. The buffer has to be physically
+ * contiguous and its physical address readable from /proc/self/pagemap,
+ * which recent kernels only allow privileged processes, otherwise
+ * VDP_STATUS_ERROR is returned.
+ */
+typedef VdpStatus VdpVideoSurfaceImportDmaBufSunxi(
+	VdpDevice device,
+	VdpChromaType chroma_type,
+	uint32_t width,
+	uint32_t height,
+	VdpYCbCrFormat format,
+	int fd,
+	uint32_t const offsets[3],
+	uint32_t const pitches[3],
+	/* output parameters follow */
+	VdpVideoSurface *surface
+);
+
+/* Memory layout of an exported video surface */
+typedef enum
+{
+	/* 32x32 tiles, Y plane followed by a tiled, interleaved CbCr plane */
+	VDP_SUNXI_LAYOUT_TILED,
+	/* Y, Cb and Cr planes */
+	VDP_SUNXI_LAYOUT_PLANAR,
+	/* Y plane followed by an interleaved CbCr plane */
+	VDP_SUNXI_LAYOUT_NV12,
+	VDP_SUNXI_LAYOUT_YUYV,
+	VDP_SUNXI_LAYOUT_UYVY,
+} VdpSunxiLayout;
+
+typedef struct
+{
+	VdpSunxiLayout layout;
+	uint32_t width;
+	uint32_t height;
+	/* dma-buf of the buffer owned by the caller, -1 if there is none */
+	int fd;
+	/* physical address for other hardware units, 0 if unknown */
+	uint32_t phys_addr;
+	/* CPU mapping, valid until the export is released */
+	void *pointer;
+	uint32_t size;
+	/* plane offsets and pitches, unused planes are 0 */
+	uint32_t offsets[3];
+	uint32_t pitches[3];
+} VdpSunxiSurfaceDescriptor;
+
+typedef uint32_t VdpSunxiExport;
+
+/*
+ * Get hold of the buffer a video surface currently shows, without
+ * copying. The buffer stays valid and unchanged until the export is
+ * released, decoding to or putting bits into the surface afterwards
+ * moves the surface to another buffer.
+ *
+ * Only imported surfaces have a dma-buf to return, the driver's own
+ * buffers are passed on by physical address.
+ */
+typedef VdpStatus VdpVideoSurfaceExportSunxi(
+	VdpVideoSurface surface,
+	/* output parameters follow */
+	VdpSunxiSurfaceDescriptor *descriptor,
+	VdpSunxiExport *export_handle
+);
+
+typedef VdpStatus VdpVideoSurfaceExportReleaseSunxi(
+	VdpSunxiExport export_handle
+);
+
+#endif
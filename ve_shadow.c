@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <string.h>
+#include <cedrus/cedrus.h>
+#include <cedrus/cedrus_regs.h>
+#include "vdpau_private.h"
+
+/*
+ * Shadow of the VE state written by a decoder, used to leave out writes
+ * that wouldn't change anything.
+ *
+ * The VE keeps registers and SRAM tables between pictures, so the shadow
+ * stays valid as long as no other decoder used the VE in between. The
+ * device remembers whose shadow matches the VE, every cedrus_ve_get() of
+ * the driver has to be followed by ve_shadow_begin() to claim it. Other
+ * processes using the VE at the same time aren't noticed.
+ *
+ * The per slice 0x7 trigger only restarts the bitstream reader, whose
+ * VLD/BITS registers are written directly. Only plain parameter
+ * registers may go through ve_shadow_writel(), never trigger, status,
+ * bitstream or RAM port ones.
+ */
+
+static void ve_shadow_reset(ve_shadow_t *shadow)
+{
+	int i;
+
+	memset(shadow->valid, 0, sizeof(shadow->valid));
+	for (i = 0; i < VE_SHADOW_TABLE_COUNT; i++)
+		shadow->table_valid[i] = 0;
+}
+
+// call with the VE held
+void ve_shadow_begin(ve_shadow_t *shadow, device_ctx_t *device)
+{
+	if (__atomic_load_n(&device->ve_owner, __ATOMIC_RELAXED) != shadow)
+	{
+		ve_shadow_reset(shadow);
+		__atomic_store_n(&device->ve_owner, shadow, __ATOMIC_RELAXED);
+	}
+
+	shadow->issued = 0;
+	shadow->suppressed = 0;
+}
+
+void ve_shadow_end(ve_shadow_t *shadow)
+{
+	shadow->total_issued += shadow->issued;
+	shadow->total_suppressed += shadow->suppressed;
+	shadow->frames++;
+}
+
+void ve_shadow_writel(ve_shadow_t *shadow, uint32_t val, void *regs, uint32_t reg)
+{
+	unsigned int i = reg / 4;
+
+	if (i < VE_SHADOW_REGS)
+	{
+		if ((shadow->valid[i / 32] & (1 << (i % 32))) && shadow->value[i] == val)
+		{
+			shadow->suppressed++;
+			return;
+		}
+
+		shadow->value[i] = val;
+		shadow->valid[i / 32] |= (1 << (i % 32));
+	}
+
+	writel(val, regs + reg);
+	shadow->issued++;
+}
+
+static int table_alloc(ve_shadow_t *shadow, ve_shadow_table_t table, size_t size)
+{
+	if (shadow->table_size[table] != size)
+	{
+		free(shadow->table[table]);
+		shadow->table_size[table] = 0;
+		shadow->table_valid[table] = 0;
+		shadow->table[table] = malloc(size);
+		if (!shadow->table[table])
+			return 0;
+
+		shadow->table_size[table] = size;
+	}
+
+	return 1;
+}
+
+int ve_shadow_table_changed(ve_shadow_t *shadow, ve_shadow_table_t table, const void *data, size_t size, unsigned int writes)
+{
+	if (shadow->table_valid[table] && shadow->table_size[table] == size && memcmp(shadow->table[table], data, size) == 0)
+	{
+		shadow->suppressed += writes;
+		return 0;
+	}
+
+	shadow->table_valid[table] = table_alloc(shadow, table, size);
+	if (shadow->table_valid[table])
+		memcpy(shadow->table[table], data, size);
+
+	shadow->issued += writes;
+	return 1;
+}
+
+/*
+ * Upload a table through a RAM write port, leaving out the blocks of
+ * block_words words that are unchanged since the last upload. The write
+ * pointer auto-increments, so it is only set again after a skipped block.
+ */
+void ve_shadow_upload(ve_shadow_t *shadow, ve_shadow_table_t table, void *regs, uint32_t ptr_reg, uint32_t data_reg,
+                      uint32_t sram, const uint32_t *data, unsigned int words, unsigned int block_words)
+{
+	int valid = shadow->table_valid[table] && shadow->table_size[table] == words * 4;
+
+	if (!valid)
+		shadow->table_valid[table] = table_alloc(shadow, table, words * 4);
+
+	uint32_t *copy = shadow->table[table];
+	unsigned int i, j, next = words;
+
+	for (i = 0; i < words; i += block_words)
+	{
+		if (valid && memcmp(copy + i, data + i, block_words * 4) == 0)
+		{
+			shadow->suppressed += block_words;
+			continue;
+		}
+
+		if (next != i)
+		{
+			writel(sram + i * 4, regs + ptr_reg);
+			shadow->issued++;
+		}
+
+		for (j = i; j < i + block_words; j++)
+			writel(data[j], regs + data_reg);
+
+		shadow->issued += block_words;
+		next = i + block_words;
+	}
+
+	if (shadow->table_valid[table])
+		memcpy(copy, data, words * 4);
+}
+
+void ve_shadow_free(ve_shadow_t *shadow, device_ctx_t *device)
+{
+	// a new shadow at the same address must not take over the VE state
+	const void *owner = shadow;
+	__atomic_compare_exchange_n(&device->ve_owner, &owner, NULL, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+
+	if (shadow->total_issued || shadow->total_suppressed)
+		VDPAU_DBG("VE writes: %llu issued, %llu suppressed in %u pictures",
+			(unsigned long long)shadow->total_issued, (unsigned long long)shadow->total_suppressed, shadow->frames);
+
+	int i;
+	for (i = 0; i < VE_SHADOW_TABLE_COUNT; i++)
+		free(shadow->table[i]);
+}
@@ -34,7 +34,7 @@ VdpStatus vdp_video_mixer_create(VdpDevice device,
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	mixer_ctx_t *mix = handle_create(sizeof(*mix), mixer);
+	mixer_ctx_t *mix = handle_create(HANDLE_TYPE_VIDEO_MIXER, sizeof(*mix), mixer);
 	if (!mix)
 		return VDP_STATUS_RESOURCES;
 
@@ -96,7 +96,8 @@ VdpStatus vdp_video_mixer_render(VdpVideoMixer mixer,
 	if (!(os->vs))
 		return VDP_STATUS_INVALID_HANDLE;
 
-	os->yuv = yuv_ref(os->vs->yuv);
+	os->yuv = yuv_ref(__atomic_load_n(&os->vs->yuv, __ATOMIC_ACQUIRE));
+	os->video_fence = os->vs->fence;
 
 	if (video_source_rect)
 	{
@@ -117,6 +118,13 @@ VdpStatus vdp_video_mixer_render(VdpVideoMixer mixer,
 		os->video_dst_rect.x0 = os->video_dst_rect.y0 = 0;
 		os->video_dst_rect.x1 = os->video_src_rect.x1 - os->video_src_rect.x0;
 		os->video_dst_rect.y1 = os->video_src_rect.y1 - os->video_src_rect.y0;
+
+		// quarter turned pictures come out the other way round
+		if (os->vs->rotation & 1)
+		{
+			os->video_dst_rect.x1 = os->video_src_rect.y1 - os->video_src_rect.y0;
+			os->video_dst_rect.y1 = os->video_src_rect.x1 - os->video_src_rect.x0;
+		}
 	}
 
 	os->csc_change = mix->csc_change;